@@ -10,7 +10,10 @@ macx {
 
 QT += widgets \
     gui \
-    core
+    core \
+    concurrent
+
+CONFIG += c++17
 
 HEADERS = hashcalcapplication.h \
     hashproject/sourcedirectory.h \
@@ -23,9 +26,29 @@ HEADERS = hashcalcapplication.h \
     gui/statusboxwidget.h \
     workers/filefinder.h \
     workers/hasher.h \
+    workers/devicescheduler.h \
+    workers/directoryhandles.h \
+    workers/directoryscanner.h \
+    workers/filehints.h \
+    workers/filereader.h \
+    workers/hashcache.h \
+    workers/readpipeline.h \
+    workers/throttle.h \
+    algorithms/algorithmregistry.h \
+    algorithms/blocksource.h \
     algorithms/crc32algorithm.h \
+    algorithms/crc32calgorithm.h \
+    algorithms/crctables.h \
+    algorithms/crc32clmul.h \
+    algorithms/cpufeatures.h \
     algorithms/hashalgorithm.h \
-    algorithms/qtcryptoalgorithms.h
+    algorithms/hashdigest.h \
+    algorithms/qtcryptoalgorithms.h \
+    algorithms/shanialgorithms.h \
+    algorithms/multibufferhash.h \
+    algorithms/lanevectors.h \
+    algorithms/blake3algorithm.h \
+    algorithms/xxh3algorithm.h
 
 
 SOURCES = hashcalcapplication.cpp \
@@ -40,8 +63,25 @@ SOURCES = hashcalcapplication.cpp \
     gui/statusboxwidget.cpp \
     workers/filefinder.cpp \
     workers/hasher.cpp \
+    workers/devicescheduler.cpp \
+    workers/directoryhandles.cpp \
+    workers/directoryscanner.cpp \
+    workers/filehints.cpp \
+    workers/filereader.cpp \
+    workers/hashcache.cpp \
+    workers/readpipeline.cpp \
+    workers/throttle.cpp \
+    algorithms/algorithmregistry.cpp \
     algorithms/crc32algorithm.cpp \
-    algorithms/qtcryptoalgorithms.cpp
+    algorithms/crc32calgorithm.cpp \
+    algorithms/crc32clmul.cpp \
+    algorithms/cpufeatures.cpp \
+    algorithms/hashdigest.cpp \
+    algorithms/qtcryptoalgorithms.cpp \
+    algorithms/shanialgorithms.cpp \
+    algorithms/multibufferhash.cpp \
+    algorithms/blake3algorithm.cpp \
+    algorithms/xxh3algorithm.cpp
 
 RESOURCES += HashMan.qrc
 RC_ICONS += images/mainicon.ico
@@ -0,0 +1,78 @@
+/**
+ * Registry of the supported hashing algorithms.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include "algorithmregistry.h"
+#include "blake3algorithm.h"
+#include "crc32algorithm.h"
+#include "crc32calgorithm.h"
+#include "qtcryptoalgorithms.h"
+#include "shanialgorithms.h"
+#include "xxh3algorithm.h"
+
+/**
+ * @brief AlgorithmRegistry::AlgorithmRegistry
+ * The algorithms are listed in the GUI in the order they're registered.
+ */
+AlgorithmRegistry::AlgorithmRegistry()
+{
+   Crc32algorithm::registerAlgorithms(*this);
+   Crc32calgorithm::registerAlgorithms(*this);
+   Xxh3algorithm::registerAlgorithms(*this);
+   QtCryptoAlgorithms::registerAlgorithms(*this);
+   // Replaces SHA-1 and SHA-256 on processors with the SHA extensions.
+   ShaNiAlgorithms::registerAlgorithms(*this);
+   Blake3algorithm::registerAlgorithms(*this);
+}
+
+/**
+ * @brief AlgorithmRegistry::get
+ * @return The registry, created on first use.
+ */
+const AlgorithmRegistry& AlgorithmRegistry::get()
+{
+   static const AlgorithmRegistry registry;
+   return registry;
+}
+
+/**
+ * @brief AlgorithmRegistry::find
+ * @param id
+ * @return The algorithm, or 0 if it isn't registered.
+ */
+const AlgorithmRegistry::Algorithm* AlgorithmRegistry::find(Id id) const
+{
+   int index = idIndex.value(id, -1);
+   return index < 0 ? 0 : &registered.at(index);
+}
+
+/**
+ * @brief AlgorithmRegistry::find
+ * @param name Name of the algorithm, case insensitive.
+ * @return The algorithm, or 0 if it isn't registered.
+ */
+const AlgorithmRegistry::Algorithm* AlgorithmRegistry::find(QString name) const
+{
+   int index = nameIndex.value(name.trimmed().toUpper(), -1);
+   return index < 0 ? 0 : &registered.at(index);
+}
+
+/**
+ * @brief AlgorithmRegistry::add
+ * @param algorithm Replaces an earlier registration with the same id.
+ */
+void AlgorithmRegistry::add(const Algorithm& algorithm)
+{
+   int index = idIndex.value(algorithm.id, -1);
+   if (index < 0) {
+      index = registered.size();
+      registered.append(algorithm);
+      idIndex[algorithm.id] = index;
+   } else {
+      nameIndex.remove(registered.at(index).name.toUpper());
+      registered[index] = algorithm;
+   }
+   nameIndex[algorithm.name.toUpper()] = index;
+}
@@ -0,0 +1,125 @@
+/**
+ * Registry of the supported hashing algorithms.
+ *
+ * Every algorithm has a stable id and the name used in the GUI and the SFV files.
+ * The classes implementing the algorithms register their hashing contexts, see for
+ * example Crc32algorithm::registerAlgorithms(). A new algorithm only has to be added
+ * to the AlgorithmRegistry constructor to show up everywhere.
+ *
+ * The registered functions are templates instantiated for each context type, so the
+ * loops feeding data to a single context call its update() directly instead of through
+ * the virtual interface, and the compiler can inline the hashing into the loop.
+ *
+ * Registering an id a second time replaces the earlier registration but keeps its
+ * position, which lets processor specific implementations replace the generic ones.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef ALGORITHMREGISTRY_H
+#define ALGORITHMREGISTRY_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+#include "blocksource.h"
+#include "hashalgorithm.h"
+
+class AlgorithmRegistry
+{
+public:
+   // The numbers must never change, new algorithms get new numbers.
+   enum Id {
+      Crc32 = 1,
+      Md4 = 2,
+      Md5 = 3,
+      Sha1 = 4,
+      Sha256 = 5,
+      Sha512 = 6,
+      Blake3 = 7,
+      Xxh3_64 = 8,
+      Xxh128 = 9,
+      Crc32c = 10
+   };
+
+   struct Algorithm {
+      Id id;
+      QString name;
+      // If the hash sums of separate parts can be joined with HashAlgorithm::Context::combine().
+      bool combinable;
+      // Returns a new context, the caller takes ownership.
+      HashAlgorithm::Context* (*createContext)();
+      // Hashes a block of data in memory.
+      HashDigest (*hashData)(const char* data, qint64 length);
+      // Hashes the blocks of a source, such as an opened file. Sets error if the reading fails.
+      HashDigest (*hashSource)(BlockSource& source, QString& error);
+   };
+
+   static const AlgorithmRegistry& get();
+
+   const QList<Algorithm>& algorithms() const { return registered; }
+   const Algorithm* find(Id id) const;
+   const Algorithm* find(QString name) const;
+
+   template<class ContextType>
+   void add(Id id, QString name, bool combinable=false);
+
+private:
+   AlgorithmRegistry();
+   void add(const Algorithm& algorithm);
+
+   template<class ContextType>
+   static HashAlgorithm::Context* createContext()
+   {
+      return new ContextType;
+   }
+
+   template<class ContextType>
+   static HashDigest hashData(const char* data, qint64 length)
+   {
+      ContextType context;
+      context.update(data, length);
+      return context.finalize();
+   }
+
+   template<class ContextType>
+   static HashDigest hashSource(BlockSource& source, QString& error)
+   {
+      ContextType context;
+      BlockSource::Block block;
+      while (source.next(block)) {
+         if (block.hole) {
+            context.updateZeros(block.length);
+         } else {
+            context.update(block.data, block.length);
+         }
+      }
+      if (!source.error().isEmpty()) {
+         error = source.error();
+         return HashDigest();
+      }
+      return context.finalize();
+   }
+
+   QList<Algorithm> registered;
+   QHash<int, int> idIndex;
+   QHash<QString, int> nameIndex;
+};
+
+/**
+ * @brief AlgorithmRegistry::add
+ * @param id
+ * @param name Displayed name, also used in the SFV files.
+ * @param combinable If the contexts implement combine().
+ */
+template<class ContextType>
+void AlgorithmRegistry::add(Id id, QString name, bool combinable)
+{
+   Algorithm algorithm = {
+      id, name, combinable, createContext<ContextType>, hashData<ContextType>, hashSource<ContextType>
+   };
+   add(algorithm);
+}
+
+#endif // ALGORITHMREGISTRY_H
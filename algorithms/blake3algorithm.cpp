@@ -0,0 +1,550 @@
+/**
+ * The BLAKE3 cryptographic hash function, see https://github.com/BLAKE3-team/BLAKE3
+ *
+ * BLAKE3 splits the input into 1 KiB chunks that are hashed independently and
+ * combined in a binary tree. Large blocks of data are therefore split into subtrees
+ * hashed on all cores, with the chunks of each subtree processed in the SIMD lanes
+ * (AVX2 or AVX-512) when available.
+ *
+ * The incremental tree handling follows the reference implementation: the chaining
+ * values of completed subtrees are kept on a stack and merged as soon as the number
+ * of chunks hashed so far shows that a subtree is complete.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include <QByteArray>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent>
+
+#include "algorithmregistry.h"
+#include "blake3algorithm.h"
+#include "lanevectors.h"
+
+namespace {
+
+const int blockLength = 64;
+const int chunkLength = 1024;
+const int outLength = 32;
+const int maxDepth = 54;
+// Number of chunks hashed by each thread when a subtree is split up.
+const qint64 chunksPerTask = 64;
+
+enum Flags {
+   ChunkStart = 1,
+   ChunkEnd = 2,
+   Parent = 4,
+   Root = 8
+};
+
+const quint32 iv[8] = {
+   0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+// The message word permutation applied to each of the seven rounds.
+const quint8 messageSchedule[7][16] = {
+   { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+   { 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 },
+   { 3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1 },
+   { 10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6 },
+   { 12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4 },
+   { 9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7 },
+   { 11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13 }
+};
+
+template<typename Word>
+HASHMAN_ALWAYS_INLINE Word rotateWord(const Word& x, int bits)
+{
+   return (x >> bits) | (x << (32 - bits));
+}
+
+template<typename Word>
+HASHMAN_ALWAYS_INLINE void mix(Word state[16], int a, int b, int c, int d, const Word& x, const Word& y)
+{
+   state[a] = state[a] + state[b] + x;
+   state[d] = rotateWord(state[d] ^ state[a], 16);
+   state[c] = state[c] + state[d];
+   state[b] = rotateWord(state[b] ^ state[c], 12);
+   state[a] = state[a] + state[b] + y;
+   state[d] = rotateWord(state[d] ^ state[a], 8);
+   state[c] = state[c] + state[d];
+   state[b] = rotateWord(state[b] ^ state[c], 7);
+}
+
+/**
+ * The seven rounds of the compression function. Word is either a single quint32
+ * or a vector with the words of several independent compressions.
+ */
+template<typename Word>
+HASHMAN_ALWAYS_INLINE void compressRounds(Word state[16], const Word message[16])
+{
+   for (int round = 0; round < 7; round++) {
+      const quint8* schedule = messageSchedule[round];
+      mix(state, 0, 4, 8, 12, message[schedule[0]], message[schedule[1]]);
+      mix(state, 1, 5, 9, 13, message[schedule[2]], message[schedule[3]]);
+      mix(state, 2, 6, 10, 14, message[schedule[4]], message[schedule[5]]);
+      mix(state, 3, 7, 11, 15, message[schedule[6]], message[schedule[7]]);
+      mix(state, 0, 5, 10, 15, message[schedule[8]], message[schedule[9]]);
+      mix(state, 1, 6, 11, 12, message[schedule[10]], message[schedule[11]]);
+      mix(state, 2, 7, 8, 13, message[schedule[12]], message[schedule[13]]);
+      mix(state, 3, 4, 9, 14, message[schedule[14]], message[schedule[15]]);
+   }
+}
+
+/**
+ * Compresses one block. The first 8 words of the output are the new chaining value,
+ * all 16 are used for the root output.
+ */
+void compress(const quint32 chainingValue[8], const uchar block[blockLength], quint32 length,
+              quint64 counter, quint32 flags, quint32 output[16])
+{
+   quint32 message[16];
+   for (int i = 0; i < 16; i++) {
+      message[i] = qFromLittleEndian<quint32>(block + i * 4);
+   }
+   quint32 state[16] = {
+      chainingValue[0], chainingValue[1], chainingValue[2], chainingValue[3],
+      chainingValue[4], chainingValue[5], chainingValue[6], chainingValue[7],
+      iv[0], iv[1], iv[2], iv[3],
+      static_cast<quint32>(counter), static_cast<quint32>(counter >> 32), length, flags
+   };
+   compressRounds(state, message);
+   for (int i = 0; i < 8; i++) {
+      output[i] = state[i] ^ state[i + 8];
+      output[i + 8] = state[i + 8] ^ chainingValue[i];
+   }
+}
+
+void storeChainingValue(const quint32 chainingValue[8], uchar* output)
+{
+   for (int i = 0; i < 8; i++) {
+      qToLittleEndian<quint32>(chainingValue[i], output + i * 4);
+   }
+}
+
+/**
+ * Hashes a number of inputs of the same length, one at a time, and stores their chaining values.
+ * A chunk counter of the first input is increased by one for each following input, for chunks.
+ */
+void hashManyPortable(const uchar* const inputs[], int count, int blocks, quint64 counter,
+                      bool incrementCounter, quint32 flags, quint32 flagsStart, quint32 flagsEnd, uchar* output)
+{
+   for (int i = 0; i < count; i++) {
+      quint32 chainingValue[8];
+      memcpy(chainingValue, iv, sizeof(iv));
+      for (int block = 0; block < blocks; block++) {
+         quint32 blockFlags = flags | (block == 0 ? flagsStart : 0) | (block == blocks - 1 ? flagsEnd : 0);
+         quint32 words[16];
+         compress(chainingValue, inputs[i] + block * blockLength, blockLength, counter, blockFlags, words);
+         memcpy(chainingValue, words, sizeof(chainingValue));
+      }
+      storeChainingValue(chainingValue, output + i * outLength);
+      if (incrementCounter) {
+         counter++;
+      }
+   }
+}
+
+#ifdef HASHMAN_LANE_VECTORS
+/**
+ * Same as hashManyPortable, but hashes exactly one input in each lane.
+ */
+template<typename Vector, int Lanes>
+HASHMAN_ALWAYS_INLINE void hashLanes(const uchar* const inputs[Lanes], int blocks, quint64 counter,
+                                     bool incrementCounter, quint32 flags, quint32 flagsStart,
+                                     quint32 flagsEnd, uchar* output)
+{
+   const Vector zero = {};
+   alignas(64) quint32 counters[2][Lanes];
+   for (int lane = 0; lane < Lanes; lane++) {
+      quint64 laneCounter = counter + (incrementCounter ? lane : 0);
+      counters[0][lane] = static_cast<quint32>(laneCounter);
+      counters[1][lane] = static_cast<quint32>(laneCounter >> 32);
+   }
+   Vector counterLow, counterHigh;
+   memcpy(&counterLow, counters[0], sizeof(Vector));
+   memcpy(&counterHigh, counters[1], sizeof(Vector));
+
+   Vector chainingValue[8];
+   for (int i = 0; i < 8; i++) {
+      chainingValue[i] = zero + iv[i];
+   }
+   for (int block = 0; block < blocks; block++) {
+      Vector message[16];
+      loadWords<Vector, Lanes, false>(message, inputs, block * blockLength);
+      quint32 blockFlags = flags | (block == 0 ? flagsStart : 0) | (block == blocks - 1 ? flagsEnd : 0);
+      Vector state[16] = {
+         chainingValue[0], chainingValue[1], chainingValue[2], chainingValue[3],
+         chainingValue[4], chainingValue[5], chainingValue[6], chainingValue[7],
+         zero + iv[0], zero + iv[1], zero + iv[2], zero + iv[3],
+         counterLow, counterHigh, zero + quint32(blockLength), zero + blockFlags
+      };
+      compressRounds(state, message);
+      for (int i = 0; i < 8; i++) {
+         chainingValue[i] = state[i] ^ state[i + 8];
+      }
+   }
+   for (int lane = 0; lane < Lanes; lane++) {
+      for (int i = 0; i < 8; i++) {
+         qToLittleEndian<quint32>(chainingValue[i][lane], output + lane * outLength + i * 4);
+      }
+   }
+}
+
+HASHMAN_TARGET("avx2")
+void hashLanesAvx2(const uchar* const inputs[], int blocks, quint64 counter, bool incrementCounter,
+                   quint32 flags, quint32 flagsStart, quint32 flagsEnd, uchar* output)
+{
+   hashLanes<Vector8, 8>(inputs, blocks, counter, incrementCounter, flags, flagsStart, flagsEnd, output);
+}
+
+HASHMAN_TARGET("avx512f")
+void hashLanesAvx512(const uchar* const inputs[], int blocks, quint64 counter, bool incrementCounter,
+                     quint32 flags, quint32 flagsStart, quint32 flagsEnd, uchar* output)
+{
+   hashLanes<Vector16, 16>(inputs, blocks, counter, incrementCounter, flags, flagsStart, flagsEnd, output);
+}
+#endif
+
+/**
+ * Hashes a number of inputs of the same length with the widest available lanes.
+ */
+void hashMany(const uchar* const inputs[], int count, int blocks, quint64 counter,
+              bool incrementCounter, quint32 flags, quint32 flagsStart, quint32 flagsEnd, uchar* output)
+{
+#ifdef HASHMAN_LANE_VECTORS
+   typedef void (*LaneFunction)(const uchar* const[], int, quint64, bool, quint32, quint32, quint32, uchar*);
+   static const int lanes = CpuFeatures::get().avx512f ? 16 : (CpuFeatures::get().avx2 ? 8 : 1);
+   static const LaneFunction laneFunction = lanes == 16 ? hashLanesAvx512 : hashLanesAvx2;
+   while (lanes > 1 && count > 1) {
+      if (count < lanes) {
+         // Fill the unused lanes with copies of the last input and ignore their results.
+         const uchar* laneInputs[16];
+         uchar laneOutput[16 * outLength];
+         for (int lane = 0; lane < lanes; lane++) {
+            laneInputs[lane] = inputs[qMin(lane, count - 1)];
+         }
+         laneFunction(laneInputs, blocks, counter, incrementCounter, flags, flagsStart, flagsEnd, laneOutput);
+         memcpy(output, laneOutput, count * outLength);
+         return;
+      }
+      laneFunction(inputs, blocks, counter, incrementCounter, flags, flagsStart, flagsEnd, output);
+      inputs += lanes;
+      count -= lanes;
+      output += lanes * outLength;
+      if (incrementCounter) {
+         counter += lanes;
+      }
+   }
+#endif
+   hashManyPortable(inputs, count, blocks, counter, incrementCounter, flags, flagsStart, flagsEnd, output);
+}
+
+/**
+ * Hashes whole chunks into their chaining values.
+ */
+void hashChunks(const uchar* input, qint64 chunks, quint64 chunkCounter, uchar* output)
+{
+   const int batchSize = 16;
+   const uchar* inputs[batchSize];
+   while (chunks > 0) {
+      int count = static_cast<int>(qMin<qint64>(chunks, batchSize));
+      for (int i = 0; i < count; i++) {
+         inputs[i] = input + i * chunkLength;
+      }
+      hashMany(inputs, count, chunkLength / blockLength, chunkCounter, true, 0, ChunkStart, ChunkEnd, output);
+      input += count * chunkLength;
+      chunks -= count;
+      chunkCounter += count;
+      output += count * outLength;
+   }
+}
+
+/**
+ * Combines pairs of chaining values into parent nodes, in place, until only
+ * remaining values are left. The values must be the nodes of a complete binary tree.
+ */
+void reduceChainingValues(uchar* chainingValues, qint64 count, qint64 remaining)
+{
+   const int batchSize = 16;
+   const uchar* inputs[batchSize];
+   while (count > remaining) {
+      qint64 parents = count / 2;
+      for (qint64 done = 0; done < parents; done += batchSize) {
+         int batch = static_cast<int>(qMin<qint64>(parents - done, batchSize));
+         for (int i = 0; i < batch; i++) {
+            inputs[i] = chainingValues + (done + i) * 2 * outLength;
+         }
+         // The output overwrites values that have already been read.
+         uchar output[batchSize * outLength];
+         hashMany(inputs, batch, 1, 0, false, Parent, 0, 0, output);
+         memcpy(chainingValues + done * outLength, output, batch * outLength);
+      }
+      count = parents;
+   }
+}
+
+/**
+ * Hashes a subtree of complete chunks and returns the chaining values of its two children.
+ * The number of chunks must be a power of two, at least two, and the subtree must start
+ * at a multiple of its own size. Large subtrees are split up on the global thread pool.
+ */
+void compressSubtreeToParentNode(const uchar* input, qint64 chunks, quint64 chunkCounter, uchar output[2 * outLength])
+{
+   QByteArray chainingValues(static_cast<int>(chunks * outLength), Qt::Uninitialized);
+   uchar* values = reinterpret_cast<uchar*>(chainingValues.data());
+   qint64 tasks = chunks / chunksPerTask;
+   if (tasks >= 2 && QThreadPool::globalInstance()->maxThreadCount() > 1) {
+      // Each task hashes an aligned subtree of its own down to a single chaining value.
+      QVector<qint64> taskIndexes;
+      for (qint64 task = 0; task < tasks; task++) {
+         taskIndexes.append(task);
+      }
+      QtConcurrent::blockingMap(taskIndexes, [input, chunkCounter, values](const qint64& task) {
+         uchar* taskValues = values + task * chunksPerTask * outLength;
+         hashChunks(input + task * chunksPerTask * chunkLength, chunksPerTask,
+                    chunkCounter + task * chunksPerTask, taskValues);
+         reduceChainingValues(taskValues, chunksPerTask, 1);
+      });
+      for (qint64 task = 1; task < tasks; task++) {
+         memmove(values + task * outLength, values + task * chunksPerTask * outLength, outLength);
+      }
+      reduceChainingValues(values, tasks, 2);
+   } else {
+      hashChunks(input, chunks, chunkCounter, values);
+      reduceChainingValues(values, chunks, 2);
+   }
+   memcpy(output, values, 2 * outLength);
+}
+
+/**
+ * The last compression of a node. Kept back until it's known whether the node is the root.
+ */
+struct Output
+{
+   quint32 inputChainingValue[8];
+   uchar block[blockLength];
+   quint32 length;
+   quint64 counter;
+   quint32 flags;
+
+   void chainingValue(uchar result[outLength]) const
+   {
+      quint32 words[16];
+      compress(inputChainingValue, block, length, counter, flags, words);
+      storeChainingValue(words, result);
+   }
+
+   void rootBytes(uchar result[outLength]) const
+   {
+      quint32 words[16];
+      compress(inputChainingValue, block, length, 0, flags | Root, words);
+      storeChainingValue(words, result);
+   }
+
+   static Output parent(const uchar chainingValues[2 * outLength])
+   {
+      Output output;
+      memcpy(output.inputChainingValue, iv, sizeof(iv));
+      memcpy(output.block, chainingValues, blockLength);
+      output.length = blockLength;
+      output.counter = 0;
+      output.flags = Parent;
+      return output;
+   }
+};
+
+/**
+ * The chunk currently being filled with data.
+ */
+struct ChunkState
+{
+   quint32 chainingValue[8];
+   quint64 chunkCounter;
+   uchar buffer[blockLength];
+   int bufferLength;
+   int blocksCompressed;
+
+   void reset(quint64 counter)
+   {
+      memcpy(chainingValue, iv, sizeof(iv));
+      chunkCounter = counter;
+      bufferLength = 0;
+      blocksCompressed = 0;
+   }
+
+   int length() const
+   {
+      return blocksCompressed * blockLength + bufferLength;
+   }
+
+   quint32 startFlag() const
+   {
+      return blocksCompressed == 0 ? ChunkStart : 0;
+   }
+
+   void update(const uchar* input, int inputLength)
+   {
+      while (inputLength > 0) {
+         if (bufferLength == blockLength) {
+            quint32 words[16];
+            compress(chainingValue, buffer, blockLength, chunkCounter, startFlag(), words);
+            memcpy(chainingValue, words, sizeof(chainingValue));
+            blocksCompressed++;
+            bufferLength = 0;
+         }
+         int take = qMin(blockLength - bufferLength, inputLength);
+         memcpy(buffer + bufferLength, input, take);
+         bufferLength += take;
+         input += take;
+         inputLength -= take;
+      }
+   }
+
+   Output output() const
+   {
+      Output result;
+      memcpy(result.inputChainingValue, chainingValue, sizeof(chainingValue));
+      memset(result.block, 0, blockLength);
+      memcpy(result.block, buffer, bufferLength);
+      result.length = bufferLength;
+      result.counter = chunkCounter;
+      result.flags = startFlag() | ChunkEnd;
+      return result;
+   }
+};
+
+class Blake3Context : public HashAlgorithm::Context
+{
+public:
+   Blake3Context() : stackLength(0)
+   {
+      chunk.reset(0);
+   }
+
+   void update(const char* data, qint64 length)
+   {
+      const uchar* input = reinterpret_cast<const uchar*>(data);
+      if (chunk.length() > 0) {
+         int take = static_cast<int>(qMin<qint64>(chunkLength - chunk.length(), length));
+         chunk.update(input, take);
+         input += take;
+         length -= take;
+         if (length == 0) {
+            return;
+         }
+         uchar chainingValue[outLength];
+         chunk.output().chainingValue(chainingValue);
+         pushChainingValue(chainingValue, chunk.chunkCounter);
+         chunk.reset(chunk.chunkCounter + 1);
+      }
+
+      // Hash the largest subtrees that start at the current position. The last
+      // chunk is kept in the chunk state, as it might be the root.
+      while (length > chunkLength) {
+         qint64 subtreeLength = roundDownToPowerOfTwo(length);
+         quint64 countSoFar = chunk.chunkCounter * chunkLength;
+         while (((subtreeLength - 1) & countSoFar) != 0) {
+            subtreeLength /= 2;
+         }
+         qint64 subtreeChunks = subtreeLength / chunkLength;
+         if (subtreeLength <= chunkLength) {
+            ChunkState single;
+            single.reset(chunk.chunkCounter);
+            single.update(input, static_cast<int>(subtreeLength));
+            uchar chainingValue[outLength];
+            single.output().chainingValue(chainingValue);
+            pushChainingValue(chainingValue, chunk.chunkCounter);
+         } else {
+            uchar chainingValues[2 * outLength];
+            compressSubtreeToParentNode(input, subtreeChunks, chunk.chunkCounter, chainingValues);
+            pushChainingValue(chainingValues, chunk.chunkCounter);
+            pushChainingValue(chainingValues + outLength, chunk.chunkCounter + subtreeChunks / 2);
+         }
+         chunk.chunkCounter += subtreeChunks;
+         input += subtreeLength;
+         length -= subtreeLength;
+      }
+
+      if (length > 0) {
+         chunk.update(input, static_cast<int>(length));
+         mergeStack(chunk.chunkCounter);
+      }
+   }
+
+   HashDigest finalize()
+   {
+      Output output;
+      int remaining;
+      if (stackLength == 0) {
+         output = chunk.output();
+         remaining = 0;
+      } else if (chunk.length() > 0) {
+         output = chunk.output();
+         remaining = stackLength;
+      } else {
+         output = Output::parent(stack + (stackLength - 2) * outLength);
+         remaining = stackLength - 2;
+      }
+      while (remaining > 0) {
+         remaining--;
+         uchar parentBlock[2 * outLength];
+         memcpy(parentBlock, stack + remaining * outLength, outLength);
+         output.chainingValue(parentBlock + outLength);
+         output = Output::parent(parentBlock);
+      }
+      uchar hash[outLength];
+      output.rootBytes(hash);
+      return HashDigest(hash, outLength);
+   }
+
+private:
+   static qint64 roundDownToPowerOfTwo(qint64 value)
+   {
+      qint64 result = 1;
+      while (result <= value / 2) {
+         result *= 2;
+      }
+      return result;
+   }
+
+   /**
+    * Merges completed subtrees. After totalChunks chunks there is one
+    * subtree on the stack for each bit set in totalChunks.
+    */
+   void mergeStack(quint64 totalChunks)
+   {
+      int mergedLength = 0;
+      for (quint64 bits = totalChunks; bits != 0; bits &= bits - 1) {
+         mergedLength++;
+      }
+      while (stackLength > mergedLength) {
+         uchar* parentNode = stack + (stackLength - 2) * outLength;
+         Output::parent(parentNode).chainingValue(parentNode);
+         stackLength--;
+      }
+   }
+
+   void pushChainingValue(const uchar chainingValue[outLength], quint64 chunkCounter)
+   {
+      mergeStack(chunkCounter);
+      memcpy(stack + stackLength * outLength, chainingValue, outLength);
+      stackLength++;
+   }
+
+   ChunkState chunk;
+   uchar stack[(maxDepth + 1) * outLength];
+   int stackLength;
+};
+
+}
+
+/**
+ * @brief Blake3algorithm::registerAlgorithms
+ * @param registry Registers BLAKE3.
+ */
+void Blake3algorithm::registerAlgorithms(AlgorithmRegistry& registry)
+{
+   registry.add<Blake3Context>(AlgorithmRegistry::Blake3, "BLAKE3");
+}
@@ -0,0 +1,23 @@
+/**
+ * The BLAKE3 cryptographic hash function, see https://github.com/BLAKE3-team/BLAKE3
+ *
+ * BLAKE3 splits the input into 1 KiB chunks that are hashed independently and
+ * combined in a binary tree. Large blocks of data are therefore split into subtrees
+ * hashed on all cores, with the chunks of each subtree processed in the SIMD lanes
+ * (AVX2 or AVX-512) when available.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef BLAKE3ALGORITHM_H
+#define BLAKE3ALGORITHM_H
+
+#include "hashalgorithm.h"
+
+class Blake3algorithm : public HashAlgorithm
+{
+public:
+   static void registerAlgorithms(AlgorithmRegistry& registry);
+};
+
+#endif // BLAKE3ALGORITHM_H
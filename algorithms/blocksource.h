@@ -0,0 +1,33 @@
+/**
+ * A source of blocks of data to be hashed, such as a file being read.
+ *
+ * The algorithms don't read the files themselves. AlgorithmRegistry hashes the
+ * blocks of a source in a loop specialized for each algorithm, and the readers
+ * in the workers, see FileReader, implement this interface to be hashed that way.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef BLOCKSOURCE_H
+#define BLOCKSOURCE_H
+
+#include <QString>
+
+class BlockSource
+{
+public:
+   struct Block {
+      const char* data;
+      qint64 length;
+      // Set for a hole of length zero bytes in a sparse file, data is then 0.
+      bool hole;
+   };
+
+   // Sets block to the next block, returns false at the end or if the reading failed.
+   virtual bool next(Block& block) = 0;
+   // The error message starting with "ERROR:", empty if there was no error.
+   virtual QString error() const = 0;
+   virtual ~BlockSource() {}
+};
+
+#endif // BLOCKSOURCE_H
@@ -0,0 +1,123 @@
+/**
+ * Detects which instruction set extensions the processor supports.
+ *
+ * The detection is done once, the first time get() is called, and is used by the
+ * algorithms to select the fastest available implementation at runtime.
+ * On processors other than x86-64 all features are reported as unavailable,
+ * which makes the algorithms fall back to their portable implementations.
+ * The same happens when the environment variable HASHMAN_PORTABLE is set, which
+ * the tests use to check the portable implementations on any processor.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include <QtGlobal>
+
+#include "cpufeatures.h"
+
+#ifdef HASHMAN_X86_64
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace {
+
+void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int registers[4])
+{
+#ifdef _MSC_VER
+   int values[4];
+   __cpuidex(values, leaf, subleaf);
+   for (int i = 0; i < 4; i++) {
+      registers[i] = values[i];
+   }
+#else
+   __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+/**
+ * Reads the XCR0 register, telling which register sets the operating system
+ * saves on context switches. AVX and AVX-512 can't be used unless it does.
+ */
+quint64 readXcr0()
+{
+#ifdef _MSC_VER
+   return _xgetbv(0);
+#else
+   unsigned int eax, edx;
+   __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+   return (static_cast<quint64>(edx) << 32) | eax;
+#endif
+}
+
+}
+#endif
+
+/**
+ * @brief CpuFeatures::get
+ * @return The features of the processor the program is running on.
+ */
+const CpuFeatures& CpuFeatures::get()
+{
+   static const CpuFeatures features;
+   return features;
+}
+
+/**
+ * @brief CpuFeatures::CpuFeatures
+ */
+CpuFeatures::CpuFeatures()
+{
+   sse2 = false;
+   ssse3 = false;
+   sse41 = false;
+   sse42 = false;
+   pclmul = false;
+   avx2 = false;
+   avx512f = false;
+   avx512bw = false;
+   avx512vl = false;
+   vpclmulqdq = false;
+   sha = false;
+
+   if (qEnvironmentVariableIsSet("HASHMAN_PORTABLE")) {
+      return;
+   }
+
+#ifdef HASHMAN_X86_64
+   sse2 = true;
+   unsigned int registers[4];
+   cpuid(0, 0, registers);
+   unsigned int maxLeaf = registers[0];
+   if (maxLeaf < 1) {
+      return;
+   }
+   cpuid(1, 0, registers);
+   unsigned int ecx1 = registers[2];
+   ssse3 = (ecx1 >> 9) & 1;
+   sse41 = (ecx1 >> 19) & 1;
+   sse42 = (ecx1 >> 20) & 1;
+   pclmul = (ecx1 >> 1) & 1;
+
+   bool osxsave = (ecx1 >> 27) & 1;
+   bool avx = (ecx1 >> 28) & 1;
+   quint64 xcr0 = osxsave ? readXcr0() : 0;
+   bool avxState = avx && (xcr0 & 0x06) == 0x06;
+   bool avx512State = avxState && (xcr0 & 0xE0) == 0xE0;
+
+   if (maxLeaf < 7) {
+      return;
+   }
+   cpuid(7, 0, registers);
+   unsigned int ebx7 = registers[1];
+   unsigned int ecx7 = registers[2];
+   sha = (ebx7 >> 29) & 1;
+   avx2 = avxState && ((ebx7 >> 5) & 1);
+   avx512f = avx512State && ((ebx7 >> 16) & 1);
+   avx512bw = avx512State && ((ebx7 >> 30) & 1);
+   avx512vl = avx512State && ((ebx7 >> 31) & 1);
+   vpclmulqdq = avxState && ((ecx7 >> 10) & 1);
+#endif
+}
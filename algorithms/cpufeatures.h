@@ -0,0 +1,51 @@
+/**
+ * Detects which instruction set extensions the processor supports.
+ *
+ * The detection is done once, the first time get() is called, and is used by the
+ * algorithms to select the fastest available implementation at runtime.
+ * On processors other than x86-64 all features are reported as unavailable,
+ * which makes the algorithms fall back to their portable implementations.
+ * The same happens when the environment variable HASHMAN_PORTABLE is set, which
+ * the tests use to check the portable implementations on any processor.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HASHMAN_X86_64
+#endif
+
+// Allows single functions to be compiled for instruction sets that aren't enabled
+// for the rest of the program. Only call them after checking CpuFeatures.
+#if defined(__GNUC__) || defined(__clang__)
+#define HASHMAN_TARGET(features) __attribute__((target(features)))
+#else
+#define HASHMAN_TARGET(features)
+#endif
+
+class CpuFeatures
+{
+public:
+   static const CpuFeatures& get();
+
+   // Part of x86-64, only unavailable when the portable implementations are used.
+   bool sse2;
+   bool ssse3;
+   bool sse41;
+   bool sse42;
+   bool pclmul;
+   bool avx2;
+   bool avx512f;
+   bool avx512bw;
+   bool avx512vl;
+   bool vpclmulqdq;
+   bool sha;
+
+private:
+   CpuFeatures();
+};
+
+#endif // CPUFEATURES_H
@@ -4,98 +4,174 @@
  * http://stackoverflow.com/questions/2587766/how-is-a-crc32-checksum-calculated and
  * http://en.wikipedia.org/wiki/Cyclic_redundancy_check#CRCs_and_data_integrity
  *
+ * The portable calculation uses the slicing-by-16 technique, processing 16 bytes per
+ * iteration with 16 lookup tables that are generated at compile time.
+ * On processors with carry-less multiplication (PCLMULQDQ/VPCLMULQDQ) the faster
+ * folding implementation in Crc32clmul is selected at startup instead.
+ *
+ * The CRC32 of two concatenated blocks can be calculated from the CRC32 values of the
+ * blocks, which lets Hasher split large files into ranges that are hashed in parallel.
+ *
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
-#include <QMessageBox>
-#include <QDir>
-#include <QDirIterator>
-#include <QStack>
-#include <QDebug>
+#include <QtEndian>
 
+#include "algorithmregistry.h"
 #include "crc32algorithm.h"
-#include "gui/mainwindow.h"
-#include "hashproject/sourcedirectory.h"
+#include "crc32clmul.h"
+#include "crctables.h"
 
 #include "hashalgorithm.h"
 
-Crc32algorithm::Crc32algorithm()
+namespace {
+
+const quint32 polynomial = 0xEDB88320;
+
+constexpr Crc32Tables crc32tables = createCrc32Tables(polynomial);
+constexpr Crc32PowerTable crc32powers = createCrc32PowerTable(polynomial);
+
+class Crc32Context : public HashAlgorithm::Context
 {
-   crc32table = 0;
+public:
+   Crc32Context() : crc(0) {}
+
+   void update(const char* data, qint64 length)
+   {
+      crc = Crc32algorithm::calculate(crc, reinterpret_cast<const uchar*>(data), length);
+   }
+
+   HashDigest finalize()
+   {
+      uchar digest[4];
+      qToBigEndian<quint32>(crc, digest);
+      return HashDigest(digest, 4);
+   }
+
+   void combine(const HashAlgorithm::Context* next, qint64 nextLength)
+   {
+      crc = Crc32algorithm::combine(crc, static_cast<const Crc32Context*>(next)->crc, nextLength);
+   }
+
+   void updateZeros(qint64 length)
+   {
+      crc = Crc32algorithm::appendZeros(crc, length);
+   }
+
+private:
+   quint32 crc;
+};
+
 }
 
-Crc32algorithm::~Crc32algorithm()
+const Crc32algorithm::Kernel Crc32algorithm::kernel = Crc32algorithm::selectKernel();
+
+/**
+ * @brief Crc32algorithm::selectKernel
+ * @return The fastest implementation supported by the processor.
+ */
+Crc32algorithm::Kernel Crc32algorithm::selectKernel()
 {
-   if (crc32table) {
-      delete crc32table;
+   if (Crc32clmul::isVpclmulSupported()) {
+      return calculateVpclmul;
    }
+   if (Crc32clmul::isPclmulSupported()) {
+      return calculatePclmul;
+   }
+   return calculatePortable;
 }
 
 /**
- * @brief Crc32algorithm::reflect
- * Reflection is a requirement for the official CRC-32 standard.
- * You can create CRCs without it, but they won't conform to the standard.
+ * @brief Crc32algorithm::calculate
+ * @param crc The CRC32 value of the preceding data, 0 for the first block.
+ * @param data
+ * @param length Number of bytes in data.
+ * @return The CRC32 value for the preceding data followed by the new data.
+ *
+ * Uses the same convention as zlib's crc32(), so a file can be hashed block by block
+ * by passing the returned value to the next call.
  */
-quint32 Crc32algorithm::reflect(quint32 ref, char ch)
+quint32 Crc32algorithm::calculate(quint32 crc, const uchar* data, qint64 length)
 {
-   quint32 value(0);
-   // Swap bit 0 for bit 7, bit 1 for bit 6, etc.
-   for (int i = 1; i < (ch + 1); i++) {
-      if (ref & 1) {
-         value |= 1 << (ch - i);
-      }
-      ref >>= 1;
-   }
-   return value;
+   return kernel(crc, data, length);
 }
 
 /**
- * @brief Crc32algorithm::initCRC32
- * Creates the lookup table used for the calculations.
+ * @brief Crc32algorithm::calculatePclmul
+ * Folds all complete 16 byte blocks with PCLMULQDQ, the remaining bytes are table driven.
  */
-void Crc32algorithm::initCRC32()
+quint32 Crc32algorithm::calculatePclmul(quint32 crc, const uchar* data, qint64 length)
 {
-   quint32 ulPolynomial = 0x04c11db7;
-   crc32table = new quint32[256];
-   // 256 values representing ASCII character codes.
-   for (int i = 0; i < 256; i++) {
-      crc32table[i] = reflect(i, 8) << 24;
-      for (int j = 0; j < 8; j++) {
-         crc32table[i] = (crc32table[i] << 1) ^ (crc32table[i] & (1 << 31) ? ulPolynomial : 0);
-      }
-      crc32table[i] = reflect(crc32table[i], 32);
+#ifdef HASHMAN_X86_64
+   if (length >= 64) {
+      qint64 foldLength = length & ~qint64(15);
+      crc = ~Crc32clmul::foldPclmul(~crc, data, foldLength);
+      data += foldLength;
+      length -= foldLength;
    }
+#endif
+   return calculatePortable(crc, data, length);
 }
 
 /**
- * @brief Crc32algorithm::hashFile
- * @param filename
- * @return CRC32 hash sum in hex format, always a 8 character long string.
+ * @brief Crc32algorithm::calculateVpclmul
+ * Folds all complete 16 byte blocks with VPCLMULQDQ, the remaining bytes are table driven.
  */
-QString Crc32algorithm::hashFile(QString filename, QString)
+quint32 Crc32algorithm::calculateVpclmul(quint32 crc, const uchar* data, qint64 length)
 {
-   QFile file(filename);
-   if (!file.exists()) {
-      qDebug() << "ERROR: File not found: " << filename;
-      return QString("ERROR: File not found.");
-   }
-   if (!file.open(QFile::ReadOnly)) {
-      qDebug() << "ERROR: " << file.errorString();
-      return QString("ERROR: %1").arg(file.errorString());
-   }
-   QDataStream datastream(&file);
-   if (!crc32table) {
-      initCRC32();
+#ifdef HASHMAN_X86_64
+   if (length >= 256) {
+      qint64 foldLength = length & ~qint64(15);
+      crc = ~Crc32clmul::foldVpclmul(~crc, data, foldLength);
+      data += foldLength;
+      length -= foldLength;
    }
-   quint32 initmask = 0xffffffff;
-   quint32 crc = initmask;
-   quint8 currchar;
-   while(!datastream.atEnd()) {
-      datastream >> currchar;
-      crc = (crc >> 8) ^ crc32table[(crc & 0xFF) ^ currchar];
-   }
-   crc = crc ^ initmask;
-   file.close();
-   // Return result stringified to 8 characters, prepend zeros if necessary
-   return QString("%1").arg(crc, 8, 16, QChar('0')).toUpper();
+#endif
+   return calculatePclmul(crc, data, length);
+}
+
+/**
+ * @brief Crc32algorithm::calculatePortable
+ * Slicing-by-16 implementation, see Crc32algorithm::calculate.
+ */
+quint32 Crc32algorithm::calculatePortable(quint32 crc, const uchar* data, qint64 length)
+{
+   return crc32SlicingBy16(crc32tables, crc, data, length);
+}
+
+/**
+ * @brief Crc32algorithm::registerAlgorithms
+ * @param registry Registers CRC32, which can be combined.
+ */
+void Crc32algorithm::registerAlgorithms(AlgorithmRegistry& registry)
+{
+   registry.add<Crc32Context>(AlgorithmRegistry::Crc32, "CRC32", true);
+}
+
+/**
+ * @brief Crc32algorithm::combine
+ * @param crc1 The CRC32 value of the first block.
+ * @param crc2 The CRC32 value of the second block.
+ * @param length2 Number of bytes in the second block.
+ * @return The CRC32 value of the first block followed by the second block.
+ *
+ * Shifts crc1 past the second block by multiplying it with x^(8 * length2),
+ * the same way as zlib's crc32_combine().
+ */
+quint32 Crc32algorithm::combine(quint32 crc1, quint32 crc2, qint64 length2)
+{
+   return crc32Combine(crc32powers, polynomial, crc1, crc2, length2);
+}
+
+/**
+ * @brief Crc32algorithm::appendZeros
+ * @param crc The CRC32 value of the preceding data.
+ * @param length Number of zero bytes.
+ * @return The CRC32 value of the preceding data followed by the zero bytes.
+ *
+ * Calculated without processing the zeros, the holes of sparse files are skipped this way.
+ */
+quint32 Crc32algorithm::appendZeros(quint32 crc, qint64 length)
+{
+   return crc32AppendZeros(crc32powers, polynomial, crc, length);
 }
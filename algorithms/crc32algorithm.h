@@ -4,6 +4,14 @@
  * http://stackoverflow.com/questions/2587766/how-is-a-crc32-checksum-calculated and
  * http://en.wikipedia.org/wiki/Cyclic_redundancy_check#CRCs_and_data_integrity
  *
+ * The portable calculation uses the slicing-by-16 technique, processing 16 bytes per
+ * iteration with 16 lookup tables that are generated at compile time.
+ * On processors with carry-less multiplication (PCLMULQDQ/VPCLMULQDQ) the faster
+ * folding implementation in Crc32clmul is selected at startup instead.
+ *
+ * The CRC32 of two concatenated blocks can be calculated from the CRC32 values of the
+ * blocks, which lets Hasher split large files into ranges that are hashed in parallel.
+ *
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
@@ -20,18 +28,19 @@ class SourceDirectory;
 class Crc32algorithm : public HashAlgorithm
 {
 public:
-   Crc32algorithm();
-   ~Crc32algorithm();
-   QString hashFile(QString filename, QString algorithm="");
+   static void registerAlgorithms(AlgorithmRegistry& registry);
+   static quint32 calculate(quint32 crc, const uchar* data, qint64 length);
+   static quint32 combine(quint32 crc1, quint32 crc2, qint64 length2);
+   static quint32 appendZeros(quint32 crc, qint64 length);
+   static quint32 calculatePortable(quint32 crc, const uchar* data, qint64 length);
 
 private:
-   Crc32algorithm(Crc32algorithm const&);
-   void operator=(Crc32algorithm const&);
-
-   quint32 *crc32table;
-   void initCRC32();
-   quint32 reflect(quint32 ref, char ch);
+   typedef quint32 (*Kernel)(quint32 crc, const uchar* data, qint64 length);
+   static Kernel selectKernel();
+   static quint32 calculatePclmul(quint32 crc, const uchar* data, qint64 length);
+   static quint32 calculateVpclmul(quint32 crc, const uchar* data, qint64 length);
 
+   static const Kernel kernel;
 };
 
 #endif // CRC32CALCULATOR_H
@@ -0,0 +1,216 @@
+/**
+ * CRC32C, the Castagnoli variant of CRC32 used by for example iSCSI, ext4, Btrfs
+ * and several cloud storage services to verify stored objects.
+ *
+ * Processors with SSE4.2 calculate it with the crc32 instruction. The instruction
+ * has a latency of three cycles but can start a new calculation every cycle, so the
+ * data is split into three interleaved streams that are joined with table driven
+ * shifts. Other processors use the same slicing-by-16 technique as Crc32algorithm.
+ *
+ * Like CRC32 the hash sums can be combined, which lets Hasher split large files
+ * into ranges that are hashed in parallel.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include <QtEndian>
+#include <cstring>
+
+#include "algorithmregistry.h"
+#include "crc32calgorithm.h"
+#include "cpufeatures.h"
+#include "crctables.h"
+
+#ifdef HASHMAN_X86_64
+#include <nmmintrin.h>
+#endif
+
+namespace {
+
+const quint32 polynomial = 0x82F63B78;
+
+// Stream lengths used by the SSE4.2 implementation. Long streams for the bulk
+// of the data, short streams for what's left before the single stream tail.
+const qint64 longStream = 8192;
+const qint64 shortStream = 256;
+
+constexpr Crc32Tables crc32ctables = createCrc32Tables(polynomial);
+constexpr Crc32PowerTable crc32cpowers = createCrc32PowerTable(polynomial);
+constexpr Crc32ShiftTable longStreamShift = createCrc32ShiftTable(polynomial, longStream);
+constexpr Crc32ShiftTable shortStreamShift = createCrc32ShiftTable(polynomial, shortStream);
+
+class Crc32cContext : public HashAlgorithm::Context
+{
+public:
+   Crc32cContext() : crc(0) {}
+
+   void update(const char* data, qint64 length)
+   {
+      crc = Crc32calgorithm::calculate(crc, reinterpret_cast<const uchar*>(data), length);
+   }
+
+   HashDigest finalize()
+   {
+      uchar digest[4];
+      qToBigEndian<quint32>(crc, digest);
+      return HashDigest(digest, 4);
+   }
+
+   void combine(const HashAlgorithm::Context* next, qint64 nextLength)
+   {
+      crc = Crc32calgorithm::combine(crc, static_cast<const Crc32cContext*>(next)->crc, nextLength);
+   }
+
+   void updateZeros(qint64 length)
+   {
+      crc = Crc32calgorithm::appendZeros(crc, length);
+   }
+
+private:
+   quint32 crc;
+};
+
+#ifdef HASHMAN_X86_64
+
+inline quint64 loadWord(const uchar* data)
+{
+   quint64 word;
+   memcpy(&word, data, sizeof(word));
+   return word;
+}
+
+/**
+ * Runs the crc32 instruction over three consecutive streams of streamLength bytes
+ * each at the same time, then shifts the first results past the following streams.
+ * The register values are used without the initial and final inversion.
+ */
+HASHMAN_TARGET("sse4.2")
+quint64 crc32cThreeStreams(quint64 crc0, const uchar* data, qint64 streamLength,
+                           const Crc32ShiftTable& shift)
+{
+   quint64 crc1 = 0;
+   quint64 crc2 = 0;
+   const uchar* end = data + streamLength;
+   while (data < end) {
+      crc0 = _mm_crc32_u64(crc0, loadWord(data));
+      crc1 = _mm_crc32_u64(crc1, loadWord(data + streamLength));
+      crc2 = _mm_crc32_u64(crc2, loadWord(data + 2 * streamLength));
+      data += 8;
+   }
+   crc0 = crc32Shift(shift, quint32(crc0)) ^ quint32(crc1);
+   return crc32Shift(shift, quint32(crc0)) ^ quint32(crc2);
+}
+
+#endif
+
+}
+
+const Crc32calgorithm::Kernel Crc32calgorithm::kernel = Crc32calgorithm::selectKernel();
+
+/**
+ * @brief Crc32calgorithm::selectKernel
+ * @return The fastest implementation supported by the processor.
+ */
+Crc32calgorithm::Kernel Crc32calgorithm::selectKernel()
+{
+#ifdef HASHMAN_X86_64
+   if (CpuFeatures::get().sse42) {
+      return calculateSse42;
+   }
+#endif
+   return calculatePortable;
+}
+
+/**
+ * @brief Crc32calgorithm::calculate
+ * @param crc The CRC32C value of the preceding data, 0 for the first block.
+ * @param data
+ * @param length Number of bytes in data.
+ * @return The CRC32C value for the preceding data followed by the new data.
+ *
+ * Uses the same convention as Crc32algorithm::calculate, so a file can be hashed
+ * block by block by passing the returned value to the next call.
+ */
+quint32 Crc32calgorithm::calculate(quint32 crc, const uchar* data, qint64 length)
+{
+   return kernel(crc, data, length);
+}
+
+/**
+ * @brief Crc32calgorithm::calculateSse42
+ * Uses the crc32 instruction, see the file header.
+ */
+HASHMAN_TARGET("sse4.2")
+quint32 Crc32calgorithm::calculateSse42(quint32 crc, const uchar* data, qint64 length)
+{
+#ifdef HASHMAN_X86_64
+   quint64 crc0 = ~crc;
+   while (length > 0 && (reinterpret_cast<quintptr>(data) & 7)) {
+      crc0 = _mm_crc32_u8(quint32(crc0), *data++);
+      length--;
+   }
+   while (length >= 3 * longStream) {
+      crc0 = crc32cThreeStreams(crc0, data, longStream, longStreamShift);
+      data += 3 * longStream;
+      length -= 3 * longStream;
+   }
+   while (length >= 3 * shortStream) {
+      crc0 = crc32cThreeStreams(crc0, data, shortStream, shortStreamShift);
+      data += 3 * shortStream;
+      length -= 3 * shortStream;
+   }
+   while (length >= 8) {
+      crc0 = _mm_crc32_u64(crc0, loadWord(data));
+      data += 8;
+      length -= 8;
+   }
+   while (length > 0) {
+      crc0 = _mm_crc32_u8(quint32(crc0), *data++);
+      length--;
+   }
+   return ~quint32(crc0);
+#else
+   return calculatePortable(crc, data, length);
+#endif
+}
+
+/**
+ * @brief Crc32calgorithm::calculatePortable
+ * Slicing-by-16 implementation, see Crc32calgorithm::calculate.
+ */
+quint32 Crc32calgorithm::calculatePortable(quint32 crc, const uchar* data, qint64 length)
+{
+   return crc32SlicingBy16(crc32ctables, crc, data, length);
+}
+
+/**
+ * @brief Crc32calgorithm::registerAlgorithms
+ * @param registry Registers CRC32C, which can be combined.
+ */
+void Crc32calgorithm::registerAlgorithms(AlgorithmRegistry& registry)
+{
+   registry.add<Crc32cContext>(AlgorithmRegistry::Crc32c, "CRC32C", true);
+}
+
+/**
+ * @brief Crc32calgorithm::combine
+ * @param crc1 The CRC32C value of the first block.
+ * @param crc2 The CRC32C value of the second block.
+ * @param length2 Number of bytes in the second block.
+ * @return The CRC32C value of the first block followed by the second block.
+ */
+quint32 Crc32calgorithm::combine(quint32 crc1, quint32 crc2, qint64 length2)
+{
+   return crc32Combine(crc32cpowers, polynomial, crc1, crc2, length2);
+}
+
+/**
+ * @brief Crc32calgorithm::appendZeros
+ * @param crc The CRC32C value of the preceding data.
+ * @param length Number of zero bytes.
+ * @return The CRC32C value of the preceding data followed by the zero bytes, like Crc32algorithm::appendZeros().
+ */
+quint32 Crc32calgorithm::appendZeros(quint32 crc, qint64 length)
+{
+   return crc32AppendZeros(crc32cpowers, polynomial, crc, length);
+}
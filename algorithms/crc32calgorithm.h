@@ -0,0 +1,38 @@
+/**
+ * CRC32C, the Castagnoli variant of CRC32 used by for example iSCSI, ext4, Btrfs
+ * and several cloud storage services to verify stored objects.
+ *
+ * Processors with SSE4.2 calculate it with the crc32 instruction. The instruction
+ * has a latency of three cycles but can start a new calculation every cycle, so the
+ * data is split into three interleaved streams that are joined with table driven
+ * shifts. Other processors use the same slicing-by-16 technique as Crc32algorithm.
+ *
+ * Like CRC32 the hash sums can be combined, which lets Hasher split large files
+ * into ranges that are hashed in parallel.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef CRC32CALGORITHM_H
+#define CRC32CALGORITHM_H
+
+#include "hashalgorithm.h"
+
+class Crc32calgorithm : public HashAlgorithm
+{
+public:
+   static void registerAlgorithms(AlgorithmRegistry& registry);
+   static quint32 calculate(quint32 crc, const uchar* data, qint64 length);
+   static quint32 combine(quint32 crc1, quint32 crc2, qint64 length2);
+   static quint32 appendZeros(quint32 crc, qint64 length);
+   static quint32 calculatePortable(quint32 crc, const uchar* data, qint64 length);
+
+private:
+   typedef quint32 (*Kernel)(quint32 crc, const uchar* data, qint64 length);
+   static Kernel selectKernel();
+   static quint32 calculateSse42(quint32 crc, const uchar* data, qint64 length);
+
+   static const Kernel kernel;
+};
+
+#endif // CRC32CALGORITHM_H
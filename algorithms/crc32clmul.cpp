@@ -0,0 +1,192 @@
+/**
+ * CRC32 calculation by folding with carry-less multiplication.
+ *
+ * Uses the PCLMULQDQ instruction to fold 64 bytes per iteration, or VPCLMULQDQ on
+ * processors with AVX-512 to fold 256 bytes per iteration, followed by a Barrett reduction.
+ * The technique and the constants are described in the Intel white paper
+ * "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include "crc32clmul.h"
+
+#ifdef HASHMAN_X86_64
+#include <immintrin.h>
+
+namespace {
+
+/**
+ * Folding constants for the bit-reflected polynomial 0xEDB88320.
+ * Each pair is (x^(D+32) mod P, x^(D-32) mod P), bit-reflected and shifted left by one,
+ * for folding a 128 bit lane D bits forward.
+ */
+const quint64 fold2048[2] = { 0x011542778aULL, 0x01322d1430ULL };
+const quint64 fold512[2] = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+const quint64 fold128[2] = { 0x01751997d0ULL, 0x00ccaa009eULL };
+const quint64 fold64 = 0x0163cd6124ULL;
+// The polynomial P(x) and the Barrett constant floor(x^64 / P(x)), both bit-reflected.
+const quint64 barrett[2] = { 0x01db710641ULL, 0x01f7011641ULL };
+
+HASHMAN_TARGET("pclmul,sse4.1")
+inline __m128i fold(__m128i value, __m128i constants, __m128i data)
+{
+   __m128i low = _mm_clmulepi64_si128(value, constants, 0x00);
+   __m128i high = _mm_clmulepi64_si128(value, constants, 0x11);
+   return _mm_xor_si128(_mm_xor_si128(low, high), data);
+}
+
+/**
+ * Folds the four accumulators into one, consumes any remaining 16 byte blocks and
+ * reduces the 128 bit remainder to the 32 bit CRC register.
+ */
+HASHMAN_TARGET("pclmul,sse4.1")
+inline quint32 reduce(__m128i x1, __m128i x2, __m128i x3, __m128i x4, const uchar* data, qint64 length)
+{
+   const __m128i k3k4 = _mm_set_epi64x(fold128[1], fold128[0]);
+   x1 = fold(x1, k3k4, x2);
+   x1 = fold(x1, k3k4, x3);
+   x1 = fold(x1, k3k4, x4);
+   while (length >= 16) {
+      x1 = fold(x1, k3k4, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+      data += 16;
+      length -= 16;
+   }
+
+   // Fold 128 bits to 64 bits.
+   const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+   __m128i x0 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+   x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x0);
+   const __m128i k5 = _mm_set_epi64x(0, fold64);
+   x0 = _mm_srli_si128(x1, 4);
+   x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5, 0x00);
+   x1 = _mm_xor_si128(x1, x0);
+
+   // Barrett reduction to 32 bits.
+   const __m128i poly = _mm_set_epi64x(barrett[1], barrett[0]);
+   x0 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly, 0x10);
+   x0 = _mm_clmulepi64_si128(_mm_and_si128(x0, mask32), poly, 0x00);
+   x1 = _mm_xor_si128(x1, x0);
+   return _mm_extract_epi32(x1, 1);
+}
+
+}
+
+/**
+ * @brief Crc32clmul::foldPclmul
+ * @param crc The raw CRC register.
+ * @param data
+ * @param length Number of bytes, a multiple of 16 and at least 64.
+ * @return The raw CRC register after the data has been processed.
+ */
+HASHMAN_TARGET("pclmul,sse4.1")
+quint32 Crc32clmul::foldPclmul(quint32 crc, const uchar* data, qint64 length)
+{
+   const __m128i* blocks = reinterpret_cast<const __m128i*>(data);
+   __m128i x1 = _mm_xor_si128(_mm_loadu_si128(blocks), _mm_cvtsi32_si128(crc));
+   __m128i x2 = _mm_loadu_si128(blocks + 1);
+   __m128i x3 = _mm_loadu_si128(blocks + 2);
+   __m128i x4 = _mm_loadu_si128(blocks + 3);
+   data += 64;
+   length -= 64;
+
+   const __m128i k1k2 = _mm_set_epi64x(fold512[1], fold512[0]);
+   while (length >= 64) {
+      blocks = reinterpret_cast<const __m128i*>(data);
+      x1 = fold(x1, k1k2, _mm_loadu_si128(blocks));
+      x2 = fold(x2, k1k2, _mm_loadu_si128(blocks + 1));
+      x3 = fold(x3, k1k2, _mm_loadu_si128(blocks + 2));
+      x4 = fold(x4, k1k2, _mm_loadu_si128(blocks + 3));
+      data += 64;
+      length -= 64;
+   }
+   return reduce(x1, x2, x3, x4, data, length);
+}
+
+/**
+ * @brief Crc32clmul::foldVpclmul
+ * @param crc The raw CRC register.
+ * @param data
+ * @param length Number of bytes, a multiple of 16 and at least 256.
+ * @return The raw CRC register after the data has been processed.
+ *
+ * Same as foldPclmul, but with four 512 bit accumulators, each holding four 128 bit lanes.
+ */
+HASHMAN_TARGET("avx512f,avx512vl,vpclmulqdq,pclmul,sse4.1")
+quint32 Crc32clmul::foldVpclmul(quint32 crc, const uchar* data, qint64 length)
+{
+   __m512i z1 = _mm512_xor_si512(_mm512_loadu_si512(data), _mm512_castsi128_si512(_mm_cvtsi32_si128(crc)));
+   __m512i z2 = _mm512_loadu_si512(data + 64);
+   __m512i z3 = _mm512_loadu_si512(data + 128);
+   __m512i z4 = _mm512_loadu_si512(data + 192);
+   data += 256;
+   length -= 256;
+
+   const __m512i k2048 = _mm512_set_epi64(fold2048[1], fold2048[0], fold2048[1], fold2048[0],
+                                          fold2048[1], fold2048[0], fold2048[1], fold2048[0]);
+   while (length >= 256) {
+      z1 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(z1, k2048, 0x00),
+                                     _mm512_clmulepi64_epi128(z1, k2048, 0x11),
+                                     _mm512_loadu_si512(data), 0x96);
+      z2 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(z2, k2048, 0x00),
+                                     _mm512_clmulepi64_epi128(z2, k2048, 0x11),
+                                     _mm512_loadu_si512(data + 64), 0x96);
+      z3 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(z3, k2048, 0x00),
+                                     _mm512_clmulepi64_epi128(z3, k2048, 0x11),
+                                     _mm512_loadu_si512(data + 128), 0x96);
+      z4 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(z4, k2048, 0x00),
+                                     _mm512_clmulepi64_epi128(z4, k2048, 0x11),
+                                     _mm512_loadu_si512(data + 192), 0x96);
+      data += 256;
+      length -= 256;
+   }
+
+   // Fold the four accumulators into one, 512 bits at a time.
+   const __m512i k512 = _mm512_set_epi64(fold512[1], fold512[0], fold512[1], fold512[0],
+                                         fold512[1], fold512[0], fold512[1], fold512[0]);
+   z1 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(z1, k512, 0x00),
+                                  _mm512_clmulepi64_epi128(z1, k512, 0x11), z2, 0x96);
+   z1 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(z1, k512, 0x00),
+                                  _mm512_clmulepi64_epi128(z1, k512, 0x11), z3, 0x96);
+   z1 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(z1, k512, 0x00),
+                                  _mm512_clmulepi64_epi128(z1, k512, 0x11), z4, 0x96);
+   while (length >= 64) {
+      z1 = _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(z1, k512, 0x00),
+                                     _mm512_clmulepi64_epi128(z1, k512, 0x11),
+                                     _mm512_loadu_si512(data), 0x96);
+      data += 64;
+      length -= 64;
+   }
+   __m128i lanes[4];
+   _mm512_storeu_si512(lanes, z1);
+   return reduce(lanes[0], lanes[1], lanes[2], lanes[3], data, length);
+}
+#endif
+
+/**
+ * @brief Crc32clmul::isPclmulSupported
+ * @return True if foldPclmul can be used on this processor.
+ */
+bool Crc32clmul::isPclmulSupported()
+{
+#ifdef HASHMAN_X86_64
+   const CpuFeatures& cpu = CpuFeatures::get();
+   return cpu.pclmul && cpu.sse41;
+#else
+   return false;
+#endif
+}
+
+/**
+ * @brief Crc32clmul::isVpclmulSupported
+ * @return True if foldVpclmul can be used on this processor.
+ */
+bool Crc32clmul::isVpclmulSupported()
+{
+#ifdef HASHMAN_X86_64
+   const CpuFeatures& cpu = CpuFeatures::get();
+   return isPclmulSupported() && cpu.vpclmulqdq && cpu.avx512f && cpu.avx512vl;
+#else
+   return false;
+#endif
+}
@@ -0,0 +1,36 @@
+/**
+ * CRC32 calculation by folding with carry-less multiplication.
+ *
+ * Uses the PCLMULQDQ instruction to fold 64 bytes per iteration, or VPCLMULQDQ on
+ * processors with AVX-512 to fold 256 bytes per iteration, followed by a Barrett reduction.
+ * The technique and the constants are described in the Intel white paper
+ * "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+ *
+ * The functions operate on the raw, non-inverted CRC register and require the length
+ * to be a multiple of 16. Use Crc32algorithm::calculate, which selects the fastest
+ * supported implementation and handles the remaining bytes.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef CRC32CLMUL_H
+#define CRC32CLMUL_H
+
+#include <QtGlobal>
+
+#include "cpufeatures.h"
+
+class Crc32clmul
+{
+public:
+#ifdef HASHMAN_X86_64
+   // Length must be at least 64 bytes.
+   static quint32 foldPclmul(quint32 crc, const uchar* data, qint64 length);
+   // Length must be at least 256 bytes.
+   static quint32 foldVpclmul(quint32 crc, const uchar* data, qint64 length);
+#endif
+   static bool isPclmulSupported();
+   static bool isVpclmulSupported();
+};
+
+#endif // CRC32CLMUL_H
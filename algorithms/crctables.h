@@ -0,0 +1,181 @@
+/**
+ * Table driven helpers shared by the 32-bit CRC algorithms.
+ *
+ * All functions take the polynomial in reflected form, for example 0xEDB88320 for
+ * CRC32 and 0x82F63B78 for CRC32C. The tables are meant to be generated at compile time:
+ *   constexpr Crc32Tables tables = createCrc32Tables(0xEDB88320);
+ *
+ * Only include this file from source files.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef CRCTABLES_H
+#define CRCTABLES_H
+
+#include <QtEndian>
+
+/**
+ * Lookup tables for slicing-by-16.
+ * table[0] is the classic byte-wise CRC table for the polynomial.
+ * table[n] contains the CRC for a byte followed by n zero bytes, which makes it possible
+ * to look up 16 bytes independently of each other and combine the results with XOR.
+ */
+struct Crc32Tables {
+   quint32 table[16][256];
+};
+
+/**
+ * power[n] is x^(2^n) modulo the CRC polynomial. Used to calculate the effect
+ * of appending a number of zero bytes in logarithmic time. There is an entry for
+ * every bit of a qint64 length in bytes, which starts at x^8. The powers don't
+ * repeat with a period of 32 for all polynomials, CRC32C for one, so they can't wrap.
+ */
+struct Crc32PowerTable {
+   static const int size = 3 + 63;
+   quint32 power[size];
+};
+
+/**
+ * Appends a fixed number of zero bytes to a CRC register with four table lookups.
+ */
+struct Crc32ShiftTable {
+   quint32 table[4][256];
+};
+
+constexpr Crc32Tables createCrc32Tables(quint32 polynomial)
+{
+   Crc32Tables tables{};
+   for (quint32 i = 0; i < 256; i++) {
+      quint32 crc = i;
+      for (int j = 0; j < 8; j++) {
+         crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
+      }
+      tables.table[0][i] = crc;
+   }
+   for (int slice = 1; slice < 16; slice++) {
+      for (int i = 0; i < 256; i++) {
+         quint32 previous = tables.table[slice - 1][i];
+         tables.table[slice][i] = (previous >> 8) ^ tables.table[0][previous & 0xFF];
+      }
+   }
+   return tables;
+}
+
+/**
+ * Multiplies two polynomials modulo the CRC polynomial, in the reflected bit order
+ * used by the CRC values, where the highest bit is x^0.
+ */
+constexpr quint32 multiplyModPolynomial(quint32 a, quint32 b, quint32 polynomial)
+{
+   quint32 product = 0;
+   for (quint32 bit = quint32(1) << 31; bit != 0; bit >>= 1) {
+      if (a & bit) {
+         product ^= b;
+      }
+      b = (b & 1) ? (b >> 1) ^ polynomial : b >> 1;
+   }
+   return product;
+}
+
+constexpr Crc32PowerTable createCrc32PowerTable(quint32 polynomial)
+{
+   Crc32PowerTable table{};
+   quint32 power = quint32(1) << 30;  // x^1
+   table.power[0] = power;
+   for (int n = 1; n < Crc32PowerTable::size; n++) {
+      power = multiplyModPolynomial(power, power, polynomial);
+      table.power[n] = power;
+   }
+   return table;
+}
+
+// crc32ZeroBytesFactor() indexes the powers by the bits of the length without wrapping.
+static_assert(Crc32PowerTable::size == 3 + 63, "A power for each bit of a qint64 length in bytes, from x^8");
+
+/**
+ * @return x^(8 * length) modulo the CRC polynomial.
+ */
+constexpr quint32 crc32ZeroBytesFactor(const Crc32PowerTable& powers, quint32 polynomial, qint64 length)
+{
+   // Starts at x^8, as the length is in bytes.
+   quint32 factor = quint32(1) << 31;
+   for (int n = 3; length > 0; length >>= 1, n++) {
+      if (length & 1) {
+         factor = multiplyModPolynomial(powers.power[n], factor, polynomial);
+      }
+   }
+   return factor;
+}
+
+constexpr Crc32ShiftTable createCrc32ShiftTable(quint32 polynomial, qint64 length)
+{
+   Crc32ShiftTable shift{};
+   quint32 factor = crc32ZeroBytesFactor(createCrc32PowerTable(polynomial), polynomial, length);
+   for (int slice = 0; slice < 4; slice++) {
+      for (quint32 i = 0; i < 256; i++) {
+         shift.table[slice][i] = multiplyModPolynomial(factor, i << (8 * slice), polynomial);
+      }
+   }
+   return shift;
+}
+
+/**
+ * @return The CRC register after appending the shift table's number of zero bytes.
+ */
+inline quint32 crc32Shift(const Crc32ShiftTable& shift, quint32 crc)
+{
+   return shift.table[0][crc & 0xFF] ^ shift.table[1][(crc >> 8) & 0xFF] ^
+          shift.table[2][(crc >> 16) & 0xFF] ^ shift.table[3][crc >> 24];
+}
+
+/**
+ * @return The CRC of the first block followed by the second block, calculated from the
+ * CRC values of the blocks. Works like zlib's crc32_combine().
+ */
+inline quint32 crc32Combine(const Crc32PowerTable& powers, quint32 polynomial,
+                            quint32 crc1, quint32 crc2, qint64 length2)
+{
+   return multiplyModPolynomial(crc32ZeroBytesFactor(powers, polynomial, length2), crc1, polynomial) ^ crc2;
+}
+
+/**
+ * @return The CRC after appending length zero bytes, calculated without processing them.
+ * The register, the inverted CRC, is multiplied by x^(8 * length).
+ */
+inline quint32 crc32AppendZeros(const Crc32PowerTable& powers, quint32 polynomial, quint32 crc, qint64 length)
+{
+   return ~multiplyModPolynomial(crc32ZeroBytesFactor(powers, polynomial, length), ~crc, polynomial);
+}
+
+/**
+ * Slicing-by-16 CRC calculation. Uses the same convention as zlib's crc32(), so
+ * a file can be hashed block by block by passing the returned value to the next call.
+ */
+inline quint32 crc32SlicingBy16(const Crc32Tables& tables, quint32 crc, const uchar* data, qint64 length)
+{
+   const quint32 (&table)[16][256] = tables.table;
+   crc = ~crc;
+   while (length >= 16) {
+      quint32 word0 = qFromLittleEndian<quint32>(data) ^ crc;
+      quint32 word1 = qFromLittleEndian<quint32>(data + 4);
+      quint32 word2 = qFromLittleEndian<quint32>(data + 8);
+      quint32 word3 = qFromLittleEndian<quint32>(data + 12);
+      crc = table[15][word0 & 0xFF] ^ table[14][(word0 >> 8) & 0xFF] ^
+            table[13][(word0 >> 16) & 0xFF] ^ table[12][word0 >> 24] ^
+            table[11][word1 & 0xFF] ^ table[10][(word1 >> 8) & 0xFF] ^
+            table[9][(word1 >> 16) & 0xFF] ^ table[8][word1 >> 24] ^
+            table[7][word2 & 0xFF] ^ table[6][(word2 >> 8) & 0xFF] ^
+            table[5][(word2 >> 16) & 0xFF] ^ table[4][word2 >> 24] ^
+            table[3][word3 & 0xFF] ^ table[2][(word3 >> 8) & 0xFF] ^
+            table[1][(word3 >> 16) & 0xFF] ^ table[0][word3 >> 24];
+      data += 16;
+      length -= 16;
+   }
+   while (length-- > 0) {
+      crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xFF];
+   }
+   return ~crc;
+}
+
+#endif // CRCTABLES_H
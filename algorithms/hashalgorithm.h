@@ -1,6 +1,19 @@
 /**
- * Pure abstract class for hashing algorithms.
- * Inherited by for example the class Crc32algorithm.
+ * Base class for hashing algorithms.
+ * Inherited by for example the class Crc32algorithm, which registers its hashing
+ * contexts in AlgorithmRegistry.
+ *
+ * The algorithms don't read any files themselves. Instead they create a hashing
+ * context, which is fed the data block by block with update(). When all data has
+ * been added, finalize() returns the hash sum in binary form, see HashDigest.
+ * The reading is done by the caller, see Hasher.
+ *
+ * Algorithms whose hash sums can be combined, like CRC32, are registered as combinable.
+ * A large file can then be split into ranges that are hashed by separate contexts at
+ * the same time, with the results joined by combine().
+ *
+ * The holes of sparse files are fed with updateZeros(). By default the zeros are
+ * hashed from a shared block of zeros, algorithms like CRC32 calculate them directly.
  *
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
@@ -10,10 +23,34 @@
 
 #include <QString>
 
+#include "hashdigest.h"
+
+class AlgorithmRegistry;
+
 class HashAlgorithm
 {
 public:
-   virtual QString hashFile(QString filename, QString algorithm="") = 0;
+   class Context
+   {
+   public:
+      static const int zeroBlockSize = 64 * 1024;
+
+      virtual void update(const char* data, qint64 length) = 0;
+      virtual HashDigest finalize() = 0;
+      // Continues the hash sum as if the data fed to next, nextLength bytes,
+      // had been fed to this context. Only used if the algorithm is combinable.
+      virtual void combine(const Context* next, qint64 nextLength) { Q_UNUSED(next); Q_UNUSED(nextLength); }
+      // Continues the hash sum with length zero bytes, as if they had been fed to update().
+      virtual void updateZeros(qint64 length)
+      {
+         static const char zeros[zeroBlockSize] = {};
+         for (; length > 0; length -= zeroBlockSize) {
+            update(zeros, qMin<qint64>(length, zeroBlockSize));
+         }
+      }
+      virtual ~Context() {}
+   };
+
    virtual ~HashAlgorithm() {}
 };
 
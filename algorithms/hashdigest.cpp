@@ -0,0 +1,130 @@
+/**
+ * A hash sum in binary form.
+ *
+ * The hexadecimal formatting is only done when a hash sum is displayed or saved.
+ * On x86-64 it converts 16 bytes at a time with SSE2, which all x86-64 processors have.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include "hashdigest.h"
+#include "cpufeatures.h"
+
+#ifdef HASHMAN_X86_64
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+#ifdef HASHMAN_X86_64
+
+/**
+ * Writes the upper case hex characters for 16 bytes as 32 UTF-16 code units.
+ */
+inline void encodeHex16(const uchar* input, ushort* output)
+{
+   const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+   const __m128i nine = _mm_set1_epi8(9);
+   const __m128i digitOffset = _mm_set1_epi8('0');
+   const __m128i letterOffset = _mm_set1_epi8('A' - '0' - 10);
+   const __m128i zero = _mm_setzero_si128();
+
+   __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input));
+   __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibbleMask);
+   __m128i low = _mm_and_si128(bytes, nibbleMask);
+   // The high nibble is written first.
+   __m128i nibbles[2] = { _mm_unpacklo_epi8(high, low), _mm_unpackhi_epi8(high, low) };
+   for (int i = 0; i < 2; i++) {
+      __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles[i], nine), letterOffset);
+      __m128i characters = _mm_add_epi8(_mm_add_epi8(nibbles[i], digitOffset), letters);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i * 16), _mm_unpacklo_epi8(characters, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i * 16 + 8), _mm_unpackhi_epi8(characters, zero));
+   }
+}
+
+#endif
+
+/**
+ * @return The value of a hex character, or -1 if it isn't one.
+ */
+inline int hexValue(ushort character)
+{
+   if (character >= '0' && character <= '9') {
+      return character - '0';
+   }
+   if (character >= 'A' && character <= 'F') {
+      return character - 'A' + 10;
+   }
+   if (character >= 'a' && character <= 'f') {
+      return character - 'a' + 10;
+   }
+   return -1;
+}
+
+}
+
+/**
+ * @brief HashDigest::HashDigest
+ * @param data The hash sum.
+ * @param length Number of bytes, at most maxLength.
+ */
+HashDigest::HashDigest(const uchar* data, int length)
+{
+   this->length = static_cast<quint8>(qBound(0, length, int(maxLength)));
+   memcpy(bytes, data, this->length);
+}
+
+/**
+ * @brief HashDigest::fromHex
+ * @param hex Hash sum in hex form, in upper or lower case.
+ * @return The digest, or an empty digest if the string isn't a valid hash sum.
+ */
+HashDigest HashDigest::fromHex(const QString& hex)
+{
+   HashDigest digest;
+   if (hex.length() % 2 != 0 || hex.length() > maxLength * 2) {
+      return digest;
+   }
+   const QChar* characters = hex.constData();
+   for (int i = 0; i < hex.length() / 2; i++) {
+      int high = hexValue(characters[i * 2].unicode());
+      int low = hexValue(characters[i * 2 + 1].unicode());
+      if (high < 0 || low < 0) {
+         return HashDigest();
+      }
+      digest.bytes[i] = static_cast<uchar>((high << 4) | low);
+   }
+   digest.length = static_cast<quint8>(hex.length() / 2);
+   return digest;
+}
+
+/**
+ * @brief HashDigest::toHex
+ * @return The hash sum as upper case hex characters, two per byte.
+ */
+QString HashDigest::toHex() const
+{
+   QString hex(length * 2, Qt::Uninitialized);
+   ushort* output = reinterpret_cast<ushort*>(hex.data());
+#ifdef HASHMAN_X86_64
+   int i = 0;
+   for (; i + 16 <= length; i += 16) {
+      encodeHex16(bytes + i, output + i * 2);
+   }
+   if (i < length) {
+      // Short hash sums like CRC32, and the end of the others, go through a padded block.
+      uchar block[16] = {};
+      ushort characters[32];
+      memcpy(block, bytes + i, length - i);
+      encodeHex16(block, characters);
+      memcpy(output + i * 2, characters, (length - i) * 2 * sizeof(ushort));
+   }
+#else
+   static const char digits[] = "0123456789ABCDEF";
+   for (int i = 0; i < length; i++) {
+      output[i * 2] = digits[bytes[i] >> 4];
+      output[i * 2 + 1] = digits[bytes[i] & 0x0F];
+   }
+#endif
+   return hex;
+}
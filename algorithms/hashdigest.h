@@ -0,0 +1,46 @@
+/**
+ * A hash sum in binary form.
+ *
+ * The hashing contexts return their results as digests, and the digests are kept in
+ * binary form through Hasher and FileList until they're displayed or written to a file.
+ * A digest has room for the largest supported hash sum, 512 bits, so it never allocates
+ * memory and comparing two digests is a plain byte comparison.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef HASHDIGEST_H
+#define HASHDIGEST_H
+
+#include <QMetaType>
+#include <QString>
+#include <cstring>
+
+class HashDigest
+{
+public:
+   static const int maxLength = 64;
+
+   HashDigest() : length(0) {}
+   HashDigest(const uchar* data, int length);
+
+   static HashDigest fromHex(const QString& hex);
+   QString toHex() const;
+
+   bool isEmpty() const { return length == 0; }
+   int size() const { return length; }
+   const uchar* data() const { return bytes; }
+
+   bool operator==(const HashDigest& other) const {
+      return length == other.length && memcmp(bytes, other.bytes, length) == 0;
+   }
+   bool operator!=(const HashDigest& other) const { return !(*this == other); }
+
+private:
+   quint8 length;
+   uchar bytes[maxLength];
+};
+
+Q_DECLARE_METATYPE(HashDigest)
+
+#endif // HASHDIGEST_H
@@ -0,0 +1,72 @@
+/**
+ * Helpers for algorithms that process independent messages side by side in the
+ * lanes of the SIMD registers. The algorithms are written once with GCC's vector
+ * extensions, also supported by Clang, and instantiated for eight lanes (AVX2) and
+ * sixteen lanes (AVX-512) inside functions compiled for the matching instruction set.
+ *
+ * Only include this file from source files.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef LANEVECTORS_H
+#define LANEVECTORS_H
+
+#include <QtEndian>
+#include <cstring>
+
+#include "cpufeatures.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define HASHMAN_ALWAYS_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define HASHMAN_ALWAYS_INLINE __forceinline
+#else
+#define HASHMAN_ALWAYS_INLINE inline
+#endif
+
+#if defined(HASHMAN_X86_64) && (defined(__GNUC__) || defined(__clang__))
+#define HASHMAN_LANE_VECTORS
+
+// The helpers pass vectors wider than the default target allows, but they are
+// always inlined into functions compiled for the matching instruction set.
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+typedef quint32 Vector8 __attribute__((vector_size(32)));
+typedef quint32 Vector16 __attribute__((vector_size(64)));
+
+template<typename Vector>
+HASHMAN_ALWAYS_INLINE Vector rotateLeft(const Vector& x, int bits)
+{
+   return (x << bits) | (x >> (32 - bits));
+}
+
+template<typename Vector>
+HASHMAN_ALWAYS_INLINE Vector rotateRight(const Vector& x, int bits)
+{
+   return (x >> bits) | (x << (32 - bits));
+}
+
+/**
+ * Collects the 16 words of a 64 byte block from every lane, so that words[i]
+ * contains word number i of all lanes.
+ */
+template<typename Vector, int Lanes, bool BigEndian>
+HASHMAN_ALWAYS_INLINE void loadWords(Vector words[16], const uchar* const data[Lanes], qint64 offset)
+{
+   alignas(64) quint32 transposed[16][Lanes];
+   for (int lane = 0; lane < Lanes; lane++) {
+      const uchar* block = data[lane] + offset;
+      for (int i = 0; i < 16; i++) {
+         transposed[i][lane] = BigEndian ? qFromBigEndian<quint32>(block + i * 4)
+                                         : qFromLittleEndian<quint32>(block + i * 4);
+      }
+   }
+   for (int i = 0; i < 16; i++) {
+      memcpy(&words[i], transposed[i], sizeof(Vector));
+   }
+}
+
+#endif
+
+#endif // LANEVECTORS_H
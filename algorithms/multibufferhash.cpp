@@ -0,0 +1,359 @@
+/**
+ * Calculates MD5 and SHA-256 for many small messages at once.
+ *
+ * Neither algorithm can be split up within one message, but independent messages
+ * can be hashed side by side in the lanes of the SIMD registers. Eight messages are
+ * processed at once with AVX2 and sixteen with AVX-512. When a message is finished,
+ * its lane is immediately refilled with the next one.
+ * Used by Hasher for batches of small files, where the hashing would otherwise only
+ * use a fraction of the processor's capacity.
+ *
+ * The round functions are written once with the vector types in lanevectors.h
+ * and compiled for both register widths.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include "multibufferhash.h"
+#include "lanevectors.h"
+
+#ifdef HASHMAN_LANE_VECTORS
+
+namespace {
+
+static const int blockSize = 64;
+
+struct Md5
+{
+   static const int stateWords = 4;
+   static const bool bigEndian = false;
+   static const quint32 initialState[stateWords];
+   static const quint32 roundConstants[64];
+   static const int shifts[64];
+
+   template<typename Vector, int Lanes>
+   static HASHMAN_ALWAYS_INLINE void process(Vector state[stateWords], const uchar* const data[Lanes], qint64 blocks)
+   {
+      for (qint64 block = 0; block < blocks; block++) {
+         Vector words[16];
+         loadWords<Vector, Lanes, bigEndian>(words, data, block * blockSize);
+         Vector a = state[0], b = state[1], c = state[2], d = state[3];
+         for (int i = 0; i < 64; i++) {
+            Vector f;
+            int word;
+            if (i < 16) {
+               f = d ^ (b & (c ^ d));
+               word = i;
+            } else if (i < 32) {
+               f = c ^ (d & (b ^ c));
+               word = (5 * i + 1) & 15;
+            } else if (i < 48) {
+               f = b ^ c ^ d;
+               word = (3 * i + 5) & 15;
+            } else {
+               f = c ^ (b | ~d);
+               word = (7 * i) & 15;
+            }
+            f += a + roundConstants[i] + words[word];
+            a = d;
+            d = c;
+            c = b;
+            b += rotateLeft(f, shifts[i]);
+         }
+         state[0] += a;
+         state[1] += b;
+         state[2] += c;
+         state[3] += d;
+      }
+   }
+};
+
+const quint32 Md5::initialState[Md5::stateWords] = {
+   0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476
+};
+
+const quint32 Md5::roundConstants[64] = {
+   0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+   0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+   0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+   0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+   0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+   0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+   0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+   0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+const int Md5::shifts[64] = {
+   7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+   5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+   4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+   6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+struct Sha256
+{
+   static const int stateWords = 8;
+   static const bool bigEndian = true;
+   static const quint32 initialState[stateWords];
+   static const quint32 roundConstants[64];
+
+   template<typename Vector, int Lanes>
+   static HASHMAN_ALWAYS_INLINE void process(Vector state[stateWords], const uchar* const data[Lanes], qint64 blocks)
+   {
+      for (qint64 block = 0; block < blocks; block++) {
+         Vector words[16];
+         loadWords<Vector, Lanes, bigEndian>(words, data, block * blockSize);
+         Vector a = state[0], b = state[1], c = state[2], d = state[3];
+         Vector e = state[4], f = state[5], g = state[6], h = state[7];
+         for (int i = 0; i < 64; i++) {
+            if (i >= 16) {
+               // The last 16 message words are kept in a ring buffer.
+               Vector w15 = words[(i + 1) & 15];
+               Vector w2 = words[(i + 14) & 15];
+               Vector sigma0 = rotateRight(w15, 7) ^ rotateRight(w15, 18) ^ (w15 >> 3);
+               Vector sigma1 = rotateRight(w2, 17) ^ rotateRight(w2, 19) ^ (w2 >> 10);
+               words[i & 15] += sigma0 + words[(i + 9) & 15] + sigma1;
+            }
+            Vector sum1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+            Vector choice = g ^ (e & (f ^ g));
+            Vector temp1 = h + sum1 + choice + roundConstants[i] + words[i & 15];
+            Vector sum0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+            Vector majority = (a & b) | (c & (a | b));
+            h = g;
+            g = f;
+            f = e;
+            e = d + temp1;
+            d = c;
+            c = b;
+            b = a;
+            a = temp1 + sum0 + majority;
+         }
+         state[0] += a;
+         state[1] += b;
+         state[2] += c;
+         state[3] += d;
+         state[4] += e;
+         state[5] += f;
+         state[6] += g;
+         state[7] += h;
+      }
+   }
+};
+
+const quint32 Sha256::initialState[Sha256::stateWords] = {
+   0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+const quint32 Sha256::roundConstants[64] = {
+   0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+   0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+   0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+   0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+   0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+   0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+   0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+   0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+template<class Algorithm>
+HASHMAN_TARGET("avx2")
+void processAvx2(Vector8 state[], const uchar* const data[], qint64 blocks)
+{
+   Algorithm::template process<Vector8, 8>(state, data, blocks);
+}
+
+template<class Algorithm>
+HASHMAN_TARGET("avx512f")
+void processAvx512(Vector16 state[], const uchar* const data[], qint64 blocks)
+{
+   Algorithm::template process<Vector16, 16>(state, data, blocks);
+}
+
+/**
+ * Hashes the messages in a number of lanes. A lane reads the complete blocks directly
+ * from the message and the padded final blocks from its own tail buffer.
+ * A lane without a message reads the same data as a busy lane and its result is ignored.
+ */
+template<class Algorithm, typename Vector, int Lanes>
+QList<HashDigest> calculateLanes(const QList<QByteArray>& messages,
+                                 void (*process)(Vector state[], const uchar* const data[], qint64 blocks))
+{
+   struct Lane {
+      int message;
+      const uchar* data;
+      qint64 blocks;
+      bool inTail;
+      qint64 tailBlocks;
+      uchar tail[blockSize * 2];
+   };
+   Lane lanes[Lanes];
+   alignas(64) quint32 state[Algorithm::stateWords][Lanes];
+   const uchar* data[Lanes];
+   QList<HashDigest> digests;
+   for (int i = 0; i < messages.size(); i++) {
+      digests.append(HashDigest());
+   }
+   for (int lane = 0; lane < Lanes; lane++) {
+      lanes[lane].message = -1;
+   }
+
+   int nextMessage = 0;
+   forever {
+      int active = 0;
+      qint64 run = 0;
+      for (int lane = 0; lane < Lanes; lane++) {
+         Lane& current = lanes[lane];
+         if (current.message < 0 && nextMessage < messages.size()) {
+            // Start the next message in this lane.
+            const QByteArray& message = messages.at(nextMessage);
+            qint64 length = message.size();
+            qint64 remaining = length % blockSize;
+            current.message = nextMessage++;
+            current.data = reinterpret_cast<const uchar*>(message.constData());
+            current.blocks = length / blockSize;
+            current.inTail = false;
+            current.tailBlocks = remaining + 9 > blockSize ? 2 : 1;
+            memset(current.tail, 0, sizeof(current.tail));
+            memcpy(current.tail, current.data + current.blocks * blockSize, remaining);
+            current.tail[remaining] = 0x80;
+            uchar* lengthField = current.tail + current.tailBlocks * blockSize - 8;
+            if (Algorithm::bigEndian) {
+               qToBigEndian<quint64>(quint64(length) * 8, lengthField);
+            } else {
+               qToLittleEndian<quint64>(quint64(length) * 8, lengthField);
+            }
+            if (current.blocks == 0) {
+               current.data = current.tail;
+               current.blocks = current.tailBlocks;
+               current.inTail = true;
+            }
+            for (int word = 0; word < Algorithm::stateWords; word++) {
+               state[word][lane] = Algorithm::initialState[word];
+            }
+         }
+         if (current.message >= 0) {
+            run = active == 0 ? current.blocks : qMin(run, current.blocks);
+            active++;
+         }
+      }
+      if (active == 0) {
+         break;
+      }
+
+      const uchar* busyData = 0;
+      for (int lane = 0; lane < Lanes; lane++) {
+         if (lanes[lane].message >= 0) {
+            busyData = lanes[lane].data;
+            break;
+         }
+      }
+      for (int lane = 0; lane < Lanes; lane++) {
+         data[lane] = lanes[lane].message >= 0 ? lanes[lane].data : busyData;
+      }
+      process(reinterpret_cast<Vector*>(state), data, run);
+
+      for (int lane = 0; lane < Lanes; lane++) {
+         Lane& current = lanes[lane];
+         if (current.message < 0) {
+            continue;
+         }
+         current.data += run * blockSize;
+         current.blocks -= run;
+         if (current.blocks > 0) {
+            continue;
+         }
+         if (!current.inTail) {
+            current.data = current.tail;
+            current.blocks = current.tailBlocks;
+            current.inTail = true;
+            continue;
+         }
+         uchar digest[Algorithm::stateWords * 4];
+         for (int word = 0; word < Algorithm::stateWords; word++) {
+            if (Algorithm::bigEndian) {
+               qToBigEndian<quint32>(state[word][lane], digest + word * 4);
+            } else {
+               qToLittleEndian<quint32>(state[word][lane], digest + word * 4);
+            }
+         }
+         digests[current.message] = HashDigest(digest, Algorithm::stateWords * 4);
+         current.message = -1;
+      }
+   }
+   return digests;
+}
+
+template<class Algorithm>
+QList<HashDigest> calculateAlgorithm(const QList<QByteArray>& messages)
+{
+   if (MultiBufferHash::lanes() == 16) {
+      return calculateLanes<Algorithm, Vector16, 16>(messages, processAvx512<Algorithm>);
+   }
+   return calculateLanes<Algorithm, Vector8, 8>(messages, processAvx2<Algorithm>);
+}
+
+}
+#endif
+
+/**
+ * @brief MultiBufferHash::isSupported
+ * @param algorithm
+ * @return True if the algorithm can be calculated in parallel lanes and it's faster
+ * than hashing the messages one at a time.
+ */
+bool MultiBufferHash::isSupported(AlgorithmRegistry::Id algorithm)
+{
+#ifdef HASHMAN_LANE_VECTORS
+   const CpuFeatures& cpu = CpuFeatures::get();
+   if (algorithm == AlgorithmRegistry::Md5) {
+      return cpu.avx2;
+   }
+   if (algorithm == AlgorithmRegistry::Sha256) {
+      // The SHA extensions beat eight lanes, but not sixteen.
+      return cpu.avx512f || (cpu.avx2 && !cpu.sha);
+   }
+#else
+   Q_UNUSED(algorithm);
+#endif
+   return false;
+}
+
+/**
+ * @brief MultiBufferHash::lanes
+ * @return Number of messages hashed at once, 0 if not supported.
+ */
+int MultiBufferHash::lanes()
+{
+#ifdef HASHMAN_LANE_VECTORS
+   const CpuFeatures& cpu = CpuFeatures::get();
+   if (cpu.avx512f) {
+      return 16;
+   }
+   if (cpu.avx2) {
+      return 8;
+   }
+#endif
+   return 0;
+}
+
+/**
+ * @brief MultiBufferHash::calculate
+ * @param algorithm MD5 or SHA-256, check with isSupported() first.
+ * @param messages
+ * @return The hash sums of the messages, in the same order as the messages.
+ */
+QList<HashDigest> MultiBufferHash::calculate(AlgorithmRegistry::Id algorithm, const QList<QByteArray>& messages)
+{
+#ifdef HASHMAN_LANE_VECTORS
+   if (algorithm == AlgorithmRegistry::Md5) {
+      return calculateAlgorithm<Md5>(messages);
+   }
+   if (algorithm == AlgorithmRegistry::Sha256) {
+      return calculateAlgorithm<Sha256>(messages);
+   }
+#else
+   Q_UNUSED(algorithm);
+   Q_UNUSED(messages);
+#endif
+   return QList<HashDigest>();
+}
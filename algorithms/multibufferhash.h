@@ -0,0 +1,31 @@
+/**
+ * Calculates MD5 and SHA-256 for many small messages at once.
+ *
+ * Neither algorithm can be split up within one message, but independent messages
+ * can be hashed side by side in the lanes of the SIMD registers. Eight messages are
+ * processed at once with AVX2 and sixteen with AVX-512. When a message is finished,
+ * its lane is immediately refilled with the next one.
+ * Used by Hasher for batches of small files, where the hashing would otherwise only
+ * use a fraction of the processor's capacity.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef MULTIBUFFERHASH_H
+#define MULTIBUFFERHASH_H
+
+#include <QByteArray>
+#include <QList>
+
+#include "algorithmregistry.h"
+#include "hashdigest.h"
+
+class MultiBufferHash
+{
+public:
+   static bool isSupported(AlgorithmRegistry::Id algorithm);
+   static int lanes();
+   static QList<HashDigest> calculate(AlgorithmRegistry::Id algorithm, const QList<QByteArray>& messages);
+};
+
+#endif // MULTIBUFFERHASH_H
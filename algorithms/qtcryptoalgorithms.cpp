@@ -10,44 +10,52 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
-#include <QMessageBox>
-#include <QDir>
-#include <QDirIterator>
-#include <QDebug>
-
 #include <QCryptographicHash>
 
-#include "gui/mainwindow.h"
-#include "hashproject/sourcedirectory.h"
-
+#include "algorithmregistry.h"
 #include "hashalgorithm.h"
 #include "qtcryptoalgorithms.h"
 
-QString QtCryptoAlgorithms::hashFile(QString filename, QString algorithm)
+namespace {
+
+template<QCryptographicHash::Algorithm Algorithm>
+class QtCryptoContext : public HashAlgorithm::Context
 {
-   QFile file(filename);
-   if (!file.exists()) {
-      qDebug() << "ERROR: File not found: " << filename;
-      return QString("ERROR: File not found.");
-   }
-   if (!file.open(QFile::ReadOnly)) {
-      qDebug() << "ERROR: " << file.errorString();
-      return QString("ERROR: %1").arg(file.errorString());
+public:
+   QtCryptoContext() : hash(Algorithm) {}
+
+   void update(const char* data, qint64 length)
+   {
+      // QCryptographicHash only accepts int sized blocks.
+      while (length > 0) {
+         int blockLength = static_cast<int>(qMin<qint64>(length, 1 << 30));
+         hash.addData(data, blockLength);
+         data += blockLength;
+         length -= blockLength;
+      }
    }
-   QCryptographicHash::Algorithm activeAlgorithm = QCryptographicHash::Md5;
-   if (algorithm == "MD4") {
-      activeAlgorithm = QCryptographicHash::Md4;
-   } else if (algorithm == "SHA-1") {
-      activeAlgorithm = QCryptographicHash::Sha1;
-   } else if (algorithm == "SHA-256") {
-      activeAlgorithm = QCryptographicHash::Sha256;
-   } else if (algorithm == "SHA-512") {
-      activeAlgorithm = QCryptographicHash::Sha512;
+
+   HashDigest finalize()
+   {
+      QByteArray digest = hash.result();
+      return HashDigest(reinterpret_cast<const uchar*>(digest.constData()), digest.size());
    }
-   QCryptographicHash hash(activeAlgorithm);
-   hash.addData(&file);
 
-   file.close();
+private:
+   QCryptographicHash hash;
+};
 
-   return QString(hash.result().toHex());
+}
+
+/**
+ * @brief QtCryptoAlgorithms::registerAlgorithms
+ * @param registry Registers the algorithms listed in the header.
+ */
+void QtCryptoAlgorithms::registerAlgorithms(AlgorithmRegistry& registry)
+{
+   registry.add<QtCryptoContext<QCryptographicHash::Md4> >(AlgorithmRegistry::Md4, "MD4");
+   registry.add<QtCryptoContext<QCryptographicHash::Md5> >(AlgorithmRegistry::Md5, "MD5");
+   registry.add<QtCryptoContext<QCryptographicHash::Sha1> >(AlgorithmRegistry::Sha1, "SHA-1");
+   registry.add<QtCryptoContext<QCryptographicHash::Sha256> >(AlgorithmRegistry::Sha256, "SHA-256");
+   registry.add<QtCryptoContext<QCryptographicHash::Sha512> >(AlgorithmRegistry::Sha512, "SHA-512");
 }
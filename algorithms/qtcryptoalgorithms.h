@@ -20,7 +20,7 @@
 class QtCryptoAlgorithms : public HashAlgorithm
 {
 public:
-   QString hashFile(QString filename, QString algorithm="");
+   static void registerAlgorithms(AlgorithmRegistry& registry);
 };
 
 #endif // QTCRYPTOALGORITHMS_H
@@ -0,0 +1,424 @@
+/**
+ * SHA-1 and SHA-256 implemented with the Intel SHA extensions (SHA-NI).
+ *
+ * Produces the same hash sums as QCryptographicHash, but is several times faster
+ * on processors with the extensions. The algorithms are only registered when
+ * isSupported() returns true, otherwise they're handled by QtCryptoAlgorithms.
+ *
+ * The block functions follow the structure of Intel's reference code in
+ * "Intel SHA Extensions: New Instructions Supporting the Secure Hash Algorithm".
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include <QtEndian>
+#include <cstring>
+
+#include "algorithmregistry.h"
+#include "shanialgorithms.h"
+
+#ifdef HASHMAN_X86_64
+#include <immintrin.h>
+
+namespace {
+
+const quint32 sha1InitialState[5] = {
+   0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+};
+
+const quint32 sha256InitialState[8] = {
+   0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+alignas(16) const quint32 sha256RoundConstants[64] = {
+   0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+   0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+   0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+   0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+   0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+   0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+   0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+   0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+struct Sha1
+{
+   static const int stateLength = 5;
+   static void process(quint32* state, const uchar* data, qint64 blocks)
+   {
+      ShaNiAlgorithms::processSha1(state, data, blocks);
+   }
+   static const quint32* initialState() { return sha1InitialState; }
+};
+
+struct Sha256
+{
+   static const int stateLength = 8;
+   static void process(quint32* state, const uchar* data, qint64 blocks)
+   {
+      ShaNiAlgorithms::processSha256(state, data, blocks);
+   }
+   static const quint32* initialState() { return sha256InitialState; }
+};
+
+/**
+ * Buffers the data into 64 byte blocks and handles the padding, which is
+ * the same for SHA-1 and SHA-256. Algorithm::process does the rest.
+ */
+template<class Algorithm>
+class ShaNiContext : public HashAlgorithm::Context
+{
+public:
+   ShaNiContext() : bufferLength(0), totalLength(0)
+   {
+      for (int i = 0; i < stateLength; i++) {
+         state[i] = Algorithm::initialState()[i];
+      }
+   }
+
+   void update(const char* data, qint64 length)
+   {
+      const uchar* input = reinterpret_cast<const uchar*>(data);
+      totalLength += length;
+      if (bufferLength > 0) {
+         int copyLength = static_cast<int>(qMin<qint64>(length, blockSize - bufferLength));
+         memcpy(buffer + bufferLength, input, copyLength);
+         bufferLength += copyLength;
+         input += copyLength;
+         length -= copyLength;
+         if (bufferLength < blockSize) {
+            return;
+         }
+         Algorithm::process(state, buffer, 1);
+         bufferLength = 0;
+      }
+      qint64 blocks = length / blockSize;
+      if (blocks > 0) {
+         Algorithm::process(state, input, blocks);
+         input += blocks * blockSize;
+         length -= blocks * blockSize;
+      }
+      memcpy(buffer, input, length);
+      bufferLength = static_cast<int>(length);
+   }
+
+   HashDigest finalize()
+   {
+      quint64 bitLength = static_cast<quint64>(totalLength) * 8;
+      buffer[bufferLength++] = 0x80;
+      if (bufferLength > blockSize - 8) {
+         memset(buffer + bufferLength, 0, blockSize - bufferLength);
+         Algorithm::process(state, buffer, 1);
+         bufferLength = 0;
+      }
+      memset(buffer + bufferLength, 0, blockSize - 8 - bufferLength);
+      qToBigEndian<quint64>(bitLength, buffer + blockSize - 8);
+      Algorithm::process(state, buffer, 1);
+
+      uchar digest[stateLength * 4];
+      for (int i = 0; i < stateLength; i++) {
+         qToBigEndian<quint32>(state[i], digest + i * 4);
+      }
+      return HashDigest(digest, stateLength * 4);
+   }
+
+private:
+   static const int blockSize = 64;
+
+   static const int stateLength = Algorithm::stateLength;
+
+   quint32 state[stateLength];
+   uchar buffer[blockSize];
+   int bufferLength;
+   qint64 totalLength;
+};
+
+/**
+ * Four SHA-256 rounds on the ABEF/CDGH state.
+ */
+HASHMAN_TARGET("sha,sse4.1")
+inline void sha256Rounds(__m128i& abef, __m128i& cdgh, __m128i words, __m128i roundConstants)
+{
+   __m128i message = _mm_add_epi32(words, roundConstants);
+   cdgh = _mm_sha256rnds2_epu32(cdgh, abef, message);
+   abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(message, 0x0E));
+}
+
+/**
+ * Message words for the next four rounds, from the words of the previous 16 rounds.
+ */
+HASHMAN_TARGET("sha,sse4.1")
+inline __m128i sha256Schedule(__m128i words0, __m128i words1, __m128i words2, __m128i words3)
+{
+   __m128i temp = _mm_sha256msg1_epu32(words0, words1);
+   temp = _mm_add_epi32(temp, _mm_alignr_epi8(words3, words2, 4));
+   return _mm_sha256msg2_epu32(temp, words3);
+}
+
+}
+
+/**
+ * @brief ShaNiAlgorithms::processSha1
+ * @param state The five SHA-1 state words.
+ * @param data
+ * @param blocks Number of 64 byte blocks in data.
+ */
+HASHMAN_TARGET("sha,sse4.1")
+void ShaNiAlgorithms::processSha1(quint32 state[5], const uchar* data, qint64 blocks)
+{
+   const __m128i byteSwap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+   __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+   __m128i e0 = _mm_set_epi32(state[4], 0, 0, 0);
+   __m128i e1;
+   __m128i msg0, msg1, msg2, msg3;
+
+   while (blocks-- > 0) {
+      const __m128i abcdSave = abcd;
+      const __m128i e0Save = e0;
+      const __m128i* input = reinterpret_cast<const __m128i*>(data);
+
+      // Rounds 0-3
+      msg0 = _mm_shuffle_epi8(_mm_loadu_si128(input), byteSwap);
+      e0 = _mm_add_epi32(e0, msg0);
+      e1 = abcd;
+      abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+      // Rounds 4-7
+      msg1 = _mm_shuffle_epi8(_mm_loadu_si128(input + 1), byteSwap);
+      e1 = _mm_sha1nexte_epu32(e1, msg1);
+      e0 = abcd;
+      abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+      msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+      // Rounds 8-11
+      msg2 = _mm_shuffle_epi8(_mm_loadu_si128(input + 2), byteSwap);
+      e0 = _mm_sha1nexte_epu32(e0, msg2);
+      e1 = abcd;
+      abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+      msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+      msg0 = _mm_xor_si128(msg0, msg2);
+
+      // Rounds 12-15
+      msg3 = _mm_shuffle_epi8(_mm_loadu_si128(input + 3), byteSwap);
+      e1 = _mm_sha1nexte_epu32(e1, msg3);
+      e0 = abcd;
+      msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+      abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+      msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+      msg1 = _mm_xor_si128(msg1, msg3);
+
+      // Rounds 16-19
+      e0 = _mm_sha1nexte_epu32(e0, msg0);
+      e1 = abcd;
+      msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+      abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+      msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+      msg2 = _mm_xor_si128(msg2, msg0);
+
+      // Rounds 20-23
+      e1 = _mm_sha1nexte_epu32(e1, msg1);
+      e0 = abcd;
+      msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+      abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+      msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+      msg3 = _mm_xor_si128(msg3, msg1);
+
+      // Rounds 24-27
+      e0 = _mm_sha1nexte_epu32(e0, msg2);
+      e1 = abcd;
+      msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+      abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+      msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+      msg0 = _mm_xor_si128(msg0, msg2);
+
+      // Rounds 28-31
+      e1 = _mm_sha1nexte_epu32(e1, msg3);
+      e0 = abcd;
+      msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+      abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+      msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+      msg1 = _mm_xor_si128(msg1, msg3);
+
+      // Rounds 32-35
+      e0 = _mm_sha1nexte_epu32(e0, msg0);
+      e1 = abcd;
+      msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+      abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+      msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+      msg2 = _mm_xor_si128(msg2, msg0);
+
+      // Rounds 36-39
+      e1 = _mm_sha1nexte_epu32(e1, msg1);
+      e0 = abcd;
+      msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+      abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+      msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+      msg3 = _mm_xor_si128(msg3, msg1);
+
+      // Rounds 40-43
+      e0 = _mm_sha1nexte_epu32(e0, msg2);
+      e1 = abcd;
+      msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+      abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+      msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+      msg0 = _mm_xor_si128(msg0, msg2);
+
+      // Rounds 44-47
+      e1 = _mm_sha1nexte_epu32(e1, msg3);
+      e0 = abcd;
+      msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+      abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+      msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+      msg1 = _mm_xor_si128(msg1, msg3);
+
+      // Rounds 48-51
+      e0 = _mm_sha1nexte_epu32(e0, msg0);
+      e1 = abcd;
+      msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+      abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+      msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+      msg2 = _mm_xor_si128(msg2, msg0);
+
+      // Rounds 52-55
+      e1 = _mm_sha1nexte_epu32(e1, msg1);
+      e0 = abcd;
+      msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+      abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+      msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+      msg3 = _mm_xor_si128(msg3, msg1);
+
+      // Rounds 56-59
+      e0 = _mm_sha1nexte_epu32(e0, msg2);
+      e1 = abcd;
+      msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+      abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+      msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+      msg0 = _mm_xor_si128(msg0, msg2);
+
+      // Rounds 60-63
+      e1 = _mm_sha1nexte_epu32(e1, msg3);
+      e0 = abcd;
+      msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+      abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+      msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+      msg1 = _mm_xor_si128(msg1, msg3);
+
+      // Rounds 64-67
+      e0 = _mm_sha1nexte_epu32(e0, msg0);
+      e1 = abcd;
+      msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+      abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+      msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+      msg2 = _mm_xor_si128(msg2, msg0);
+
+      // Rounds 68-71
+      e1 = _mm_sha1nexte_epu32(e1, msg1);
+      e0 = abcd;
+      msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+      abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+      msg3 = _mm_xor_si128(msg3, msg1);
+
+      // Rounds 72-75
+      e0 = _mm_sha1nexte_epu32(e0, msg2);
+      e1 = abcd;
+      msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+      abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+      // Rounds 76-79
+      e1 = _mm_sha1nexte_epu32(e1, msg3);
+      e0 = abcd;
+      abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+      e0 = _mm_sha1nexte_epu32(e0, e0Save);
+      abcd = _mm_add_epi32(abcd, abcdSave);
+      data += 64;
+   }
+
+   _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1B));
+   state[4] = _mm_extract_epi32(e0, 3);
+}
+
+/**
+ * @brief ShaNiAlgorithms::processSha256
+ * @param state The eight SHA-256 state words.
+ * @param data
+ * @param blocks Number of 64 byte blocks in data.
+ */
+HASHMAN_TARGET("sha,sse4.1")
+void ShaNiAlgorithms::processSha256(quint32 state[8], const uchar* data, qint64 blocks)
+{
+   const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+   const __m128i* roundConstants = reinterpret_cast<const __m128i*>(sha256RoundConstants);
+
+   // The instructions work on the state words ordered as ABEF and CDGH.
+   __m128i dcba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+   __m128i hgfe = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4));
+   __m128i cdab = _mm_shuffle_epi32(dcba, 0xB1);
+   __m128i efgh = _mm_shuffle_epi32(hgfe, 0x1B);
+   __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+   __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+   while (blocks-- > 0) {
+      const __m128i abefSave = abef;
+      const __m128i cdghSave = cdgh;
+      const __m128i* input = reinterpret_cast<const __m128i*>(data);
+      __m128i msg0 = _mm_shuffle_epi8(_mm_loadu_si128(input), byteSwap);
+      __m128i msg1 = _mm_shuffle_epi8(_mm_loadu_si128(input + 1), byteSwap);
+      __m128i msg2 = _mm_shuffle_epi8(_mm_loadu_si128(input + 2), byteSwap);
+      __m128i msg3 = _mm_shuffle_epi8(_mm_loadu_si128(input + 3), byteSwap);
+
+      sha256Rounds(abef, cdgh, msg0, roundConstants[0]);
+      sha256Rounds(abef, cdgh, msg1, roundConstants[1]);
+      sha256Rounds(abef, cdgh, msg2, roundConstants[2]);
+      sha256Rounds(abef, cdgh, msg3, roundConstants[3]);
+
+      // The message words for the remaining rounds are calculated from the four previous groups.
+      for (int group = 4; group < 16; group += 4) {
+         msg0 = sha256Schedule(msg0, msg1, msg2, msg3);
+         sha256Rounds(abef, cdgh, msg0, roundConstants[group]);
+         msg1 = sha256Schedule(msg1, msg2, msg3, msg0);
+         sha256Rounds(abef, cdgh, msg1, roundConstants[group + 1]);
+         msg2 = sha256Schedule(msg2, msg3, msg0, msg1);
+         sha256Rounds(abef, cdgh, msg2, roundConstants[group + 2]);
+         msg3 = sha256Schedule(msg3, msg0, msg1, msg2);
+         sha256Rounds(abef, cdgh, msg3, roundConstants[group + 3]);
+      }
+
+      abef = _mm_add_epi32(abef, abefSave);
+      cdgh = _mm_add_epi32(cdgh, cdghSave);
+      data += 64;
+   }
+
+   __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+   __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+   _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_blend_epi16(feba, dchg, 0xF0));
+   _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+}
+#endif
+
+/**
+ * @brief ShaNiAlgorithms::registerAlgorithms
+ * @param registry Registers SHA-1 and SHA-256 if the processor has the SHA extensions,
+ * replacing the QCryptographicHash implementations.
+ */
+void ShaNiAlgorithms::registerAlgorithms(AlgorithmRegistry& registry)
+{
+#ifdef HASHMAN_X86_64
+   if (isSupported()) {
+      registry.add<ShaNiContext<Sha1> >(AlgorithmRegistry::Sha1, "SHA-1");
+      registry.add<ShaNiContext<Sha256> >(AlgorithmRegistry::Sha256, "SHA-256");
+   }
+#else
+   Q_UNUSED(registry);
+#endif
+}
+
+/**
+ * @brief ShaNiAlgorithms::isSupported
+ * @return True if the processor has the SHA extensions.
+ */
+bool ShaNiAlgorithms::isSupported()
+{
+   const CpuFeatures& cpu = CpuFeatures::get();
+   return cpu.sha && cpu.ssse3 && cpu.sse41;
+}
@@ -0,0 +1,29 @@
+/**
+ * SHA-1 and SHA-256 implemented with the Intel SHA extensions (SHA-NI).
+ *
+ * Produces the same hash sums as QCryptographicHash, but is several times faster
+ * on processors with the extensions. The algorithms are only registered when
+ * isSupported() returns true, otherwise they're handled by QtCryptoAlgorithms.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef SHANIALGORITHMS_H
+#define SHANIALGORITHMS_H
+
+#include "hashalgorithm.h"
+#include "cpufeatures.h"
+
+class ShaNiAlgorithms : public HashAlgorithm
+{
+public:
+   static void registerAlgorithms(AlgorithmRegistry& registry);
+   static bool isSupported();
+
+#ifdef HASHMAN_X86_64
+   static void processSha1(quint32 state[5], const uchar* data, qint64 blocks);
+   static void processSha256(quint32 state[8], const uchar* data, qint64 blocks);
+#endif
+};
+
+#endif // SHANIALGORITHMS_H
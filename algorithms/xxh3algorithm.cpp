@@ -0,0 +1,558 @@
+/**
+ * The XXH3 family of non-cryptographic hash functions, see https://github.com/Cyan4973/xxHash
+ *
+ * XXH3-64 and XXH128 are much faster than CRC32 and their larger hash sums make
+ * collisions unlikely even for very large numbers of files, which makes them well
+ * suited for detecting corrupted files. They give no protection against deliberate
+ * modifications.
+ *
+ * The hash sums are written in the canonical form used by xxhsum.
+ *
+ * Inputs of up to 240 bytes are hashed in one go with dedicated functions. Longer
+ * inputs are processed in 64 byte stripes by eight 64-bit accumulators, which is
+ * where the time is spent. The accumulation is done with AVX2 or SSE2 when available.
+ * Only the default secret and seed 0 are supported, as used by xxhsum.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include <QtEndian>
+#include <cstring>
+
+#include "algorithmregistry.h"
+#include "xxh3algorithm.h"
+#include "cpufeatures.h"
+
+#ifdef HASHMAN_X86_64
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const quint64 prime32_1 = 0x9E3779B1U;
+const quint64 prime32_2 = 0x85EBCA77U;
+const quint64 prime32_3 = 0xC2B2AE3DU;
+const quint64 prime64_1 = 0x9E3779B185EBCA87ULL;
+const quint64 prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+const quint64 prime64_3 = 0x165667B19E3779F9ULL;
+const quint64 prime64_4 = 0x85EBCA77C2B2AE63ULL;
+const quint64 prime64_5 = 0x27D4EB2F165667C5ULL;
+const quint64 primeMx1 = 0x165667919E3779F9ULL;
+const quint64 primeMx2 = 0x9FB21C651E98DF25ULL;
+
+const int stripeLength = 64;
+const int secretSize = 192;
+const int secretSizeMin = 136;
+const int stripesPerBlock = (secretSize - stripeLength) / 8;
+const int midSizeMax = 240;
+const int midSizeStartOffset = 3;
+const int midSizeLastOffset = 17;
+const int secretLastAccStart = 7;
+const int secretMergeAccsStart = 11;
+const int bufferSize = 256;
+
+alignas(64) const uchar secret[secretSize] = {
+   0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+   0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+   0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+   0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+   0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+   0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+   0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+   0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+   0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+   0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+   0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+   0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e
+};
+
+struct Hash128
+{
+   quint64 low;
+   quint64 high;
+};
+
+inline quint64 read64(const uchar* data)
+{
+   return qFromLittleEndian<quint64>(data);
+}
+
+inline quint32 read32(const uchar* data)
+{
+   return qFromLittleEndian<quint32>(data);
+}
+
+inline quint64 rotateLeft64(quint64 value, int bits)
+{
+   return (value << bits) | (value >> (64 - bits));
+}
+
+inline quint32 swap32(quint32 value)
+{
+   return qbswap(value);
+}
+
+inline quint64 swap64(quint64 value)
+{
+   return qbswap(value);
+}
+
+inline Hash128 multiply64to128(quint64 a, quint64 b)
+{
+   Hash128 result;
+#if defined(__SIZEOF_INT128__)
+   unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+   result.low = static_cast<quint64>(product);
+   result.high = static_cast<quint64>(product >> 64);
+#else
+   quint64 lowLow = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+   quint64 highLow = (a >> 32) * (b & 0xFFFFFFFF);
+   quint64 lowHigh = (a & 0xFFFFFFFF) * (b >> 32);
+   quint64 highHigh = (a >> 32) * (b >> 32);
+   quint64 cross = (lowLow >> 32) + (highLow & 0xFFFFFFFF) + lowHigh;
+   result.high = (highLow >> 32) + (cross >> 32) + highHigh;
+   result.low = (cross << 32) | (lowLow & 0xFFFFFFFF);
+#endif
+   return result;
+}
+
+inline quint64 multiplyFold64(quint64 a, quint64 b)
+{
+   Hash128 product = multiply64to128(a, b);
+   return product.low ^ product.high;
+}
+
+inline quint64 xxh64Avalanche(quint64 hash)
+{
+   hash ^= hash >> 33;
+   hash *= prime64_2;
+   hash ^= hash >> 29;
+   hash *= prime64_3;
+   hash ^= hash >> 32;
+   return hash;
+}
+
+inline quint64 avalanche(quint64 hash)
+{
+   hash ^= hash >> 37;
+   hash *= primeMx1;
+   hash ^= hash >> 32;
+   return hash;
+}
+
+inline quint64 rrmxmx(quint64 hash, quint64 length)
+{
+   hash ^= rotateLeft64(hash, 49) ^ rotateLeft64(hash, 24);
+   hash *= primeMx2;
+   hash ^= (hash >> 35) + length;
+   hash *= primeMx2;
+   hash ^= hash >> 28;
+   return hash;
+}
+
+inline quint64 mix16(const uchar* input, const uchar* secretPart, quint64 seed)
+{
+   return multiplyFold64(read64(input) ^ (read64(secretPart) + seed),
+                         read64(input + 8) ^ (read64(secretPart + 8) - seed));
+}
+
+inline void mix32(Hash128& acc, const uchar* input1, const uchar* input2, const uchar* secretPart, quint64 seed)
+{
+   acc.low += mix16(input1, secretPart, seed);
+   acc.low ^= read64(input2) + read64(input2 + 8);
+   acc.high += mix16(input2, secretPart + 16, seed);
+   acc.high ^= read64(input1) + read64(input1 + 8);
+}
+
+/**
+ * XXH3-64 for inputs of up to 240 bytes.
+ */
+quint64 hash64Short(const uchar* input, quint64 length)
+{
+   if (length == 0) {
+      return xxh64Avalanche(read64(secret + 56) ^ read64(secret + 64));
+   }
+   if (length <= 3) {
+      quint32 combined = (quint32(input[0]) << 16) | (quint32(input[length >> 1]) << 24) |
+                         quint32(input[length - 1]) | quint32(length << 8);
+      quint64 bitflip = read32(secret) ^ read32(secret + 4);
+      return xxh64Avalanche(combined ^ bitflip);
+   }
+   if (length <= 8) {
+      quint64 bitflip = read64(secret + 8) ^ read64(secret + 16);
+      quint64 input64 = read32(input + length - 4) + (quint64(read32(input)) << 32);
+      return rrmxmx(input64 ^ bitflip, length);
+   }
+   if (length <= 16) {
+      quint64 inputLow = read64(input) ^ (read64(secret + 24) ^ read64(secret + 32));
+      quint64 inputHigh = read64(input + length - 8) ^ (read64(secret + 40) ^ read64(secret + 48));
+      quint64 acc = length + swap64(inputLow) + inputHigh + multiplyFold64(inputLow, inputHigh);
+      return avalanche(acc);
+   }
+   quint64 acc = length * prime64_1;
+   if (length <= 128) {
+      if (length > 32) {
+         if (length > 64) {
+            if (length > 96) {
+               acc += mix16(input + 48, secret + 96, 0);
+               acc += mix16(input + length - 64, secret + 112, 0);
+            }
+            acc += mix16(input + 32, secret + 64, 0);
+            acc += mix16(input + length - 48, secret + 80, 0);
+         }
+         acc += mix16(input + 16, secret + 32, 0);
+         acc += mix16(input + length - 32, secret + 48, 0);
+      }
+      acc += mix16(input, secret, 0);
+      acc += mix16(input + length - 16, secret + 16, 0);
+      return avalanche(acc);
+   }
+   int rounds = static_cast<int>(length / 16);
+   for (int i = 0; i < 8; i++) {
+      acc += mix16(input + 16 * i, secret + 16 * i, 0);
+   }
+   acc = avalanche(acc);
+   for (int i = 8; i < rounds; i++) {
+      acc += mix16(input + 16 * i, secret + 16 * (i - 8) + midSizeStartOffset, 0);
+   }
+   acc += mix16(input + length - 16, secret + secretSizeMin - midSizeLastOffset, 0);
+   return avalanche(acc);
+}
+
+/**
+ * XXH128 for inputs of up to 240 bytes.
+ */
+Hash128 hash128Short(const uchar* input, quint64 length)
+{
+   Hash128 result;
+   if (length == 0) {
+      result.low = xxh64Avalanche(read64(secret + 64) ^ read64(secret + 72));
+      result.high = xxh64Avalanche(read64(secret + 80) ^ read64(secret + 88));
+      return result;
+   }
+   if (length <= 3) {
+      quint32 combinedLow = (quint32(input[0]) << 16) | (quint32(input[length >> 1]) << 24) |
+                            quint32(input[length - 1]) | quint32(length << 8);
+      quint32 swapped = swap32(combinedLow);
+      quint32 combinedHigh = (swapped << 13) | (swapped >> 19);
+      quint64 bitflipLow = read32(secret) ^ read32(secret + 4);
+      quint64 bitflipHigh = read32(secret + 8) ^ read32(secret + 12);
+      result.low = xxh64Avalanche(combinedLow ^ bitflipLow);
+      result.high = xxh64Avalanche(combinedHigh ^ bitflipHigh);
+      return result;
+   }
+   if (length <= 8) {
+      quint64 input64 = read32(input) + (quint64(read32(input + length - 4)) << 32);
+      quint64 bitflip = read64(secret + 16) ^ read64(secret + 24);
+      Hash128 product = multiply64to128(input64 ^ bitflip, prime64_1 + (length << 2));
+      product.high += product.low << 1;
+      product.low ^= product.high >> 3;
+      product.low ^= product.low >> 35;
+      product.low *= primeMx2;
+      product.low ^= product.low >> 28;
+      product.high = avalanche(product.high);
+      return product;
+   }
+   if (length <= 16) {
+      quint64 bitflipLow = read64(secret + 32) ^ read64(secret + 40);
+      quint64 bitflipHigh = read64(secret + 48) ^ read64(secret + 56);
+      quint64 inputLow = read64(input);
+      quint64 inputHigh = read64(input + length - 8);
+      Hash128 product = multiply64to128(inputLow ^ inputHigh ^ bitflipLow, prime64_1);
+      product.low += (length - 1) << 54;
+      inputHigh ^= bitflipHigh;
+      product.high += inputHigh + (inputHigh & 0xFFFFFFFF) * (prime32_2 - 1);
+      product.low ^= swap64(product.high);
+      result = multiply64to128(product.low, prime64_2);
+      result.high += product.high * prime64_2;
+      result.low = avalanche(result.low);
+      result.high = avalanche(result.high);
+      return result;
+   }
+   Hash128 acc;
+   acc.low = length * prime64_1;
+   acc.high = 0;
+   if (length <= 128) {
+      if (length > 32) {
+         if (length > 64) {
+            if (length > 96) {
+               mix32(acc, input + 48, input + length - 64, secret + 96, 0);
+            }
+            mix32(acc, input + 32, input + length - 48, secret + 64, 0);
+         }
+         mix32(acc, input + 16, input + length - 32, secret + 32, 0);
+      }
+      mix32(acc, input, input + length - 16, secret, 0);
+   } else {
+      int rounds = static_cast<int>(length / 32);
+      for (int i = 0; i < 4; i++) {
+         mix32(acc, input + 32 * i, input + 32 * i + 16, secret + 32 * i, 0);
+      }
+      acc.low = avalanche(acc.low);
+      acc.high = avalanche(acc.high);
+      for (int i = 4; i < rounds; i++) {
+         mix32(acc, input + 32 * i, input + 32 * i + 16, secret + midSizeStartOffset + 32 * (i - 4), 0);
+      }
+      mix32(acc, input + length - 16, input + length - 32,
+            secret + secretSizeMin - midSizeLastOffset - 16, 0);
+   }
+   result.low = avalanche(acc.low + acc.high);
+   result.high = 0 - avalanche(acc.low * prime64_1 + acc.high * prime64_4 + length * prime64_2);
+   return result;
+}
+
+/**
+ * Accumulates a number of stripes. Each stripe uses the secret from an 8 byte later offset.
+ */
+void accumulatePortable(quint64 acc[8], const uchar* input, const uchar* secretPart, int stripes)
+{
+   for (int stripe = 0; stripe < stripes; stripe++) {
+      const uchar* data = input + stripe * stripeLength;
+      const uchar* key = secretPart + stripe * 8;
+      for (int i = 0; i < 8; i++) {
+         quint64 dataValue = read64(data + i * 8);
+         quint64 dataKey = dataValue ^ read64(key + i * 8);
+         acc[i ^ 1] += dataValue;
+         acc[i] += (dataKey & 0xFFFFFFFF) * (dataKey >> 32);
+      }
+   }
+}
+
+void scramblePortable(quint64 acc[8], const uchar* secretPart)
+{
+   for (int i = 0; i < 8; i++) {
+      quint64 value = acc[i];
+      value ^= value >> 47;
+      value ^= read64(secretPart + i * 8);
+      value *= prime32_1;
+      acc[i] = value;
+   }
+}
+
+#ifdef HASHMAN_X86_64
+void accumulateSse2(quint64 acc[8], const uchar* input, const uchar* secretPart, int stripes)
+{
+   __m128i* accumulators = reinterpret_cast<__m128i*>(acc);
+   for (int stripe = 0; stripe < stripes; stripe++) {
+      const __m128i* data = reinterpret_cast<const __m128i*>(input + stripe * stripeLength);
+      const __m128i* key = reinterpret_cast<const __m128i*>(secretPart + stripe * 8);
+      for (int i = 0; i < 4; i++) {
+         __m128i dataValue = _mm_loadu_si128(data + i);
+         __m128i dataKey = _mm_xor_si128(dataValue, _mm_loadu_si128(key + i));
+         __m128i product = _mm_mul_epu32(dataKey, _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1)));
+         __m128i swapped = _mm_shuffle_epi32(dataValue, _MM_SHUFFLE(1, 0, 3, 2));
+         accumulators[i] = _mm_add_epi64(accumulators[i], _mm_add_epi64(product, swapped));
+      }
+   }
+}
+
+void scrambleSse2(quint64 acc[8], const uchar* secretPart)
+{
+   __m128i* accumulators = reinterpret_cast<__m128i*>(acc);
+   const __m128i* key = reinterpret_cast<const __m128i*>(secretPart);
+   const __m128i prime = _mm_set1_epi32(static_cast<int>(prime32_1));
+   for (int i = 0; i < 4; i++) {
+      __m128i value = accumulators[i];
+      value = _mm_xor_si128(value, _mm_srli_epi64(value, 47));
+      value = _mm_xor_si128(value, _mm_loadu_si128(key + i));
+      __m128i productLow = _mm_mul_epu32(value, prime);
+      __m128i productHigh = _mm_mul_epu32(_mm_shuffle_epi32(value, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+      accumulators[i] = _mm_add_epi64(productLow, _mm_slli_epi64(productHigh, 32));
+   }
+}
+
+HASHMAN_TARGET("avx2")
+void accumulateAvx2(quint64 acc[8], const uchar* input, const uchar* secretPart, int stripes)
+{
+   __m256i* accumulators = reinterpret_cast<__m256i*>(acc);
+   __m256i acc0 = _mm256_load_si256(accumulators);
+   __m256i acc1 = _mm256_load_si256(accumulators + 1);
+   for (int stripe = 0; stripe < stripes; stripe++) {
+      const __m256i* data = reinterpret_cast<const __m256i*>(input + stripe * stripeLength);
+      const __m256i* key = reinterpret_cast<const __m256i*>(secretPart + stripe * 8);
+      __m256i dataValue0 = _mm256_loadu_si256(data);
+      __m256i dataValue1 = _mm256_loadu_si256(data + 1);
+      __m256i dataKey0 = _mm256_xor_si256(dataValue0, _mm256_loadu_si256(key));
+      __m256i dataKey1 = _mm256_xor_si256(dataValue1, _mm256_loadu_si256(key + 1));
+      __m256i product0 = _mm256_mul_epu32(dataKey0, _mm256_shuffle_epi32(dataKey0, _MM_SHUFFLE(0, 3, 0, 1)));
+      __m256i product1 = _mm256_mul_epu32(dataKey1, _mm256_shuffle_epi32(dataKey1, _MM_SHUFFLE(0, 3, 0, 1)));
+      acc0 = _mm256_add_epi64(acc0, _mm256_add_epi64(product0, _mm256_shuffle_epi32(dataValue0, _MM_SHUFFLE(1, 0, 3, 2))));
+      acc1 = _mm256_add_epi64(acc1, _mm256_add_epi64(product1, _mm256_shuffle_epi32(dataValue1, _MM_SHUFFLE(1, 0, 3, 2))));
+   }
+   _mm256_store_si256(accumulators, acc0);
+   _mm256_store_si256(accumulators + 1, acc1);
+}
+
+HASHMAN_TARGET("avx2")
+void scrambleAvx2(quint64 acc[8], const uchar* secretPart)
+{
+   __m256i* accumulators = reinterpret_cast<__m256i*>(acc);
+   const __m256i* key = reinterpret_cast<const __m256i*>(secretPart);
+   const __m256i prime = _mm256_set1_epi32(static_cast<int>(prime32_1));
+   for (int i = 0; i < 2; i++) {
+      __m256i value = _mm256_load_si256(accumulators + i);
+      value = _mm256_xor_si256(value, _mm256_srli_epi64(value, 47));
+      value = _mm256_xor_si256(value, _mm256_loadu_si256(key + i));
+      __m256i productLow = _mm256_mul_epu32(value, prime);
+      __m256i productHigh = _mm256_mul_epu32(_mm256_shuffle_epi32(value, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+      _mm256_store_si256(accumulators + i, _mm256_add_epi64(productLow, _mm256_slli_epi64(productHigh, 32)));
+   }
+}
+#endif
+
+typedef void (*AccumulateFunction)(quint64 acc[8], const uchar* input, const uchar* secretPart, int stripes);
+typedef void (*ScrambleFunction)(quint64 acc[8], const uchar* secretPart);
+
+struct Kernels
+{
+   AccumulateFunction accumulate;
+   ScrambleFunction scramble;
+};
+
+Kernels selectKernels()
+{
+#ifdef HASHMAN_X86_64
+   if (CpuFeatures::get().avx2) {
+      return Kernels{ accumulateAvx2, scrambleAvx2 };
+   }
+   if (CpuFeatures::get().sse2) {
+      return Kernels{ accumulateSse2, scrambleSse2 };
+   }
+#endif
+   return Kernels{ accumulatePortable, scramblePortable };
+}
+
+const Kernels kernels = selectKernels();
+
+quint64 mergeAccumulators(const quint64 acc[8], const uchar* secretPart, quint64 start)
+{
+   quint64 result = start;
+   for (int i = 0; i < 4; i++) {
+      result += multiplyFold64(acc[2 * i] ^ read64(secretPart + 16 * i),
+                               acc[2 * i + 1] ^ read64(secretPart + 16 * i + 8));
+   }
+   return avalanche(result);
+}
+
+/**
+ * Streaming XXH3, used for both the 64 and 128 bit variants. Inputs longer than 240
+ * bytes share the same accumulation and only differ in how the accumulators are merged.
+ */
+template<bool Wide>
+class Xxh3Context : public HashAlgorithm::Context
+{
+public:
+   Xxh3Context() : bufferedLength(0), stripesSoFar(0), totalLength(0)
+   {
+      const quint64 initial[8] = {
+         prime32_3, prime64_1, prime64_2, prime64_3, prime64_4, prime32_2, prime64_5, prime32_1
+      };
+      memcpy(acc, initial, sizeof(acc));
+   }
+
+   void update(const char* data, qint64 length)
+   {
+      const uchar* input = reinterpret_cast<const uchar*>(data);
+      const uchar* end = input + length;
+      totalLength += length;
+      if (bufferedLength + length <= bufferSize) {
+         memcpy(buffer + bufferedLength, input, length);
+         bufferedLength += static_cast<int>(length);
+         return;
+      }
+      if (bufferedLength > 0) {
+         int loadLength = bufferSize - bufferedLength;
+         memcpy(buffer + bufferedLength, input, loadLength);
+         input += loadLength;
+         consumeStripes(acc, stripesSoFar, buffer, bufferSize / stripeLength);
+         bufferedLength = 0;
+      }
+      // Always keep at least one byte in the buffer, the final stripe is handled differently.
+      if (end - input > bufferSize) {
+         qint64 stripes = (end - input - 1) / stripeLength;
+         consumeStripes(acc, stripesSoFar, input, stripes);
+         input += stripes * stripeLength;
+         // The last stripe is needed if fewer than 64 bytes remain at the end.
+         memcpy(buffer + bufferSize - stripeLength, input - stripeLength, stripeLength);
+      }
+      bufferedLength = static_cast<int>(end - input);
+      memcpy(buffer, input, bufferedLength);
+   }
+
+   HashDigest finalize()
+   {
+      Hash128 hash = { 0, 0 };
+      if (totalLength > midSizeMax) {
+         alignas(32) quint64 finalAcc[8];
+         memcpy(finalAcc, acc, sizeof(acc));
+         const uchar* lastStripe;
+         uchar lastStripeBuffer[stripeLength];
+         if (bufferedLength >= stripeLength) {
+            qint64 stripes = (bufferedLength - 1) / stripeLength;
+            int finalStripesSoFar = stripesSoFar;
+            consumeStripes(finalAcc, finalStripesSoFar, buffer, stripes);
+            lastStripe = buffer + bufferedLength - stripeLength;
+         } else {
+            // The last stripe starts in the previously consumed data.
+            int catchup = stripeLength - bufferedLength;
+            memcpy(lastStripeBuffer, buffer + bufferSize - catchup, catchup);
+            memcpy(lastStripeBuffer + catchup, buffer, bufferedLength);
+            lastStripe = lastStripeBuffer;
+         }
+         kernels.accumulate(finalAcc, lastStripe, secret + secretSize - stripeLength - secretLastAccStart, 1);
+         hash.low = mergeAccumulators(finalAcc, secret + secretMergeAccsStart, totalLength * prime64_1);
+         hash.high = mergeAccumulators(finalAcc, secret + secretSize - stripeLength - secretMergeAccsStart,
+                                       ~(totalLength * prime64_2));
+      } else if (Wide) {
+         hash = hash128Short(buffer, totalLength);
+      } else {
+         hash.low = hash64Short(buffer, totalLength);
+      }
+
+      uchar digest[16];
+      if (Wide) {
+         qToBigEndian<quint64>(hash.high, digest);
+         qToBigEndian<quint64>(hash.low, digest + 8);
+      } else {
+         qToBigEndian<quint64>(hash.low, digest);
+      }
+      return HashDigest(digest, Wide ? 16 : 8);
+   }
+
+private:
+   /**
+    * Accumulates stripes, scrambling the accumulators after every 16 stripes.
+    */
+   static void consumeStripes(quint64 acc[8], int& stripesSoFar, const uchar* input, qint64 stripes)
+   {
+      while (stripes > 0) {
+         int count = static_cast<int>(qMin<qint64>(stripes, stripesPerBlock - stripesSoFar));
+         kernels.accumulate(acc, input, secret + stripesSoFar * 8, count);
+         input += count * stripeLength;
+         stripes -= count;
+         stripesSoFar += count;
+         if (stripesSoFar == stripesPerBlock) {
+            kernels.scramble(acc, secret + secretSize - stripeLength);
+            stripesSoFar = 0;
+         }
+      }
+   }
+
+   alignas(32) quint64 acc[8];
+   alignas(32) uchar buffer[bufferSize];
+   int bufferedLength;
+   int stripesSoFar;
+   quint64 totalLength;
+};
+
+}
+
+/**
+ * @brief Xxh3algorithm::registerAlgorithms
+ * @param registry Registers XXH3-64 and XXH128.
+ */
+void Xxh3algorithm::registerAlgorithms(AlgorithmRegistry& registry)
+{
+   registry.add<Xxh3Context<false> >(AlgorithmRegistry::Xxh3_64, "XXH3-64");
+   registry.add<Xxh3Context<true> >(AlgorithmRegistry::Xxh128, "XXH128");
+}
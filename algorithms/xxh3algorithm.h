@@ -0,0 +1,25 @@
+/**
+ * The XXH3 family of non-cryptographic hash functions, see https://github.com/Cyan4973/xxHash
+ *
+ * XXH3-64 and XXH128 are much faster than CRC32 and their larger hash sums make
+ * collisions unlikely even for very large numbers of files, which makes them well
+ * suited for detecting corrupted files. They give no protection against deliberate
+ * modifications.
+ *
+ * The hash sums are written in the canonical form used by xxhsum.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef XXH3ALGORITHM_H
+#define XXH3ALGORITHM_H
+
+#include "hashalgorithm.h"
+
+class Xxh3algorithm : public HashAlgorithm
+{
+public:
+   static void registerAlgorithms(AlgorithmRegistry& registry);
+};
+
+#endif // XXH3ALGORITHM_H
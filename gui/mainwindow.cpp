@@ -13,6 +13,9 @@
 #include "hashproject/sourcedirectory.h"
 #include "gui/sourcedirectorywidget.h"
 #include "workers/hasher.h"
+#include "workers/readpipeline.h"
+#include "workers/throttle.h"
+#include "algorithms/algorithmregistry.h"
 #include "workers/filefinder.h"
 #include "gui/menuactions.h"
 #include "hashproject/filelist.h"
@@ -98,12 +101,37 @@ MainWindow::MainWindow(HashCalcApplication* parent) : QMainWindow()
       hashCalculationOwnThreadCheckbox->setEnabled(false);
    }
    hashCalculationOwnThreadCheckbox->setChecked(settings.value("hashcalculationownthread", true).toBool());
+   QStringList extraAlgorithms = settings.value("extraalgorithms").toStringList();
+   foreach (QAction* action, extraAlgorithmsMenu->actions()) {
+      action->setChecked(extraAlgorithms.contains(action->data().toString()));
+   }
+   parallelDigestsCheckbox->setChecked(settings.value("paralleldigests", true).toBool());
+   splitLargeFilesCheckbox->setChecked(settings.value("splitlargefiles", true).toBool());
+   readModeComboBox->setCurrentIndex(qMax(0, readModeComboBox->findData(settings.value("readmode", FileReader::ReadCalls).toInt())));
+   queueDepthSpinBox->setValue(settings.value("queuedepth", 8).toInt());
+   deviceSchedulingCheckbox->setChecked(settings.value("devicescheduling", true).toBool());
+   physicalOrderCheckbox->setChecked(settings.value("physicalorder", false).toBool());
+   int fileHints = settings.value("filehints", 0).toInt();
+   foreach (QAction* action, fileHintsMenu->actions()) {
+      action->setChecked(fileHints & action->data().toInt());
+   }
+   readLimitSpinBox->setValue(settings.value("readlimit", 0).toInt());
+   operationLimitSpinBox->setValue(settings.value("operationlimit", 0).toInt());
+   idlePriorityCheckbox->setChecked(settings.value("idlepriority", false).toBool());
+   hashCacheCheckbox->setChecked(settings.value("hashcache", false).toBool());
+   hashAttributesCheckbox->setChecked(settings.value("hashattributes", false).toBool());
+   if (!hashAttributesCheckbox->isChecked()) {
+      forceVerifyReadsCheckbox->setEnabled(false);
+   }
+   forceVerifyReadsCheckbox->setChecked(settings.value("forceverifyreads", true).toBool());
+   sortedScanCheckbox->setChecked(settings.value("sortedscan", false).toBool());
    mainWidget->restoreState(settings.value("splittersizes").toByteArray());
 
    connect(filelist, SIGNAL(displayFile(QString,QString)), this, SLOT(updateFileDisplay(QString,QString)));
    connect(filelist, SIGNAL(fileListSizeChanged(int, int, int, int)), statusBox, SLOT(updateStatusBox(int, int, int, int)));
    connect(filelist, SIGNAL(fileListSizeChanged(int, int, int, int)), actions, SLOT(filelistChanged(int, int, int, int)));
    updateProjectSettings();
+   updateThrottle();
 }
 
 /**
@@ -115,6 +143,33 @@ MainWindow::~MainWindow()
    settings.setValue("selectedalgorithm", algorithmComboBox->currentText());
    settings.setValue("calchashsumwhenfound", calcHashSumWhenFoundCheckbox->isChecked());
    settings.setValue("hashcalculationownthread", hashCalculationOwnThreadCheckbox->isChecked());
+   QStringList extraAlgorithms;
+   foreach (QAction* action, extraAlgorithmsMenu->actions()) {
+      if (action->isChecked()) {
+         extraAlgorithms.append(action->data().toString());
+      }
+   }
+   settings.setValue("extraalgorithms", extraAlgorithms);
+   settings.setValue("paralleldigests", parallelDigestsCheckbox->isChecked());
+   settings.setValue("splitlargefiles", splitLargeFilesCheckbox->isChecked());
+   settings.setValue("readmode", readModeComboBox->currentData().toInt());
+   settings.setValue("queuedepth", queueDepthSpinBox->value());
+   settings.setValue("devicescheduling", deviceSchedulingCheckbox->isChecked());
+   settings.setValue("physicalorder", physicalOrderCheckbox->isChecked());
+   int fileHints = 0;
+   foreach (QAction* action, fileHintsMenu->actions()) {
+      if (action->isChecked()) {
+         fileHints |= action->data().toInt();
+      }
+   }
+   settings.setValue("filehints", fileHints);
+   settings.setValue("readlimit", readLimitSpinBox->value());
+   settings.setValue("operationlimit", operationLimitSpinBox->value());
+   settings.setValue("idlepriority", idlePriorityCheckbox->isChecked());
+   settings.setValue("hashcache", hashCacheCheckbox->isChecked());
+   settings.setValue("hashattributes", hashAttributesCheckbox->isChecked());
+   settings.setValue("forceverifyreads", forceVerifyReadsCheckbox->isChecked());
+   settings.setValue("sortedscan", sortedScanCheckbox->isChecked());
    settings.setValue("splittersizes", mainWidget->saveState());
 
    hasher->abort();
@@ -291,8 +346,9 @@ void MainWindow::createWorkerThreads()
 
    connect(filefinder, SIGNAL(fileFound(HashProject::File, bool)), filelist, SLOT(addFile(HashProject::File, bool)));
 
-   connect(filelist, SIGNAL(hashFile(int, QString, HashProject::File, QString)), hasher, SLOT(hashFile(int, QString, HashProject::File, QString)));
-   connect(hasher, SIGNAL(fileHashCalculated(int, QString, QString, bool)), filelist, SLOT(fileHashCalculated(int, QString, QString, bool)));
+   connect(filelist, SIGNAL(hashFile(int, QString, HashProject::File, HashProject::Settings)), hasher, SLOT(hashFile(int, QString, HashProject::File, HashProject::Settings)));
+   connect(hasher, SIGNAL(fileHashCalculated(int, QString, HashDigest, bool)), filelist, SLOT(fileHashCalculated(int, QString, HashDigest, bool)));
+   connect(hasher, SIGNAL(fileHashFailed(int, QString, bool)), filelist, SLOT(fileHashFailed(int, QString, bool)));
 
    /**
     * Signal path between the three threads when announcing that they are finished:
@@ -319,6 +375,19 @@ void MainWindow::createWorkerThreads()
  * When the settings have been updated a signal will invoke updateProjectSettings().
  * These available settings are as of now:
  *  - Which algorithm to use.
+ *  - Additional algorithms to calculate in the same read of the files.
+ *  - If the above, should the algorithms run on separate cores.
+ *  - Split large files into ranges hashed on separate cores.
+ *  - Read the files with read() calls, from memory mappings or past the page cache.
+ *  - How many blocks to read ahead, across files, while hashing.
+ *  - Read different devices in parallel, with limits depending on the type of device.
+ *  - Hash the files in the order they're stored on the disks.
+ *  - Hints for the page cache: dropping the hashed files, access times and readahead.
+ *  - Limits for the read bandwidth and reads per second, and the idle I/O priority.
+ *  - Reuse the cached hash sums of files that haven't changed since they were hashed.
+ *  - Store the hash sums in attributes of the files, and if the above,
+ *    should the files still be read when verifying.
+ *  - Sort the found files by path, so saved files list them in the same order.
  *  - Scan the new files immidietly
  *  - If the above, should FileList or FileFinder calculate the hash in
  *    their own threads instead of issuing a signal to the HasherThread.
@@ -327,12 +396,117 @@ void MainWindow::createOptionsBox()
 {
    algorithmComboBoxLabel = new QLabel(tr("Hashing algorithm:"));
    algorithmComboBox = new QComboBox();
-   algorithmComboBox->addItem(tr("CRC32"), "CRC32");
-   algorithmComboBox->addItem(tr("MD4"), "MD4");
-   algorithmComboBox->addItem(tr("MD5"), "MD5");
-   algorithmComboBox->addItem(tr("SHA-1"), "SHA-1");
-   algorithmComboBox->addItem(tr("SHA-256"), "SHA-256");
-   algorithmComboBox->addItem(tr("SHA-512"), "SHA-512");
+   foreach (const AlgorithmRegistry::Algorithm& algorithm, AlgorithmRegistry::get().algorithms()) {
+      algorithmComboBox->addItem(algorithm.name, algorithm.name);
+   }
+
+   QLabel* extraAlgorithmsLabel = new QLabel(tr("Also calculate:"));
+   extraAlgorithmsMenu = new QMenu(this);
+   for (int i = 0; i < algorithmComboBox->count(); i++) {
+      QAction* action = extraAlgorithmsMenu->addAction(algorithmComboBox->itemText(i));
+      action->setData(algorithmComboBox->itemData(i));
+      action->setCheckable(true);
+      connect(action, SIGNAL(toggled(bool)), this, SLOT(updateProjectSettings()));
+   }
+   extraAlgorithmsButton = new QToolButton;
+   extraAlgorithmsButton->setMenu(extraAlgorithmsMenu);
+   extraAlgorithmsButton->setPopupMode(QToolButton::InstantPopup);
+   extraAlgorithmsButton->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+   extraAlgorithmsLabel->setBuddy(extraAlgorithmsButton);
+
+   QLabel* parallelDigestsLabel = new QLabel(tr("Algorithms in parallel:"));
+   parallelDigestsCheckbox = new QCheckBox;
+   parallelDigestsCheckbox->setChecked(true);
+   parallelDigestsLabel->setBuddy(parallelDigestsCheckbox);
+
+   QLabel* splitLargeFilesLabel = new QLabel(tr("Split large files:"));
+   splitLargeFilesCheckbox = new QCheckBox;
+   splitLargeFilesCheckbox->setChecked(true);
+   splitLargeFilesLabel->setBuddy(splitLargeFilesCheckbox);
+
+   QLabel* readModeLabel = new QLabel(tr("Read files with:"));
+   readModeComboBox = new QComboBox();
+   readModeComboBox->addItem(tr("Read calls"), FileReader::ReadCalls);
+   readModeComboBox->addItem(tr("Memory mapping"), FileReader::MemoryMapped);
+   readModeComboBox->addItem(tr("Direct I/O"), FileReader::DirectIo);
+   readModeLabel->setBuddy(readModeComboBox);
+
+   QLabel* queueDepthLabel = new QLabel(tr("Read queue depth:"));
+   queueDepthSpinBox = new QSpinBox;
+   queueDepthSpinBox->setRange(1, ReadPipeline::maximumQueueDepth);
+   queueDepthSpinBox->setValue(8);
+   queueDepthLabel->setBuddy(queueDepthSpinBox);
+
+   QLabel* deviceSchedulingLabel = new QLabel(tr("Devices in parallel:"));
+   deviceSchedulingCheckbox = new QCheckBox;
+   deviceSchedulingCheckbox->setChecked(true);
+   deviceSchedulingLabel->setBuddy(deviceSchedulingCheckbox);
+
+   QLabel* physicalOrderLabel = new QLabel(tr("Order by disk location:"));
+   physicalOrderCheckbox = new QCheckBox;
+   physicalOrderCheckbox->setChecked(false);
+   physicalOrderLabel->setBuddy(physicalOrderCheckbox);
+
+   QLabel* fileHintsLabel = new QLabel(tr("Page cache:"));
+   fileHintsMenu = new QMenu(this);
+   QAction* dropCacheAction = fileHintsMenu->addAction(tr("Drop after hashing"));
+   dropCacheAction->setData(FileHints::DropCache);
+   QAction* noAccessTimeAction = fileHintsMenu->addAction(tr("Keep access times"));
+   noAccessTimeAction->setData(FileHints::NoAccessTime);
+   QAction* readaheadAction = fileHintsMenu->addAction(tr("Read ahead"));
+   readaheadAction->setData(FileHints::Readahead);
+   foreach (QAction* action, fileHintsMenu->actions()) {
+      action->setCheckable(true);
+      connect(action, SIGNAL(toggled(bool)), this, SLOT(updateProjectSettings()));
+   }
+   fileHintsButton = new QToolButton;
+   fileHintsButton->setMenu(fileHintsMenu);
+   fileHintsButton->setPopupMode(QToolButton::InstantPopup);
+   fileHintsButton->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+   fileHintsLabel->setBuddy(fileHintsButton);
+
+   QLabel* readLimitLabel = new QLabel(tr("Read limit:"));
+   readLimitSpinBox = new QSpinBox;
+   readLimitSpinBox->setRange(0, 100000);
+   readLimitSpinBox->setSuffix(tr(" MB/s"));
+   readLimitSpinBox->setSpecialValueText(tr("No limit"));
+   operationLimitSpinBox = new QSpinBox;
+   operationLimitSpinBox->setRange(0, 1000000);
+   operationLimitSpinBox->setSuffix(tr(" reads/s"));
+   operationLimitSpinBox->setSpecialValueText(tr("No limit"));
+   QHBoxLayout* readLimitLayout = new QHBoxLayout;
+   readLimitLayout->setContentsMargins(0, 0, 0, 0);
+   readLimitLayout->addWidget(readLimitSpinBox);
+   readLimitLayout->addWidget(operationLimitSpinBox);
+   QWidget* readLimitWidget = new QWidget;
+   readLimitWidget->setLayout(readLimitLayout);
+   readLimitLabel->setBuddy(readLimitSpinBox);
+
+   QLabel* idlePriorityLabel = new QLabel(tr("Idle I/O priority:"));
+   idlePriorityCheckbox = new QCheckBox;
+   idlePriorityCheckbox->setChecked(false);
+   idlePriorityLabel->setBuddy(idlePriorityCheckbox);
+
+   QLabel* hashCacheLabel = new QLabel(tr("Reuse cached hash sums:"));
+   hashCacheCheckbox = new QCheckBox;
+   hashCacheCheckbox->setChecked(false);
+   hashCacheLabel->setBuddy(hashCacheCheckbox);
+
+   QLabel* hashAttributesLabel = new QLabel(tr("Hash sums in attributes:"));
+   hashAttributesCheckbox = new QCheckBox;
+   hashAttributesCheckbox->setChecked(false);
+   hashAttributesLabel->setBuddy(hashAttributesCheckbox);
+
+   QLabel* forceVerifyReadsLabel = new QLabel(tr("Read files when verifying:"));
+   forceVerifyReadsCheckbox = new QCheckBox;
+   forceVerifyReadsCheckbox->setChecked(true);
+   forceVerifyReadsLabel->setBuddy(forceVerifyReadsCheckbox);
+
+   QLabel* sortedScanLabel = new QLabel(tr("Sort found files:"));
+   sortedScanCheckbox = new QCheckBox;
+   // The files are then listed when the whole tree has been scanned.
+   sortedScanCheckbox->setChecked(false);
+   sortedScanLabel->setBuddy(sortedScanCheckbox);
 
    QLabel* scanAfterFileFoundLabel = new QLabel(tr("Hash files when found:"));
    calcHashSumWhenFoundCheckbox = new QCheckBox;
@@ -348,19 +522,62 @@ void MainWindow::createOptionsBox()
    QGridLayout* layout = new QGridLayout;
    layout->addWidget(algorithmComboBoxLabel, 0, 1);
    layout->addWidget(algorithmComboBox, 0, 2);
-   layout->addWidget(scanAfterFileFoundLabel, 2, 1);
-   layout->addWidget(calcHashSumWhenFoundCheckbox, 2, 2);
-   layout->addWidget(hashCalculationOwnThreadLabel, 3, 1);
-   layout->addWidget(hashCalculationOwnThreadCheckbox, 3, 2);
+   layout->addWidget(extraAlgorithmsLabel, 1, 1);
+   layout->addWidget(extraAlgorithmsButton, 1, 2);
+   layout->addWidget(parallelDigestsLabel, 2, 1);
+   layout->addWidget(parallelDigestsCheckbox, 2, 2);
+   layout->addWidget(splitLargeFilesLabel, 3, 1);
+   layout->addWidget(splitLargeFilesCheckbox, 3, 2);
+   layout->addWidget(readModeLabel, 4, 1);
+   layout->addWidget(readModeComboBox, 4, 2);
+   layout->addWidget(queueDepthLabel, 5, 1);
+   layout->addWidget(queueDepthSpinBox, 5, 2);
+   layout->addWidget(deviceSchedulingLabel, 6, 1);
+   layout->addWidget(deviceSchedulingCheckbox, 6, 2);
+   layout->addWidget(physicalOrderLabel, 7, 1);
+   layout->addWidget(physicalOrderCheckbox, 7, 2);
+   layout->addWidget(fileHintsLabel, 8, 1);
+   layout->addWidget(fileHintsButton, 8, 2);
+   layout->addWidget(readLimitLabel, 9, 1);
+   layout->addWidget(readLimitWidget, 9, 2);
+   layout->addWidget(idlePriorityLabel, 10, 1);
+   layout->addWidget(idlePriorityCheckbox, 10, 2);
+   layout->addWidget(hashCacheLabel, 11, 1);
+   layout->addWidget(hashCacheCheckbox, 11, 2);
+   layout->addWidget(hashAttributesLabel, 12, 1);
+   layout->addWidget(hashAttributesCheckbox, 12, 2);
+   layout->addWidget(forceVerifyReadsLabel, 13, 1);
+   layout->addWidget(forceVerifyReadsCheckbox, 13, 2);
+   layout->addWidget(sortedScanLabel, 14, 1);
+   layout->addWidget(sortedScanCheckbox, 14, 2);
+   layout->addWidget(scanAfterFileFoundLabel, 15, 1);
+   layout->addWidget(calcHashSumWhenFoundCheckbox, 15, 2);
+   layout->addWidget(hashCalculationOwnThreadLabel, 16, 1);
+   layout->addWidget(hashCalculationOwnThreadCheckbox, 16, 2);
    layout->setColumnStretch(0, 1);
    layout->setColumnStretch(4, 1);
 
    connect(calcHashSumWhenFoundCheckbox, SIGNAL(toggled(bool)), hashCalculationOwnThreadCheckbox, SLOT(setEnabled(bool)));
    connect(calcHashSumWhenFoundCheckbox, SIGNAL(toggled(bool)), hashCalculationOwnThreadLabel, SLOT(setEnabled(bool)));
+   connect(hashAttributesCheckbox, SIGNAL(toggled(bool)), forceVerifyReadsCheckbox, SLOT(setEnabled(bool)));
+   connect(hashAttributesCheckbox, SIGNAL(toggled(bool)), forceVerifyReadsLabel, SLOT(setEnabled(bool)));
 
    connect(algorithmComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(updateProjectSettings()));
    connect(calcHashSumWhenFoundCheckbox, SIGNAL(toggled(bool)), this, SLOT(updateProjectSettings()));
    connect(hashCalculationOwnThreadCheckbox, SIGNAL(toggled(bool)), this, SLOT(updateProjectSettings()));
+   connect(parallelDigestsCheckbox, SIGNAL(toggled(bool)), this, SLOT(updateProjectSettings()));
+   connect(splitLargeFilesCheckbox, SIGNAL(toggled(bool)), this, SLOT(updateProjectSettings()));
+   connect(readModeComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(updateProjectSettings()));
+   connect(queueDepthSpinBox, SIGNAL(valueChanged(int)), this, SLOT(updateProjectSettings()));
+   connect(deviceSchedulingCheckbox, SIGNAL(toggled(bool)), this, SLOT(updateProjectSettings()));
+   connect(physicalOrderCheckbox, SIGNAL(toggled(bool)), this, SLOT(updateProjectSettings()));
+   connect(readLimitSpinBox, SIGNAL(valueChanged(int)), this, SLOT(updateThrottle()));
+   connect(operationLimitSpinBox, SIGNAL(valueChanged(int)), this, SLOT(updateThrottle()));
+   connect(idlePriorityCheckbox, SIGNAL(toggled(bool)), this, SLOT(updateThrottle()));
+   connect(hashCacheCheckbox, SIGNAL(toggled(bool)), this, SLOT(updateProjectSettings()));
+   connect(hashAttributesCheckbox, SIGNAL(toggled(bool)), this, SLOT(updateProjectSettings()));
+   connect(forceVerifyReadsCheckbox, SIGNAL(toggled(bool)), this, SLOT(updateProjectSettings()));
+   connect(sortedScanCheckbox, SIGNAL(toggled(bool)), this, SLOT(updateProjectSettings()));
 
    optionsBox = new QGroupBox(tr("Options"));
    optionsBox->setLayout(layout);
@@ -375,7 +592,29 @@ void MainWindow::createOptionsBox()
 HashProject::Settings MainWindow::getSettings()
 {
    HashProject::Settings settings;
-   settings.algorithm = algorithmComboBox->currentText();
+   settings.algorithms.append(algorithmComboBox->currentText());
+   foreach (QAction* action, extraAlgorithmsMenu->actions()) {
+      QString algorithm = action->data().toString();
+      if (action->isChecked() && !settings.algorithms.contains(algorithm)) {
+         settings.algorithms.append(algorithm);
+      }
+   }
+   settings.paralleldigests = parallelDigestsCheckbox->isChecked();
+   settings.splitlargefiles = splitLargeFilesCheckbox->isChecked();
+   settings.readmode = static_cast<FileReader::Mode>(readModeComboBox->currentData().toInt());
+   settings.queuedepth = queueDepthSpinBox->value();
+   settings.devicescheduling = deviceSchedulingCheckbox->isChecked();
+   settings.physicalorder = physicalOrderCheckbox->isChecked();
+   settings.filehints = 0;
+   foreach (QAction* action, fileHintsMenu->actions()) {
+      if (action->isChecked()) {
+         settings.filehints |= action->data().toInt();
+      }
+   }
+   settings.hashcache = hashCacheCheckbox->isChecked();
+   settings.hashattributes = hashAttributesCheckbox->isChecked();
+   settings.forceverifyreads = forceVerifyReadsCheckbox->isChecked();
+   settings.sortedscan = sortedScanCheckbox->isChecked();
    settings.scanimmediately = calcHashSumWhenFoundCheckbox->isChecked();
    settings.blockinghashcalc = !hashCalculationOwnThreadCheckbox->isChecked();
    return settings;
@@ -387,7 +626,52 @@ HashProject::Settings MainWindow::getSettings()
  */
 void MainWindow::updateProjectSettings()
 {
-   mainproject->setSettings(this->getSettings());
+   HashProject::Settings settings = this->getSettings();
+   QStringList extraAlgorithms = settings.algorithms.mid(1);
+   extraAlgorithmsButton->setText(extraAlgorithms.isEmpty() ? tr("None") : extraAlgorithms.join(", "));
+   QStringList fileHints;
+   foreach (QAction* action, fileHintsMenu->actions()) {
+      if (action->isChecked()) {
+         fileHints.append(action->text());
+      }
+   }
+   fileHintsButton->setText(fileHints.isEmpty() ? tr("Default") : fileHints.join(", "));
+   mainproject->setSettings(settings);
+}
+
+/**
+ * @brief MainWindow::updateThrottle
+ * Applies the read limits and I/O priority. They're shared by all windows, and apply at once,
+ * also to the hashing in progress.
+ */
+void MainWindow::updateThrottle()
+{
+   Throttle::get().setLimits(qint64(readLimitSpinBox->value()) * 1024 * 1024, operationLimitSpinBox->value());
+   Throttle::get().setIdlePriority(idlePriorityCheckbox->isChecked());
+}
+
+/**
+ * @brief MainWindow::setReadLimits
+ * @param megabytesPerSecond Read bandwidth, 0 for no limit and -1 to keep the current value.
+ * @param readsPerSecond Number of reads per second, 0 for no limit and -1 to keep the current value.
+ */
+void MainWindow::setReadLimits(int megabytesPerSecond, int readsPerSecond)
+{
+   if (megabytesPerSecond >= 0) {
+      readLimitSpinBox->setValue(megabytesPerSecond);
+   }
+   if (readsPerSecond >= 0) {
+      operationLimitSpinBox->setValue(readsPerSecond);
+   }
+}
+
+/**
+ * @brief MainWindow::setIdlePriority
+ * @param idle Read with the idle I/O priority.
+ */
+void MainWindow::setIdlePriority(bool idle)
+{
+   idlePriorityCheckbox->setChecked(idle);
 }
 
 /**
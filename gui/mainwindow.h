@@ -14,6 +14,7 @@ class QLabel;
 class QPushButton;
 class QTextEdit;
 class QComboBox;
+class QSpinBox;
 class QTableWidget;
 class SourceDirectory;
 class SourceDirectoryWidget;
@@ -27,6 +28,8 @@ class FileListView;
 class FileList;
 class QBoxLayout;
 class QCheckBox;
+class QToolButton;
+class QMenu;
 class FileDrop;
 class QLineEdit;
 class QSplitter;
@@ -41,6 +44,8 @@ public:
    ~MainWindow();
    HashCalcApplication* parent() const { return parentapp; }
    bool isListEmpty();
+   void setReadLimits(int megabytesPerSecond, int readsPerSecond);
+   void setIdlePriority(bool idle);
 
 signals:
    void findFiles(HashProject*);
@@ -70,6 +75,7 @@ public slots:
    void setFileSizeVisible(bool);
    void updateFileDisplay(QString filename, QString hash);
    void updateProjectSettings();
+   void updateThrottle();
    //
    void removeSelectedRows();
    void copySelectedRows();
@@ -126,6 +132,23 @@ private:
    QGroupBox* optionsBox;
    QLabel* algorithmComboBoxLabel;
    QComboBox* algorithmComboBox;
+   QToolButton* extraAlgorithmsButton;
+   QMenu* extraAlgorithmsMenu;
+   QCheckBox* parallelDigestsCheckbox;
+   QCheckBox* splitLargeFilesCheckbox;
+   QComboBox* readModeComboBox;
+   QSpinBox* queueDepthSpinBox;
+   QCheckBox* deviceSchedulingCheckbox;
+   QCheckBox* physicalOrderCheckbox;
+   QToolButton* fileHintsButton;
+   QMenu* fileHintsMenu;
+   QSpinBox* readLimitSpinBox;
+   QSpinBox* operationLimitSpinBox;
+   QCheckBox* idlePriorityCheckbox;
+   QCheckBox* hashCacheCheckbox;
+   QCheckBox* hashAttributesCheckbox;
+   QCheckBox* forceVerifyReadsCheckbox;
+   QCheckBox* sortedScanCheckbox;
    QCheckBox* calcHashSumWhenFoundCheckbox;
    QCheckBox* hashCalculationOwnThreadCheckbox;
 
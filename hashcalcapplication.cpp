@@ -8,9 +8,13 @@
  * Will be destroyed (and the application process exited) when the
  * last visible MainWindow is closed.
  *
+ * The command line takes a project file to open, and the read limits, which
+ * are useful when verifying on servers in use. See --help.
+ *
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include <QCommandLineParser>
 #include <QMessageBox>
 #include <QFileOpenEvent>
 #include <QWindow>
@@ -26,11 +30,37 @@
  * @param argc Number of arguments passed (including the application name).
  * @param argv Array of C char strings.
  */
-HashCalcApplication::HashCalcApplication(int argc, char * argv[]) : QApplication(argc,argv)
+HashCalcApplication::HashCalcApplication(int& argc, char * argv[]) : QApplication(argc,argv)
 {
+   QCommandLineParser parser;
+   parser.addHelpOption();
+   parser.addPositionalArgument("file", tr("Project file to open."));
+   QCommandLineOption readLimitOption("read-limit", tr("Limit the reads to <MB/s>, 0 for no limit."), "MB/s");
+   QCommandLineOption operationLimitOption("operation-limit", tr("Limit the number of reads to <reads/s>, 0 for no limit."), "reads/s");
+   QCommandLineOption idlePriorityOption("idle-priority", tr("Read with the idle I/O priority."));
+   parser.addOption(readLimitOption);
+   parser.addOption(operationLimitOption);
+   parser.addOption(idlePriorityOption);
+   parser.process(arguments());
+
    addWindow();
-   if (argc > 1) {
-      mainwindows.first()->openFile(QString(argv[1]));
+   MainWindow* window = mainwindows.first();
+   // Limits not given, or not valid numbers, keep the values from the last session.
+   bool valid;
+   int readLimit = parser.value(readLimitOption).toInt(&valid);
+   if (!valid) {
+      readLimit = -1;
+   }
+   int operationLimit = parser.value(operationLimitOption).toInt(&valid);
+   if (!valid) {
+      operationLimit = -1;
+   }
+   window->setReadLimits(readLimit, operationLimit);
+   if (parser.isSet(idlePriorityOption)) {
+      window->setIdlePriority(true);
+   }
+   if (!parser.positionalArguments().isEmpty()) {
+      window->openFile(parser.positionalArguments().first());
    }
 }
 
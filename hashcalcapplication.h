@@ -26,7 +26,7 @@ class HashCalcApplication : public QApplication
    Q_OBJECT
 
 public:
-   HashCalcApplication(int argc, char * argv[]);
+   HashCalcApplication(int& argc, char * argv[]);
    ~HashCalcApplication() {}
    void windowUpdated(MainWindow*);
 
@@ -10,6 +10,10 @@
  * While the list widget can still be scrolled when the list is locked, the sorting
  * can't be changed.
  *
+ * A file can have hash sums for several algorithms. The primary algorithm's hash sum
+ * is displayed in the list, all of them are stored as item data in the hash column.
+ * The stored hash sums are HashDigest values, only the displayed text is in hex form.
+ *
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
@@ -38,6 +42,8 @@ FileList::FileList(HashProject* parent)
 
    qRegisterMetaType<std::list<HashProject::File> >("std::list<HashProject::File>");
    qRegisterMetaType<HashProject::File>("HashProject::File");
+   qRegisterMetaType<HashProject::Settings>("HashProject::Settings");
+   qRegisterMetaType<HashDigest>("HashDigest");
 
    QStringList labels;
    labels.append(tr("Name"));
@@ -210,7 +216,7 @@ void FileList::rowSelectionChanged()
    QList<QTableWidgetItem *> selectionList = selectedItems();
    if (!selectionList.isEmpty()) {
       int rowNum = selectionList.first()->row();
-      emit displayFile(item(rowNum, 0)->text(), item(rowNum, 2)->text());
+      emit displayFile(item(rowNum, 0)->text(), formatHashes(rowNum));
    }
 }
 
@@ -257,6 +263,8 @@ void FileList::removeHashes()
    setHashesColumnsVisibility(false);
    for (int i=0; i<rowCount(); i++) {
       item(i, 2)->setText("");
+      item(i, 2)->setData(hashesRole, QVariant());
+      item(i, 2)->setToolTip("");
       item(i, 5)->setText("");
    }
    removeVerifications();
@@ -274,6 +282,7 @@ void FileList::removeVerifications()
       setVerificationColumnsVisibility(false);
       for (int i=0; i<rowCount(); i++) {
          item(i, 3)->setText("");
+         item(i, 3)->setData(hashesRole, QVariant());
          item(i, 4)->setText("");
          item(i, 4)->setBackground(QBrush());
       }
@@ -362,12 +371,21 @@ void FileList::processBuffer(bool forcedUpdate)
       if ((*file).filesize >= 0) {
          filesizecell->setData(Qt::DisplayRole, (*file).filesize);
       }
-      if (!(*file).hash.isEmpty()) {
+      if (!(*file).hashes.isEmpty()) {
          numHashes++;
-         hashcell->setText((*file).hash.toUpper());
-      }
-      if (!(*file).algorithm.isEmpty()) {
-         algorithmcell->setText((*file).algorithm.toUpper());
+         QString algorithm = (*file).algorithm;
+         if (algorithm.isEmpty()) {
+            algorithm = (*file).hashes.firstKey();
+         }
+         hashcell->setText((*file).hashes.value(algorithm).toHex());
+         algorithmcell->setText(algorithm.toUpper());
+      } else if (!(*file).error.isEmpty()) {
+         // Hashed by the file finder but couldn't be read, shown like FileList::fileHashFailed does.
+         if (numHashes == 0) {
+            setHashesColumnsVisibility(true);
+         }
+         numHashes++;
+         hashcell->setText((*file).error);
       }
       QFont cellFont;
 #ifdef Q_OS_MAC
@@ -386,12 +404,13 @@ void FileList::processBuffer(bool forcedUpdate)
       setItem(numFiles, 3, verifyhashcell);
       setItem(numFiles, 4, ismatchcell);
       setItem(numFiles, 5, algorithmcell);
+      setHashes(numFiles, (*file).hashes);
       if (!isWriteLocked) {
          setRowCount(numFiles);
          return;
       }
-      if ((*file).hash.isEmpty() && parent->getSettings().scanimmediately) {
-         emit hashFile(numFiles, basepath, (*file), parent->getSettings().algorithm);
+      if ((*file).hashes.isEmpty() && (*file).error.isEmpty() && parent->getSettings().scanimmediately) {
+         emit hashFile(numFiles, basepath, (*file), parent->getSettings());
       }
       numFiles++;
    }
@@ -407,32 +426,46 @@ void FileList::processBuffer(bool forcedUpdate)
  * @param verify Was this for verification?
  *
  * Updates the file list with the new hash sum.
+ * The first hash sum calculated for a file decides its primary algorithm.
+ * When verifying a file with several hash sums, it's only marked as a match if all of them match.
  */
-void FileList::fileHashCalculated(int id, QString algorithm, QString hash, bool verify)
+void FileList::fileHashCalculated(int id, QString algorithm, HashDigest hash, bool verify)
 {
    if (id < rowCount() && id > -1) {
-      hash = hash.toUpper();
-      if (!verify && item(id, 2)->text().isEmpty()) {
-         if (numHashes == 0) {
-            setHashesColumnsVisibility(true);
+      QMap<QString, HashDigest> hashes = getHashes(id);
+      if (!verify && !hashes.contains(algorithm)) {
+         if (hashes.isEmpty()) {
+            // The row may already be counted if an earlier attempt failed.
+            if (item(id, 2)->text().isEmpty()) {
+               if (numHashes == 0) {
+                  setHashesColumnsVisibility(true);
+               }
+               numHashes++;
+            }
+            item(id, 2)->setText(hash.toHex());
+            item(id, 5)->setText(algorithm);
          }
-         numHashes++;
-         item(id, 2)->setText(hash);
-         item(id, 5)->setText(algorithm);
+         hashes[algorithm] = hash;
+         setHashes(id, hashes);
       } else if (verify) {
-         if (numVerifiedHashes == 0) {
-            setVerificationColumnsVisibility(true);
+         QVariantMap verifications = item(id, 3)->data(hashesRole).toMap();
+         if (verifications.isEmpty()) {
+            if (numVerifiedHashes == 0) {
+               setVerificationColumnsVisibility(true);
+            }
+            numVerifiedHashes++;
+         }
+         verifications[algorithm] = QVariant::fromValue(hash);
+         item(id, 3)->setData(hashesRole, verifications);
+         if (algorithm == item(id, 5)->text() || item(id, 3)->text().isEmpty()) {
+            item(id, 3)->setText(hash.toHex());
          }
-         numVerifiedHashes++;
-         item(id, 3)->setText(hash);
          // Make the status row green or red depending on if the verification matched.
-         if (item(id, 2)->text() == hash) {
+         if (hashes.value(algorithm) != hash) {
+            markInvalid(id);
+         } else if (item(id, 4)->text().isEmpty()) {
             item(id, 4)->setText("MATCH");
             item(id, 4)->setBackground(QBrush(QColor(0,255,0)));
-         } else {
-            item(id, 4)->setText("INVALID");
-            item(id, 4)->setBackground(QBrush(QColor(255,0,0)));
-            numInvalidFiles++;
          }
       }
       emit fileListSizeChanged(rowCount(), numHashes, numVerifiedHashes, numInvalidFiles);
@@ -440,3 +473,105 @@ void FileList::fileHashCalculated(int id, QString algorithm, QString hash, bool
    }
 }
 
+/**
+ * @brief FileList::fileHashFailed
+ * @param id Row number.
+ * @param error Error message, displayed instead of the hash sum.
+ * @param verify Was this for verification?
+ *
+ * The file couldn't be read. No hash sum is stored, so the file is hashed again the
+ * next time the hash sums are calculated. A failed verification marks the file as invalid.
+ */
+void FileList::fileHashFailed(int id, QString error, bool verify)
+{
+   if (id < rowCount() && id > -1) {
+      if (!verify && getHashes(id).isEmpty()) {
+         if (item(id, 2)->text().isEmpty()) {
+            if (numHashes == 0) {
+               setHashesColumnsVisibility(true);
+            }
+            numHashes++;
+         }
+         item(id, 2)->setText(error);
+      } else if (verify) {
+         if (item(id, 3)->text().isEmpty()) {
+            if (numVerifiedHashes == 0) {
+               setVerificationColumnsVisibility(true);
+            }
+            numVerifiedHashes++;
+         }
+         item(id, 3)->setText(error);
+         markInvalid(id);
+      }
+      emit fileListSizeChanged(rowCount(), numHashes, numVerifiedHashes, numInvalidFiles);
+      viewport()->update();
+   }
+}
+
+/**
+ * @brief FileList::markInvalid
+ * @param row Row number.
+ * Makes the status row red, the file didn't match its hash sums.
+ */
+void FileList::markInvalid(int row)
+{
+   if (item(row, 4)->text() != "INVALID") {
+      item(row, 4)->setText("INVALID");
+      item(row, 4)->setBackground(QBrush(QColor(255,0,0)));
+      numInvalidFiles++;
+   }
+}
+
+/**
+ * @brief FileList::getHashes
+ * @param row Row number.
+ * @return All hash sums calculated for the file, keyed by algorithm name.
+ */
+QMap<QString, HashDigest> FileList::getHashes(int row) const
+{
+   QMap<QString, HashDigest> hashes;
+   QTableWidgetItem* hashcell = item(row, 2);
+   if (hashcell) {
+      QVariantMap storedHashes = hashcell->data(hashesRole).toMap();
+      for (auto it = storedHashes.constBegin(); it != storedHashes.constEnd(); ++it) {
+         hashes[it.key()] = it.value().value<HashDigest>();
+      }
+   }
+   return hashes;
+}
+
+/**
+ * @brief FileList::setHashes
+ * @param row Row number.
+ * @param hashes All hash sums for the file, keyed by algorithm name.
+ *
+ * Stores the hash sums in the hash column and lists them in its tooltip.
+ */
+void FileList::setHashes(int row, const QMap<QString, HashDigest>& hashes)
+{
+   QVariantMap storedHashes;
+   for (auto it = hashes.constBegin(); it != hashes.constEnd(); ++it) {
+      storedHashes[it.key()] = QVariant::fromValue(it.value());
+   }
+   item(row, 2)->setData(hashesRole, storedHashes);
+   item(row, 2)->setToolTip(hashes.size() > 1 ? formatHashes(row, "\n") : QString());
+}
+
+/**
+ * @brief FileList::formatHashes
+ * @param row Row number.
+ * @param separator Put between the hash sums when there are several.
+ * @return The primary hash sum, or if there are several a list with all of them and their algorithms.
+ */
+QString FileList::formatHashes(int row, QString separator) const
+{
+   QMap<QString, HashDigest> hashes = getHashes(row);
+   if (hashes.size() < 2) {
+      return item(row, 2)->text();
+   }
+   QStringList formatted;
+   for (auto it = hashes.constBegin(); it != hashes.constEnd(); ++it) {
+      formatted.append(QString("%1: %2").arg(it.key(), it.value().toHex()));
+   }
+   return formatted.join(separator);
+}
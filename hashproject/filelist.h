@@ -10,6 +10,10 @@
  * While the list widget can still be scrolled when the list is locked, the sorting
  * can't be changed.
  *
+ * A file can have hash sums for several algorithms. The primary algorithm's hash sum
+ * is displayed in the list, all of them are stored as item data in the hash column.
+ * The stored hash sums are HashDigest values, only the displayed text is in hex form.
+ *
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
@@ -43,10 +47,12 @@ public:
    void removeSelectedRows();
    void copySelectedRowsToClipboard();
 
+   QMap<QString, HashDigest> getHashes(int row) const;
+
 signals:
    void fileListSizeChanged(int, int, int, int);
    void displayFile(QString filename, QString hash);
-   void hashFile(int id, QString basepath, HashProject::File file, QString algorithm);
+   void hashFile(int id, QString basepath, HashProject::File file, HashProject::Settings settings);
    void noMoreFileJobs();
    void processingDone();
 
@@ -55,7 +61,8 @@ public slots:
    void hashingFinished();
    void addFiles(std::list<HashProject::File> files);
    void addFile(HashProject::File file, bool forceUpdate=false);
-   void fileHashCalculated(int id, QString algorithm, QString hash, bool verify);
+   void fileHashCalculated(int id, QString algorithm, HashDigest hash, bool verify);
+   void fileHashFailed(int id, QString error, bool verify);
    void removeHashes();
    void removeVerifications();
    void setVerificationColumnsVisibility(bool visible);
@@ -68,6 +75,13 @@ protected:
 
 private:
    void processBuffer(bool forcedUpdate=false);
+   void markInvalid(int row);
+   void setHashes(int row, const QMap<QString, HashDigest>& hashes);
+   QString formatHashes(int row, QString separator="  ") const;
+
+   // Item data role for the hash sums of all algorithms, stored in the hash
+   // and verification columns.
+   static const int hashesRole = Qt::UserRole;
 
    QList<HashProject::File> filesToAdd;
 
@@ -5,8 +5,10 @@
 #include <QMessageBox>
 #include <QDateTime>
 #include <QHash>
+#include <QDebug>
 #include <list>
 
+#include "algorithms/algorithmregistry.h"
 #include "filelist.h"
 #include "hashproject.h"
 #include "sourcedirectory.h"
@@ -97,7 +99,12 @@ bool HashProject::openFile(QString filename)
       int algorithmSettingPos = textline.indexOf(algorithmSettingName);
       if (isComment && algorithmSettingPos != -1) {
          // It's algorithm metadata, use the new value for the following list entries.
-         algorithm = textline.right(textline.length() - algorithmSettingPos - algorithmSettingName.length());
+         QString name = textline.right(textline.length() - algorithmSettingPos - algorithmSettingName.length());
+         const AlgorithmRegistry::Algorithm* registered = AlgorithmRegistry::get().find(name);
+         if (!registered) {
+            qDebug() << "Unknown algorithm, ignoring its hash sums: " << name;
+         }
+         algorithm = registered ? registered->name : QString();
       } else {
          QStringList elements(textline);
          QString outfilename;
@@ -133,12 +140,17 @@ bool HashProject::openFile(QString filename)
             filesOrder.push_back(outfilename);
          }
          if (!filesize.isNull()) {
-            newfile.filesize = filesize.toInt();
+            newfile.filesize = filesize.toLongLong();
          }
          if (!isComment) {
             newfile.filename = outfilename;
-            newfile.hash = hash;
-            newfile.algorithm = algorithm;
+            HashDigest digest = HashDigest::fromHex(hash);
+            if (!digest.isEmpty() && !algorithm.isEmpty()) {
+               if (newfile.algorithm.isEmpty()) {
+                  newfile.algorithm = algorithm;
+               }
+               newfile.hashes[algorithm] = digest;
+            }
          }
          newFiles[outfilename] = newfile;
       }
@@ -167,7 +179,9 @@ bool HashProject::openFile(QString filename)
  * Writes the project data to an SFV file.
  * Extends the standard CRC32 SFV file format with extra metadata added as comments.
  * Thus it's possible to open the saved files in other programs as long as they only
- * contain CRC32 hash sums, hile at the same time it's possible to save complex projects.
+ * contain CRC32 hash sums, while at the same time it's possible to save complex projects.
+ * When the files have hash sums for several algorithms, one section per algorithm is
+ * written, each starting with an algorithm metadata line.
  * Information about the SFV file format is mainly taken from http://rescene.wikidot.com/pdsfv#format
  * See also HashProject::openFile.
  */
@@ -180,9 +194,35 @@ bool HashProject::saveFile(QString filename)
    if (!file.open(QFile::WriteOnly | QFile::Text)) {
       return false;
    }
-   QString outpath = QFileInfo(filename).path();
+   QDir outdir(QFileInfo(filename).path());
+   QDir sourcedir(sourceDirectory->getPath());
 
-   QString currAlgorithm = this->getSettings().algorithm;
+   // All algorithms used in the list, primary algorithms first.
+   QStringList algorithms;
+   QStringList paths;
+   for (int i=0; i < filelist->rowCount(); i++) {
+      QString primaryAlgorithm = filelist->item(i, 5)->text();
+      if (!primaryAlgorithm.isEmpty() && !algorithms.contains(primaryAlgorithm)) {
+         algorithms.append(primaryAlgorithm);
+      }
+      // Paths in the list are relative to the source directory, in the file relative to the file.
+      QString fullpath = sourcedir.filePath(QDir::fromNativeSeparators(filelist->item(i, 0)->text()));
+      fullpath = QDir::toNativeSeparators(outdir.relativeFilePath(fullpath));
+      if (fullpath.indexOf(" ") != -1) {
+         fullpath.prepend("\"").append("\"");
+      }
+      paths.append(fullpath);
+   }
+   for (int i=0; i < filelist->rowCount(); i++) {
+      foreach (QString algorithm, filelist->getHashes(i).keys()) {
+         if (!algorithms.contains(algorithm)) {
+            algorithms.append(algorithm);
+         }
+      }
+   }
+   if (algorithms.isEmpty()) {
+      algorithms.append(getSettings().algorithms.value(0, "CRC32"));
+   }
 
    QTextStream out(&file);
    out << "; Generated by HashMan ver. " << QString(__DATE__).replace(" ", "-") << "-" << __TIME__ << " on ";
@@ -192,31 +232,29 @@ bool HashProject::saveFile(QString filename)
    QDateTime datetime = QDateTime::currentDateTime();
    out << datetime.date().year() << "-" << datetime.date().month() << "-" << datetime.date().day() << " ";
    out << datetime.time().hour() << ":" << datetime.time().minute() << "." << datetime.time().second() << linebreak;
-   out << "; ---------------" << linebreak;
-   out << "; " << algorithmSettingName << currAlgorithm << linebreak;
-   out << "; ---------------" << linebreak;
 
    for (int i=0; i < filelist->rowCount(); i++) {
-      if (filelist->item(i, 6) && currAlgorithm != filelist->item(i, 6)->text()) {
-         currAlgorithm = filelist->item(i, 6)->text();
-         out << "; " << algorithmSettingName << currAlgorithm << linebreak;
-      }
-      QString fullpath = filelist->item(i, 0)->text() + filelist->item(i, 1)->text();
-      if (fullpath.indexOf(outpath) == 0) {
-         fullpath.remove(0, outpath.length() + 1);
-      }
-      if (fullpath.indexOf(" ") != -1) {
-         fullpath.prepend("\"").append("\"");
+      QString filesize = filelist->item(i, 1)->text();
+      if (!filesize.isEmpty()) {
+         out << "; " << filesize.rightJustified(12) << QString().leftJustified(22) << paths.at(i) << linebreak;
       }
-      if (filelist->item(i, 2) && !filelist->item(i, 2)->text().isEmpty()) {
-         out << "; " << filelist->item(i, 2)->text().rightJustified(12) << QString().leftJustified(22) << fullpath << linebreak;
-      }
-      out << fullpath;
-      if (filelist->item(i, 3)) {
-         // Hash
-         out << " " << filelist->item(i, 3)->text();
+   }
+
+   foreach (QString algorithm, algorithms) {
+      out << "; ---------------" << linebreak;
+      out << "; " << algorithmSettingName << algorithm << linebreak;
+      out << "; ---------------" << linebreak;
+      for (int i=0; i < filelist->rowCount(); i++) {
+         HashDigest hash = filelist->getHashes(i).value(algorithm);
+         if (hash.isEmpty() && algorithm != algorithms.first()) {
+            continue;
+         }
+         out << paths.at(i);
+         if (!hash.isEmpty()) {
+            out << " " << hash.toHex();
+         }
+         out << linebreak;
       }
-      out << linebreak;
    }
    file.close();
    return true;
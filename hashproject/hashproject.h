@@ -2,6 +2,12 @@
 #define HASHPROJECT_H
 
 #include <QObject>
+#include <QMap>
+#include <QStringList>
+
+#include "algorithms/hashdigest.h"
+#include "workers/filehints.h"
+#include "workers/filereader.h"
 
 class FileList;
 
@@ -14,15 +20,43 @@ public:
 
    struct File {
       QString filename;
-      qint64 filesize;
-      QString hash;
+      qint64 filesize = -1;
+      // The primary algorithm, displayed in the file list.
       QString algorithm;
+      // All calculated hash sums, keyed by algorithm name.
+      QMap<QString, HashDigest> hashes;
+      // Why the hash sums couldn't be calculated, displayed instead of them.
+      QString error;
    };
 
    struct Settings {
-      QString algorithm;
+      // The algorithms to calculate in a single read of each file.
+      // The first one is the primary algorithm.
+      QStringList algorithms;
       bool scanimmediately;
       bool blockinghashcalc;
+      // Emit the found files sorted by path once the scan is done, instead of as they're found.
+      bool sortedscan;
+      // Feed the data to the different algorithms on separate cores.
+      bool paralleldigests;
+      // Hash ranges of large files on separate cores, for algorithms that support it.
+      bool splitlargefiles;
+      // Read the files with read() calls, from memory mappings or past the page cache.
+      FileReader::Mode readmode;
+      // Number of blocks read ahead across files while hashing, 1 reads one file at a time.
+      int queuedepth;
+      // Read the files of different devices in parallel, each within the limits of its own device.
+      bool devicescheduling;
+      // Hash the files in the order they're stored on their devices, instead of the order they were found in.
+      bool physicalorder;
+      // A combination of FileHints::Hint.
+      int filehints;
+      // Reuse the hash sums of unchanged files from the HashCache, and add new ones to it.
+      bool hashcache;
+      // Reuse and store the hash sums in extended attributes of the files.
+      bool hashattributes;
+      // Read the files when verifying, even if their attributes have hash sums.
+      bool forceverifyreads;
    };
 
    explicit HashProject(QObject *parent = 0);
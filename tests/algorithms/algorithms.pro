@@ -0,0 +1,44 @@
+# Known-answer tests of the hashing algorithms, run with "make check".
+
+QT += testlib \
+    core \
+    concurrent
+QT -= gui
+
+CONFIG += c++17 \
+    console \
+    testcase
+CONFIG -= app_bundle
+
+TARGET = tst_algorithms
+
+INCLUDEPATH += ../..
+
+HEADERS = ../../algorithms/algorithmregistry.h \
+    ../../algorithms/blocksource.h \
+    ../../algorithms/crc32algorithm.h \
+    ../../algorithms/crc32calgorithm.h \
+    ../../algorithms/crctables.h \
+    ../../algorithms/crc32clmul.h \
+    ../../algorithms/cpufeatures.h \
+    ../../algorithms/hashalgorithm.h \
+    ../../algorithms/hashdigest.h \
+    ../../algorithms/qtcryptoalgorithms.h \
+    ../../algorithms/shanialgorithms.h \
+    ../../algorithms/multibufferhash.h \
+    ../../algorithms/lanevectors.h \
+    ../../algorithms/blake3algorithm.h \
+    ../../algorithms/xxh3algorithm.h
+
+SOURCES = tst_algorithms.cpp \
+    ../../algorithms/algorithmregistry.cpp \
+    ../../algorithms/crc32algorithm.cpp \
+    ../../algorithms/crc32calgorithm.cpp \
+    ../../algorithms/crc32clmul.cpp \
+    ../../algorithms/cpufeatures.cpp \
+    ../../algorithms/hashdigest.cpp \
+    ../../algorithms/qtcryptoalgorithms.cpp \
+    ../../algorithms/shanialgorithms.cpp \
+    ../../algorithms/multibufferhash.cpp \
+    ../../algorithms/blake3algorithm.cpp \
+    ../../algorithms/xxh3algorithm.cpp
@@ -0,0 +1,602 @@
+/**
+ * Known-answer tests of the hashing algorithms.
+ *
+ * The expected hash sums were calculated with implementations independent of
+ * HashMan, like zlib, Python's hashlib and the reference implementations of
+ * BLAKE3 and XXH3. The message of length n is the bytes 0, 1, ..., 250, 0, 1, ...
+ * up to n bytes, so no two messages share their last block.
+ *
+ * The fastest implementations supported by the processor are selected when the
+ * program starts, see CpuFeatures. To test the portable implementations as well,
+ * all tests are run a second time in a process started with HASHMAN_PORTABLE set.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include <QCoreApplication>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QScopedPointer>
+#include <QtTest>
+
+#include "algorithms/algorithmregistry.h"
+#include "algorithms/crc32algorithm.h"
+#include "algorithms/crc32calgorithm.h"
+#include "algorithms/multibufferhash.h"
+
+namespace {
+
+// Messages around the block boundaries that finish at different times in the lanes.
+const qint64 multiBufferLengths[] = {0, 1, 3, 55, 56, 63, 64, 65, 119, 120, 127, 128, 129, 1000, 4097, 65535};
+const int multiBufferMessages = sizeof(multiBufferLengths) / sizeof(multiBufferLengths[0]);
+
+QByteArray message(qint64 length)
+{
+   QByteArray data(static_cast<int>(length), Qt::Uninitialized);
+   for (int i = 0; i < data.size(); i++) {
+      data[i] = static_cast<char>(i % 251);
+   }
+   return data;
+}
+
+QString toHex(quint32 crc)
+{
+   return QString("%1").arg(crc, 8, 16, QChar('0'));
+}
+
+QString toHex(const HashDigest& digest)
+{
+   return digest.toHex().toLower();
+}
+
+/**
+ * Checks that the algorithm returns the expected hash sum of data, whether the data
+ * is hashed at once, from an unaligned address or fed to a context in blocks of
+ * lengths that don't match the block length of the algorithm.
+ */
+void checkHash(QString name, const QByteArray& data, QString expected)
+{
+   const AlgorithmRegistry::Algorithm* algorithm = AlgorithmRegistry::get().find(name);
+   QVERIFY(algorithm);
+   QCOMPARE(toHex(algorithm->hashData(data.constData(), data.size())), expected);
+
+   QByteArray unaligned = QByteArray(3, 0) + data;
+   QCOMPARE(toHex(algorithm->hashData(unaligned.constData() + 3, data.size())), expected);
+
+   for (int blockLength : {1, 7, 1000, 65537}) {
+      if (blockLength == 1 && data.size() > 65536) {
+         continue;
+      }
+      QScopedPointer<HashAlgorithm::Context> context(algorithm->createContext());
+      for (int i = 0; i < data.size(); i += blockLength) {
+         context->update(data.constData() + i, qMin(blockLength, data.size() - i));
+      }
+      QCOMPARE(toHex(context->finalize()), expected);
+   }
+}
+
+}
+
+class TestAlgorithms : public QObject
+{
+   Q_OBJECT
+
+private slots:
+   void crc32CheckValue();
+   void crc32_data();
+   void crc32();
+   void crc32cCheckValue();
+   void crc32c_data();
+   void crc32c();
+   void combine_data();
+   void combine();
+   void zeros_data();
+   void zeros();
+   void sha_data();
+   void sha();
+   void multiBuffer_data();
+   void multiBuffer();
+   void blake3_data();
+   void blake3();
+   void xxh3_data();
+   void xxh3();
+};
+
+/**
+ * @brief TestAlgorithms::crc32CheckValue The check value from the catalogue of CRC algorithms.
+ */
+void TestAlgorithms::crc32CheckValue()
+{
+   const uchar* check = reinterpret_cast<const uchar*>("123456789");
+   QCOMPARE(toHex(Crc32algorithm::calculatePortable(0, check, 9)), QString("cbf43926"));
+   QCOMPARE(toHex(Crc32algorithm::calculate(0, check, 9)), QString("cbf43926"));
+}
+
+/**
+ * @brief TestAlgorithms::crc32_data Lengths around the 16 byte slices and the 64 byte folds.
+ */
+void TestAlgorithms::crc32_data()
+{
+   QTest::addColumn<qint64>("length");
+   QTest::addColumn<QString>("expected");
+
+   QTest::newRow("0") << Q_INT64_C(0) << "00000000";
+   QTest::newRow("1") << Q_INT64_C(1) << "d202ef8d";
+   QTest::newRow("3") << Q_INT64_C(3) << "0854897f";
+   QTest::newRow("7") << Q_INT64_C(7) << "ad5809f9";
+   QTest::newRow("8") << Q_INT64_C(8) << "88aa689f";
+   QTest::newRow("15") << Q_INT64_C(15) << "a06c675e";
+   QTest::newRow("16") << Q_INT64_C(16) << "cecee288";
+   QTest::newRow("17") << Q_INT64_C(17) << "2c183a19";
+   QTest::newRow("31") << Q_INT64_C(31) << "4d786d77";
+   QTest::newRow("32") << Q_INT64_C(32) << "91267e8a";
+   QTest::newRow("63") << Q_INT64_C(63) << "dbdea683";
+   QTest::newRow("64") << Q_INT64_C(64) << "100ece8c";
+   QTest::newRow("65") << Q_INT64_C(65) << "40c06fd8";
+   QTest::newRow("127") << Q_INT64_C(127) << "dec481aa";
+   QTest::newRow("128") << Q_INT64_C(128) << "24650d57";
+   QTest::newRow("129") << Q_INT64_C(129) << "ca91cdf7";
+   QTest::newRow("255") << Q_INT64_C(255) << "6f7c9956";
+   QTest::newRow("256") << Q_INT64_C(256) << "5708a3cc";
+   QTest::newRow("257") << Q_INT64_C(257) << "30ed9d3a";
+   QTest::newRow("1000") << Q_INT64_C(1000) << "721746a6";
+   QTest::newRow("4095") << Q_INT64_C(4095) << "d1a3950a";
+   QTest::newRow("4096") << Q_INT64_C(4096) << "d465f907";
+   QTest::newRow("4097") << Q_INT64_C(4097) << "27d94e23";
+   QTest::newRow("65537") << Q_INT64_C(65537) << "a9cc6e73";
+   QTest::newRow("1048579") << Q_INT64_C(1048579) << "a4194851";
+}
+
+/**
+ * @brief TestAlgorithms::crc32 Compares the portable and the selected implementation.
+ */
+void TestAlgorithms::crc32()
+{
+   QFETCH(qint64, length);
+   QFETCH(QString, expected);
+
+   QByteArray data = message(length);
+   const uchar* bytes = reinterpret_cast<const uchar*>(data.constData());
+   QCOMPARE(toHex(Crc32algorithm::calculatePortable(0, bytes, length)), expected);
+   QCOMPARE(toHex(Crc32algorithm::calculate(0, bytes, length)), expected);
+
+   // Continuing from a CRC32 must give the same result as calculating it at once.
+   quint32 crc = Crc32algorithm::calculate(0, bytes, length / 3);
+   QCOMPARE(toHex(Crc32algorithm::calculate(crc, bytes + length / 3, length - length / 3)), expected);
+
+   checkHash("CRC32", data, expected);
+}
+
+/**
+ * @brief TestAlgorithms::crc32cCheckValue The check value from the catalogue of CRC algorithms.
+ */
+void TestAlgorithms::crc32cCheckValue()
+{
+   const uchar* check = reinterpret_cast<const uchar*>("123456789");
+   QCOMPARE(toHex(Crc32calgorithm::calculatePortable(0, check, 9)), QString("e3069283"));
+   QCOMPARE(toHex(Crc32calgorithm::calculate(0, check, 9)), QString("e3069283"));
+}
+
+/**
+ * @brief TestAlgorithms::crc32c_data Lengths around the 8 byte words and the 256 byte short streams.
+ */
+void TestAlgorithms::crc32c_data()
+{
+   QTest::addColumn<qint64>("length");
+   QTest::addColumn<QString>("expected");
+
+   QTest::newRow("0") << Q_INT64_C(0) << "00000000";
+   QTest::newRow("1") << Q_INT64_C(1) << "527d5351";
+   QTest::newRow("3") << Q_INT64_C(3) << "92fd4bfa";
+   QTest::newRow("7") << Q_INT64_C(7) << "a359ed4c";
+   QTest::newRow("8") << Q_INT64_C(8) << "8a2cbc3b";
+   QTest::newRow("15") << Q_INT64_C(15) << "68ef03f6";
+   QTest::newRow("16") << Q_INT64_C(16) << "d9c908eb";
+   QTest::newRow("17") << Q_INT64_C(17) << "38435e17";
+   QTest::newRow("31") << Q_INT64_C(31) << "e95cabcb";
+   QTest::newRow("32") << Q_INT64_C(32) << "46dd794e";
+   QTest::newRow("63") << Q_INT64_C(63) << "7a873004";
+   QTest::newRow("64") << Q_INT64_C(64) << "fb6d36eb";
+   QTest::newRow("65") << Q_INT64_C(65) << "694420fa";
+   QTest::newRow("127") << Q_INT64_C(127) << "6c31bd0c";
+   QTest::newRow("128") << Q_INT64_C(128) << "30d9c515";
+   QTest::newRow("129") << Q_INT64_C(129) << "f514629f";
+   QTest::newRow("255") << Q_INT64_C(255) << "ebbd63b3";
+   QTest::newRow("256") << Q_INT64_C(256) << "3449f810";
+   QTest::newRow("257") << Q_INT64_C(257) << "77e6c9da";
+   QTest::newRow("1000") << Q_INT64_C(1000) << "11f66220";
+   QTest::newRow("4095") << Q_INT64_C(4095) << "5e9ee87c";
+   QTest::newRow("4096") << Q_INT64_C(4096) << "719077fc";
+   QTest::newRow("4097") << Q_INT64_C(4097) << "bd04b950";
+   QTest::newRow("65537") << Q_INT64_C(65537) << "4537bb82";
+   QTest::newRow("1048579") << Q_INT64_C(1048579) << "248c3f12";
+}
+
+/**
+ * @brief TestAlgorithms::crc32c Compares the portable and the selected implementation.
+ */
+void TestAlgorithms::crc32c()
+{
+   QFETCH(qint64, length);
+   QFETCH(QString, expected);
+
+   QByteArray data = message(length);
+   const uchar* bytes = reinterpret_cast<const uchar*>(data.constData());
+   QCOMPARE(toHex(Crc32calgorithm::calculatePortable(0, bytes, length)), expected);
+   QCOMPARE(toHex(Crc32calgorithm::calculate(0, bytes, length)), expected);
+
+   // Continuing from a CRC32C must give the same result as calculating it at once.
+   quint32 crc = Crc32calgorithm::calculate(0, bytes, length / 3);
+   QCOMPARE(toHex(Crc32calgorithm::calculate(crc, bytes + length / 3, length - length / 3)), expected);
+
+   checkHash("CRC32C", data, expected);
+}
+
+/**
+ * @brief TestAlgorithms::combine_data Splits into parts of odd lengths, and into an empty part.
+ */
+void TestAlgorithms::combine_data()
+{
+   QTest::addColumn<QString>("algorithm");
+   QTest::addColumn<qint64>("length");
+   QTest::addColumn<qint64>("split");
+
+   QTest::newRow("CRC32 1000 at 1") << "CRC32" << Q_INT64_C(1000) << Q_INT64_C(1);
+   QTest::newRow("CRC32 1000 at 333") << "CRC32" << Q_INT64_C(1000) << Q_INT64_C(333);
+   QTest::newRow("CRC32 1000 at 999") << "CRC32" << Q_INT64_C(1000) << Q_INT64_C(999);
+   QTest::newRow("CRC32 1000 at 1000") << "CRC32" << Q_INT64_C(1000) << Q_INT64_C(1000);
+   QTest::newRow("CRC32 65537 at 4097") << "CRC32" << Q_INT64_C(65537) << Q_INT64_C(4097);
+   QTest::newRow("CRC32 1048579 at 524289") << "CRC32" << Q_INT64_C(1048579) << Q_INT64_C(524289);
+   QTest::newRow("CRC32 1048579 at 3") << "CRC32" << Q_INT64_C(1048579) << Q_INT64_C(3);
+
+   QTest::newRow("CRC32C 1000 at 1") << "CRC32C" << Q_INT64_C(1000) << Q_INT64_C(1);
+   QTest::newRow("CRC32C 1000 at 333") << "CRC32C" << Q_INT64_C(1000) << Q_INT64_C(333);
+   QTest::newRow("CRC32C 1000 at 999") << "CRC32C" << Q_INT64_C(1000) << Q_INT64_C(999);
+   QTest::newRow("CRC32C 1000 at 1000") << "CRC32C" << Q_INT64_C(1000) << Q_INT64_C(1000);
+   QTest::newRow("CRC32C 65537 at 4097") << "CRC32C" << Q_INT64_C(65537) << Q_INT64_C(4097);
+   QTest::newRow("CRC32C 1048579 at 524289") << "CRC32C" << Q_INT64_C(1048579) << Q_INT64_C(524289);
+   QTest::newRow("CRC32C 1048579 at 3") << "CRC32C" << Q_INT64_C(1048579) << Q_INT64_C(3);
+}
+
+/**
+ * @brief TestAlgorithms::combine Hashes the parts in separate contexts, like Hasher does with the ranges of large files.
+ */
+void TestAlgorithms::combine()
+{
+   QFETCH(QString, algorithm);
+   QFETCH(qint64, length);
+   QFETCH(qint64, split);
+
+   const AlgorithmRegistry::Algorithm* selected = AlgorithmRegistry::get().find(algorithm);
+   QVERIFY(selected && selected->combinable);
+   QByteArray data = message(length);
+   QScopedPointer<HashAlgorithm::Context> first(selected->createContext());
+   QScopedPointer<HashAlgorithm::Context> second(selected->createContext());
+   first->update(data.constData(), split);
+   second->update(data.constData() + split, length - split);
+   first->combine(second.data(), length - split);
+   QCOMPARE(toHex(first->finalize()), toHex(selected->hashData(data.constData(), length)));
+}
+
+/**
+ * @brief TestAlgorithms::zeros_data Five bytes of a message followed by zeros, up to past 4 GiB.
+ */
+void TestAlgorithms::zeros_data()
+{
+   QTest::addColumn<QString>("algorithm");
+   QTest::addColumn<qint64>("length");
+   QTest::addColumn<QString>("expected");
+
+   QTest::newRow("CRC32 1") << "CRC32" << Q_INT64_C(1) << "40813bc5";
+   QTest::newRow("CRC32 7") << "CRC32" << Q_INT64_C(7) << "0369fbad";
+   QTest::newRow("CRC32 65536") << "CRC32" << Q_INT64_C(65536) << "598d666c";
+   QTest::newRow("CRC32 65537") << "CRC32" << Q_INT64_C(65537) << "965f4f98";
+   QTest::newRow("CRC32 268435455") << "CRC32" << Q_INT64_C(268435455) << "bf4b926a";
+   QTest::newRow("CRC32 268435456") << "CRC32" << Q_INT64_C(268435456) << "7fda2c59";
+   QTest::newRow("CRC32 268435457") << "CRC32" << Q_INT64_C(268435457) << "c0cadcf1";
+   QTest::newRow("CRC32 536870912") << "CRC32" << Q_INT64_C(536870912) << "4515eac6";
+   QTest::newRow("CRC32 2147483651") << "CRC32" << Q_INT64_C(2147483651) << "546f1bfd";
+   QTest::newRow("CRC32 4294967303") << "CRC32" << Q_INT64_C(4294967303) << "7a665923";
+   QTest::newRow("CRC32 5368709127") << "CRC32" << Q_INT64_C(5368709127) << "de999648";
+
+   QTest::newRow("CRC32C 1") << "CRC32C" << Q_INT64_C(1) << "74f89108";
+   QTest::newRow("CRC32C 7") << "CRC32C" << Q_INT64_C(7) << "17e34d63";
+   QTest::newRow("CRC32C 65536") << "CRC32C" << Q_INT64_C(65536) << "45bc77bf";
+   QTest::newRow("CRC32C 65537") << "CRC32C" << Q_INT64_C(65537) << "be3ea1cb";
+   QTest::newRow("CRC32C 268435455") << "CRC32C" << Q_INT64_C(268435455) << "ec998d53";
+   QTest::newRow("CRC32C 268435456") << "CRC32C" << Q_INT64_C(268435456) << "10e4e3fb";
+   QTest::newRow("CRC32C 268435457") << "CRC32C" << Q_INT64_C(268435457) << "388a73fc";
+   QTest::newRow("CRC32C 536870912") << "CRC32C" << Q_INT64_C(536870912) << "887271fd";
+   QTest::newRow("CRC32C 2147483651") << "CRC32C" << Q_INT64_C(2147483651) << "f626397e";
+   QTest::newRow("CRC32C 4294967303") << "CRC32C" << Q_INT64_C(4294967303) << "bb49bcc1";
+   QTest::newRow("CRC32C 5368709127") << "CRC32C" << Q_INT64_C(5368709127) << "188433d6";
+}
+
+/**
+ * @brief TestAlgorithms::zeros The holes of sparse files, calculated without hashing the zeros.
+ */
+void TestAlgorithms::zeros()
+{
+   QFETCH(QString, algorithm);
+   QFETCH(qint64, length);
+   QFETCH(QString, expected);
+
+   const AlgorithmRegistry::Algorithm* selected = AlgorithmRegistry::get().find(algorithm);
+   QVERIFY(selected && selected->combinable);
+   QByteArray data = message(5);
+   QScopedPointer<HashAlgorithm::Context> context(selected->createContext());
+   context->update(data.constData(), data.size());
+   context->updateZeros(length);
+   QCOMPARE(toHex(context->finalize()), expected);
+
+   // The same zeros in a range of their own.
+   QScopedPointer<HashAlgorithm::Context> first(selected->createContext());
+   QScopedPointer<HashAlgorithm::Context> zeros(selected->createContext());
+   first->update(data.constData(), data.size());
+   zeros->updateZeros(length);
+   first->combine(zeros.data(), length);
+   QCOMPARE(toHex(first->finalize()), expected);
+}
+
+/**
+ * @brief TestAlgorithms::sha_data Lengths around the 64 byte blocks and the padding that follows the data.
+ */
+void TestAlgorithms::sha_data()
+{
+   QTest::addColumn<QString>("algorithm");
+   QTest::addColumn<qint64>("length");
+   QTest::addColumn<QString>("expected");
+
+   QTest::newRow("SHA-1 0") << "SHA-1" << Q_INT64_C(0) << "da39a3ee5e6b4b0d3255bfef95601890afd80709";
+   QTest::newRow("SHA-1 1") << "SHA-1" << Q_INT64_C(1) << "5ba93c9db0cff93f52b521d7420e43f6eda2784f";
+   QTest::newRow("SHA-1 3") << "SHA-1" << Q_INT64_C(3) << "0c7a623fd2bbc05b06423be359e4021d36e721ad";
+   QTest::newRow("SHA-1 55") << "SHA-1" << Q_INT64_C(55) << "8ae2d46729cfe68ff927af5eec9c7d1b66d65ac2";
+   QTest::newRow("SHA-1 56") << "SHA-1" << Q_INT64_C(56) << "636e2ec698dac903498e648bd2f3af641d3c88cb";
+   QTest::newRow("SHA-1 63") << "SHA-1" << Q_INT64_C(63) << "6d942da0c4392b123528f2905c713a3ce28364bd";
+   QTest::newRow("SHA-1 64") << "SHA-1" << Q_INT64_C(64) << "c6138d514ffa2135bfce0ed0b8fac65669917ec7";
+   QTest::newRow("SHA-1 65") << "SHA-1" << Q_INT64_C(65) << "69bd728ad6e13cd76ff19751fde427b00e395746";
+   QTest::newRow("SHA-1 119") << "SHA-1" << Q_INT64_C(119) << "41c89d06001bab4ab78736b44efe7ce18ce6ae08";
+   QTest::newRow("SHA-1 120") << "SHA-1" << Q_INT64_C(120) << "d3dbd653bd8597b7475321b60a36891278e6a04a";
+   QTest::newRow("SHA-1 127") << "SHA-1" << Q_INT64_C(127) << "89d7312a903f65cd2b3e34a975e55dbea9033353";
+   QTest::newRow("SHA-1 128") << "SHA-1" << Q_INT64_C(128) << "e6434bc401f98603d7eda504790c98c67385d535";
+   QTest::newRow("SHA-1 129") << "SHA-1" << Q_INT64_C(129) << "3352e41cc30b40ae80108970492b21014049e625";
+   QTest::newRow("SHA-1 1000") << "SHA-1" << Q_INT64_C(1000) << "c9c960a0b925474fab83942cc27d504fc24ac37b";
+   QTest::newRow("SHA-1 65537") << "SHA-1" << Q_INT64_C(65537) << "74c69f8e2c886f87f68d52d16c30e9b4790513c9";
+   QTest::newRow("SHA-1 1048577") << "SHA-1" << Q_INT64_C(1048577) << "ffbc30b06f6bd51da52f9640804c9d0c4f6e2af2";
+
+   QTest::newRow("SHA-256 0") << "SHA-256" << Q_INT64_C(0) << "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+   QTest::newRow("SHA-256 1") << "SHA-256" << Q_INT64_C(1) << "6e340b9cffb37a989ca544e6bb780a2c78901d3fb33738768511a30617afa01d";
+   QTest::newRow("SHA-256 3") << "SHA-256" << Q_INT64_C(3) << "ae4b3280e56e2faf83f414a6e3dabe9d5fbe18976544c05fed121accb85b53fc";
+   QTest::newRow("SHA-256 55") << "SHA-256" << Q_INT64_C(55) << "463eb28e72f82e0a96c0a4cc53690c571281131f672aa229e0d45ae59b598b59";
+   QTest::newRow("SHA-256 56") << "SHA-256" << Q_INT64_C(56) << "da2ae4d6b36748f2a318f23e7ab1dfdf45acdc9d049bd80e59de82a60895f562";
+   QTest::newRow("SHA-256 63") << "SHA-256" << Q_INT64_C(63) << "29af2686fd53374a36b0846694cc342177e428d1647515f078784d69cdb9e488";
+   QTest::newRow("SHA-256 64") << "SHA-256" << Q_INT64_C(64) << "fdeab9acf3710362bd2658cdc9a29e8f9c757fcf9811603a8c447cd1d9151108";
+   QTest::newRow("SHA-256 65") << "SHA-256" << Q_INT64_C(65) << "4bfd2c8b6f1eec7a2afeb48b934ee4b2694182027e6d0fc075074f2fabb31781";
+   QTest::newRow("SHA-256 119") << "SHA-256" << Q_INT64_C(119) << "da18797ed7c3a777f0847f429724a2d8cd5138e6ed2895c3fa1a6d39d18f7ec6";
+   QTest::newRow("SHA-256 120") << "SHA-256" << Q_INT64_C(120) << "f52b23db1fbb6ded89ef42a23ce0c8922c45f25c50b568a93bf1c075420bbb7c";
+   QTest::newRow("SHA-256 127") << "SHA-256" << Q_INT64_C(127) << "92ca0fa6651ee2f97b884b7246a562fa71250fedefe5ebf270d31c546bfea976";
+   QTest::newRow("SHA-256 128") << "SHA-256" << Q_INT64_C(128) << "471fb943aa23c511f6f72f8d1652d9c880cfa392ad80503120547703e56a2be5";
+   QTest::newRow("SHA-256 129") << "SHA-256" << Q_INT64_C(129) << "5099c6a56203f9687f7d33f4bfdf576d31dc91f6b695ecea38b2770c87631135";
+   QTest::newRow("SHA-256 1000") << "SHA-256" << Q_INT64_C(1000) << "4e4c294b331f7a2099a379bec34b9f9fc03dc46ab465d998f4d683da53487e6d";
+   QTest::newRow("SHA-256 65537") << "SHA-256" << Q_INT64_C(65537) << "237356e18b503616912abb8ffaed3a72591e397d4ac294c4637917d48a3f529d";
+   QTest::newRow("SHA-256 1048577") << "SHA-256" << Q_INT64_C(1048577) << "5769f52bc3eef28afa39c6fc68cadb7d0bd69812ae3a3d71452f519ec3c7aa56";
+}
+
+/**
+ * @brief TestAlgorithms::sha SHA-NI when supported by the processor, otherwise QCryptographicHash.
+ */
+void TestAlgorithms::sha()
+{
+   QFETCH(QString, algorithm);
+   QFETCH(qint64, length);
+   QFETCH(QString, expected);
+
+   checkHash(algorithm, message(length), expected);
+}
+
+/**
+ * @brief TestAlgorithms::multiBuffer_data The expected hash sums of the messages in multiBufferLengths.
+ */
+void TestAlgorithms::multiBuffer_data()
+{
+   QTest::addColumn<int>("algorithm");
+   QTest::addColumn<QStringList>("expected");
+
+   QTest::newRow("MD5") << static_cast<int>(AlgorithmRegistry::Md5) << (QStringList()
+      << "d41d8cd98f00b204e9800998ecf8427e"
+      << "93b885adfe0da089cdf634904fd59f71"
+      << "b95f67f61ebb03619622d798f45fc2d3"
+      << "6912ee65fff2d9f9ce2508cddf8bcda0"
+      << "51fdd1acda72405dfdfa03fcb85896d7"
+      << "48a6295221902e8e0938f773a7185e72"
+      << "b2d3f56bc197fd985d5965079b5e7148"
+      << "8bd7053801c768420faf816fadba971c"
+      << "1c772251899a7ff007400b888d6b2042"
+      << "b7ba1efc6022e9ed272f00b8831e26e6"
+      << "8402b21e7bc7906493bae0dac017f1f9"
+      << "37eff01866ba3f538421b30b7cbefcac"
+      << "46f986692847558fc38b0cece591c20f"
+      << "a24f1e3ef66950e1327f210e3997ba2c"
+      << "e4df5b23488e51a7998f218196a6ef6d"
+      << "89378be93d51bbd3a9aa65e920103692");
+   QTest::newRow("SHA-256") << static_cast<int>(AlgorithmRegistry::Sha256) << (QStringList()
+      << "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"
+      << "6e340b9cffb37a989ca544e6bb780a2c78901d3fb33738768511a30617afa01d"
+      << "ae4b3280e56e2faf83f414a6e3dabe9d5fbe18976544c05fed121accb85b53fc"
+      << "463eb28e72f82e0a96c0a4cc53690c571281131f672aa229e0d45ae59b598b59"
+      << "da2ae4d6b36748f2a318f23e7ab1dfdf45acdc9d049bd80e59de82a60895f562"
+      << "29af2686fd53374a36b0846694cc342177e428d1647515f078784d69cdb9e488"
+      << "fdeab9acf3710362bd2658cdc9a29e8f9c757fcf9811603a8c447cd1d9151108"
+      << "4bfd2c8b6f1eec7a2afeb48b934ee4b2694182027e6d0fc075074f2fabb31781"
+      << "da18797ed7c3a777f0847f429724a2d8cd5138e6ed2895c3fa1a6d39d18f7ec6"
+      << "f52b23db1fbb6ded89ef42a23ce0c8922c45f25c50b568a93bf1c075420bbb7c"
+      << "92ca0fa6651ee2f97b884b7246a562fa71250fedefe5ebf270d31c546bfea976"
+      << "471fb943aa23c511f6f72f8d1652d9c880cfa392ad80503120547703e56a2be5"
+      << "5099c6a56203f9687f7d33f4bfdf576d31dc91f6b695ecea38b2770c87631135"
+      << "4e4c294b331f7a2099a379bec34b9f9fc03dc46ab465d998f4d683da53487e6d"
+      << "a16560d668b843fb3be99ace41dbd18471f342bd3255a1d21204b35e43f74436"
+      << "dda402a2c028f0cbbdbc5c6ebae965eed9c75f71236e7022b0386d3455d5ae2f");
+}
+
+/**
+ * @brief TestAlgorithms::multiBuffer Hashes more messages than there are lanes, so lanes are refilled while others are busy.
+ */
+void TestAlgorithms::multiBuffer()
+{
+   QFETCH(int, algorithm);
+   QFETCH(QStringList, expected);
+
+   // Hasher only uses the lanes when they're faster, but they work whenever the processor has them.
+   if (MultiBufferHash::lanes() == 0) {
+      QSKIP("The processor can't hash several messages at once.");
+   }
+   // Every message twice, the second time in reverse order.
+   QList<QByteArray> messages;
+   for (int i = 0; i < 2 * multiBufferMessages; i++) {
+      int index = i < multiBufferMessages ? i : 2 * multiBufferMessages - 1 - i;
+      messages.append(message(multiBufferLengths[index]));
+   }
+   QList<HashDigest> digests = MultiBufferHash::calculate(static_cast<AlgorithmRegistry::Id>(algorithm), messages);
+   QCOMPARE(digests.size(), messages.size());
+   for (int i = 0; i < digests.size(); i++) {
+      int index = i < multiBufferMessages ? i : 2 * multiBufferMessages - 1 - i;
+      QCOMPARE(toHex(digests.at(i)), expected.at(index));
+   }
+}
+
+/**
+ * @brief TestAlgorithms::blake3_data The lengths of the official test vectors, and longer ones split into subtrees.
+ */
+void TestAlgorithms::blake3_data()
+{
+   QTest::addColumn<qint64>("length");
+   QTest::addColumn<QString>("expected");
+
+   QTest::newRow("0") << Q_INT64_C(0) << "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262";
+   QTest::newRow("1") << Q_INT64_C(1) << "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213";
+   QTest::newRow("1023") << Q_INT64_C(1023) << "10108970eeda3eb932baac1428c7a2163b0e924c9a9e25b35bba72b28f70bd11";
+   QTest::newRow("1024") << Q_INT64_C(1024) << "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7";
+   QTest::newRow("1025") << Q_INT64_C(1025) << "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444";
+   QTest::newRow("2048") << Q_INT64_C(2048) << "e776b6028c7cd22a4d0ba182a8bf62205d2ef576467e838ed6f2529b85fba24a";
+   QTest::newRow("2049") << Q_INT64_C(2049) << "5f4d72f40d7a5f82b15ca2b2e44b1de3c2ef86c426c95c1af0b6879522563030";
+   QTest::newRow("3072") << Q_INT64_C(3072) << "b98cb0ff3623be03326b373de6b9095218513e64f1ee2edd2525c7ad1e5cffd2";
+   QTest::newRow("3073") << Q_INT64_C(3073) << "7124b49501012f81cc7f11ca069ec9226cecb8a2c850cfe644e327d22d3e1cd3";
+   QTest::newRow("4096") << Q_INT64_C(4096) << "015094013f57a5277b59d8475c0501042c0b642e531b0a1c8f58d2163229e969";
+   QTest::newRow("4097") << Q_INT64_C(4097) << "9b4052b38f1c5fc8b1f9ff7ac7b27cd242487b3d890d15c96a1c25b8aa0fb995";
+   QTest::newRow("5120") << Q_INT64_C(5120) << "9cadc15fed8b5d854562b26a9536d9707cadeda9b143978f319ab34230535833";
+   QTest::newRow("5121") << Q_INT64_C(5121) << "628bd2cb2004694adaab7bbd778a25df25c47b9d4155a55f8fbd79f2fe154cff";
+   QTest::newRow("6144") << Q_INT64_C(6144) << "3e2e5b74e048f3add6d21faab3f83aa44d3b2278afb83b80b3c35164ebeca205";
+   QTest::newRow("6145") << Q_INT64_C(6145) << "f1323a8631446cc50536a9f705ee5cb619424d46887f3c376c695b70e0f0507f";
+   QTest::newRow("7168") << Q_INT64_C(7168) << "61da957ec2499a95d6b8023e2b0e604ec7f6b50e80a9678b89d2628e99ada77a";
+   QTest::newRow("7169") << Q_INT64_C(7169) << "a003fc7a51754a9b3c7fae0367ab3d782dccf28855a03d435f8cfe74605e7817";
+   QTest::newRow("8192") << Q_INT64_C(8192) << "aae792484c8efe4f19e2ca7d371d8c467ffb10748d8a5a1ae579948f718a2a63";
+   QTest::newRow("8193") << Q_INT64_C(8193) << "bab6c09cb8ce8cf459261398d2e7aef35700bf488116ceb94a36d0f5f1b7bc3b";
+   QTest::newRow("16384") << Q_INT64_C(16384) << "f875d6646de28985646f34ee13be9a576fd515f76b5b0a26bb324735041ddde4";
+   QTest::newRow("31744") << Q_INT64_C(31744) << "62b6960e1a44bcc1eb1a611a8d6235b6b4b78f32e7abc4fb4c6cdcce94895c47";
+   QTest::newRow("102400") << Q_INT64_C(102400) << "bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085";
+   QTest::newRow("131072") << Q_INT64_C(131072) << "306baba93b1a393cbd35172837c98b0f59a41f64e1b2682ae102d8b2534b9e1c";
+   QTest::newRow("1048576") << Q_INT64_C(1048576) << "74cb441fd087764ca9c3694da742ebe30cbeb3060a17009ca81825c7a8d10343";
+   QTest::newRow("1049601") << Q_INT64_C(1049601) << "860f19b5fefff01454de342be87a20059449529116a20fb22a21da665aafa071";
+   QTest::newRow("3150728") << Q_INT64_C(3150728) << "f7fae2f336c67474fef536de6cb79bb35807f71f5f1c7273163b922727b34aa3";
+}
+
+/**
+ * @brief TestAlgorithms::blake3 From 128 KiB hashed at once, the subtrees are hashed in parallel.
+ */
+void TestAlgorithms::blake3()
+{
+   QFETCH(qint64, length);
+   QFETCH(QString, expected);
+
+   checkHash("BLAKE3", message(length), expected);
+}
+
+/**
+ * @brief TestAlgorithms::xxh3_data Lengths at the limits of the short inputs, the stripes and the 1 KiB blocks.
+ */
+void TestAlgorithms::xxh3_data()
+{
+   QTest::addColumn<QString>("algorithm");
+   QTest::addColumn<qint64>("length");
+   QTest::addColumn<QString>("expected");
+
+   QTest::newRow("XXH3-64 0") << "XXH3-64" << Q_INT64_C(0) << "2d06800538d394c2";
+   QTest::newRow("XXH3-64 1") << "XXH3-64" << Q_INT64_C(1) << "c44bdff4074eecdb";
+   QTest::newRow("XXH3-64 3") << "XXH3-64" << Q_INT64_C(3) << "5f4299fc161c9cbb";
+   QTest::newRow("XXH3-64 4") << "XXH3-64" << Q_INT64_C(4) << "60dab036a58211f2";
+   QTest::newRow("XXH3-64 8") << "XXH3-64" << Q_INT64_C(8) << "3a1c2d7c85af88f8";
+   QTest::newRow("XXH3-64 9") << "XXH3-64" << Q_INT64_C(9) << "e9612598145bb9dc";
+   QTest::newRow("XXH3-64 16") << "XXH3-64" << Q_INT64_C(16) << "8355e3a6f61770db";
+   QTest::newRow("XXH3-64 17") << "XXH3-64" << Q_INT64_C(17) << "9ef341a99de37328";
+   QTest::newRow("XXH3-64 128") << "XXH3-64" << Q_INT64_C(128) << "85c6174c7ff4c46b";
+   QTest::newRow("XXH3-64 129") << "XXH3-64" << Q_INT64_C(129) << "ec7642b431ba3e5a";
+   QTest::newRow("XXH3-64 240") << "XXH3-64" << Q_INT64_C(240) << "375a384d957fe865";
+   QTest::newRow("XXH3-64 241") << "XXH3-64" << Q_INT64_C(241) << "02e8cd95421c6d02";
+   QTest::newRow("XXH3-64 1023") << "XXH3-64" << Q_INT64_C(1023) << "d3d91d80ac495685";
+   QTest::newRow("XXH3-64 1024") << "XXH3-64" << Q_INT64_C(1024) << "e5d78bafa45b2aa5";
+   QTest::newRow("XXH3-64 1025") << "XXH3-64" << Q_INT64_C(1025) << "e95c42288f28186e";
+   QTest::newRow("XXH3-64 2048") << "XXH3-64" << Q_INT64_C(2048) << "25339063db861586";
+   QTest::newRow("XXH3-64 4096") << "XXH3-64" << Q_INT64_C(4096) << "7135ffa504f1bc71";
+   QTest::newRow("XXH3-64 100000") << "XXH3-64" << Q_INT64_C(100000) << "42c23aeead96750d";
+   QTest::newRow("XXH3-64 1048576") << "XXH3-64" << Q_INT64_C(1048576) << "6e0d7ac36b8c10ff";
+
+   QTest::newRow("XXH128 0") << "XXH128" << Q_INT64_C(0) << "99aa06d3014798d86001c324468d497f";
+   QTest::newRow("XXH128 1") << "XXH128" << Q_INT64_C(1) << "a6cd5e9392000f6ac44bdff4074eecdb";
+   QTest::newRow("XXH128 3") << "XXH128" << Q_INT64_C(3) << "e3b55f57945a17cf5f4299fc161c9cbb";
+   QTest::newRow("XXH128 4") << "XXH128" << Q_INT64_C(4) << "eb70bf5fc779e9e6a6111d53e80a3db5";
+   QTest::newRow("XXH128 8") << "XXH128" << Q_INT64_C(8) << "e1e4432a62217fe4cfd50c61c8bb98c1";
+   QTest::newRow("XXH128 9") << "XXH128" << Q_INT64_C(9) << "16c769d83e4aebce907931979dca3746";
+   QTest::newRow("XXH128 16") << "XXH128" << Q_INT64_C(16) << "72950631827607e2842812cc870dcae2";
+   QTest::newRow("XXH128 17") << "XXH128" << Q_INT64_C(17) << "685bc458b37d057fc06e233df7729217";
+   QTest::newRow("XXH128 128") << "XXH128" << Q_INT64_C(128) << "14792fc3af88dc6c05321a0b64d67b41";
+   QTest::newRow("XXH128 129") << "XXH128" << Q_INT64_C(129) << "dd5e74ac6b45f54ebc30b63382b09a3b";
+   QTest::newRow("XXH128 240") << "XXH128" << Q_INT64_C(240) << "65b5be86da5540e7c92b68e16f83bbb6";
+   QTest::newRow("XXH128 241") << "XXH128" << Q_INT64_C(241) << "1da1cb61bcb8a2a102e8cd95421c6d02";
+   QTest::newRow("XXH128 1023") << "XXH128" << Q_INT64_C(1023) << "4325711b0ed4d742d3d91d80ac495685";
+   QTest::newRow("XXH128 1024") << "XXH128" << Q_INT64_C(1024) << "d0ac1f7b93bf57b9e5d78bafa45b2aa5";
+   QTest::newRow("XXH128 1025") << "XXH128" << Q_INT64_C(1025) << "2882ebca04ec915ce95c42288f28186e";
+   QTest::newRow("XXH128 2048") << "XXH128" << Q_INT64_C(2048) << "a5141efedfefc1af25339063db861586";
+   QTest::newRow("XXH128 4096") << "XXH128" << Q_INT64_C(4096) << "e12cd72144990fe57135ffa504f1bc71";
+   QTest::newRow("XXH128 100000") << "XXH128" << Q_INT64_C(100000) << "54182c58bbb1337c42c23aeead96750d";
+   QTest::newRow("XXH128 1048576") << "XXH128" << Q_INT64_C(1048576) << "53738d98098cabba6e0d7ac36b8c10ff";
+}
+
+/**
+ * @brief TestAlgorithms::xxh3 The 128 bit hash sums are in the canonical form, the high half first.
+ */
+void TestAlgorithms::xxh3()
+{
+   QFETCH(QString, algorithm);
+   QFETCH(qint64, length);
+   QFETCH(QString, expected);
+
+   checkHash(algorithm, message(length), expected);
+}
+
+/**
+ * Runs the tests, and then runs them again in a process using the portable
+ * implementations, unless this already is that process.
+ */
+int main(int argc, char* argv[])
+{
+   QCoreApplication application(argc, argv);
+   TestAlgorithms test;
+   int result = QTest::qExec(&test, argc, argv);
+   if (qEnvironmentVariableIsSet("HASHMAN_PORTABLE")) {
+      return result;
+   }
+
+   QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+   environment.insert("HASHMAN_PORTABLE", "1");
+   QProcess portable;
+   portable.setProcessEnvironment(environment);
+   portable.setProcessChannelMode(QProcess::ForwardedChannels);
+   portable.start(application.applicationFilePath(), application.arguments().mid(1));
+   if (!portable.waitForFinished(-1) || portable.exitStatus() != QProcess::NormalExit) {
+      qWarning("ERROR: The tests of the portable implementations didn't finish.");
+      return result + 1;
+   }
+   return result + portable.exitCode();
+}
+
+#include "tst_algorithms.moc"
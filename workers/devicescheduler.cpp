@@ -0,0 +1,176 @@
+/**
+ * Finds the device a file is stored on, and how many reads it handles at once.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include <QFile>
+#include <QThread>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sysmacros.h>
+#endif
+
+#include "devicescheduler.h"
+#include "directoryhandles.h"
+
+/**
+ * @brief DeviceScheduler::DeviceScheduler
+ */
+DeviceScheduler::DeviceScheduler()
+{
+}
+
+/**
+ * @brief DeviceScheduler::~DeviceScheduler
+ * Waits for the threads of all devices.
+ */
+DeviceScheduler::~DeviceScheduler()
+{
+   qDeleteAll(pools);
+}
+
+/**
+ * @brief DeviceScheduler::find
+ * @param filename Full path to the file.
+ * @return The device the file is stored on. The devices are cached by their id.
+ */
+DeviceScheduler::Device DeviceScheduler::find(QString filename)
+{
+   quint64 id = 0;
+#ifdef Q_OS_UNIX
+   struct stat status;
+   if (DirectoryHandles::get().status(filename, &status)) {
+      id = status.st_dev;
+   }
+#else
+   Q_UNUSED(filename);
+#endif
+   QMutexLocker locker(&mutex);
+   if (devices.contains(id)) {
+      return devices.value(id);
+   }
+   Device device = { id, false, otherConcurrency, otherConcurrency };
+   qint64 rotational = queueValue(id, "rotational");
+   if (rotational == 1) {
+      device.rotational = true;
+      device.concurrency = rotationalConcurrency;
+   } else if (rotational == 0) {
+      device.concurrency = solidStateConcurrency;
+   }
+   // More threads than cores won't hash any faster.
+   device.threads = qMin(device.concurrency, qMax(1, QThread::idealThreadCount()));
+   devices.insert(id, device);
+   return device;
+}
+
+/**
+ * @brief DeviceScheduler::pool
+ * @param device
+ * @return The thread pool for the device, with one thread per file hashed at the same time.
+ */
+QThreadPool* DeviceScheduler::pool(const Device& device)
+{
+   QMutexLocker locker(&mutex);
+   QThreadPool* pool = pools.value(device.id);
+   if (!pool) {
+      pool = new QThreadPool;
+      pools.insert(device.id, pool);
+   }
+   pool->setMaxThreadCount(device.threads);
+   return pool;
+}
+
+/**
+ * @brief DeviceScheduler::unscheduled
+ * @param concurrency Number of reads at the same time.
+ * @return A device for all files, hashed one file at a time, for when the devices aren't used.
+ */
+DeviceScheduler::Device DeviceScheduler::unscheduled(int concurrency)
+{
+   Device device = { 0, false, concurrency, 1 };
+   return device;
+}
+
+/**
+ * @brief DeviceScheduler::queueValue
+ * @param device The device number, st_dev.
+ * @param name Name of the value in the queue directory of the block device, for example "rotational".
+ * @return The value, or -1 if the device isn't a block device or the value isn't available.
+ */
+qint64 DeviceScheduler::queueValue(quint64 device, QString name)
+{
+#ifdef Q_OS_LINUX
+   QString path = QString("/sys/dev/block/%1:%2").arg(major(device)).arg(minor(device));
+   // Partitions don't have a queue of their own, it belongs to the disk in the parent directory.
+   path += QFile::exists(path + "/queue") ? "/queue/" : "/../queue/";
+   QFile file(path + name);
+   if (!file.open(QFile::ReadOnly)) {
+      return -1;
+   }
+   bool ok;
+   qint64 value = file.readAll().trimmed().toLongLong(&ok);
+   return ok ? value : -1;
+#else
+   Q_UNUSED(device);
+   Q_UNUSED(name);
+   return -1;
+#endif
+}
+
+/**
+ * @brief DeviceScheduler::physicalLocation
+ * @param filename Full path to the file.
+ * @return Where on its device the file starts, for ordering the files of a device.
+ *
+ * The byte offset of the first extent, from FIEMAP on Linux and F_LOG2PHYS on macOS.
+ * File systems without FIEMAP may still give the first block with FIBMAP, which needs
+ * CAP_SYS_RAWIO. Otherwise the inode number is used, which most file systems allocate
+ * close to the data. Files without any data, or stored inline, also get the inode number.
+ */
+quint64 DeviceScheduler::physicalLocation(QString filename)
+{
+#ifdef Q_OS_UNIX
+   int fd = DirectoryHandles::get().open(filename, O_RDONLY);
+   if (fd < 0) {
+      return 0;
+   }
+   struct stat status;
+   quint64 location = fstat(fd, &status) == 0 ? status.st_ino : 0;
+#if defined(Q_OS_LINUX)
+   // Room for the request and a single extent.
+   quint64 request[(sizeof(struct fiemap) + sizeof(struct fiemap_extent)) / sizeof(quint64) + 1] = {};
+   struct fiemap* map = reinterpret_cast<struct fiemap*>(request);
+   map->fm_length = FIEMAP_MAX_OFFSET;
+   map->fm_extent_count = 1;
+   int block = 0;
+   int blockSize = 0;
+   if (ioctl(fd, FS_IOC_FIEMAP, map) == 0) {
+      if (map->fm_mapped_extents > 0 &&
+          !(map->fm_extents[0].fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DATA_INLINE))) {
+         location = map->fm_extents[0].fe_physical;
+      }
+   } else if (ioctl(fd, FIBMAP, &block) == 0 && block > 0 && ioctl(fd, FIGETBSZ, &blockSize) == 0) {
+      location = static_cast<quint64>(block) * blockSize;
+   }
+#elif defined(Q_OS_MACOS)
+   struct log2phys physical;
+   if (fcntl(fd, F_LOG2PHYS, &physical) == 0) {
+      location = physical.l2p_devoffset;
+   }
+#endif
+   close(fd);
+   return location;
+#else
+   Q_UNUSED(filename);
+   return 0;
+#endif
+}
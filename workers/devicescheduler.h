@@ -0,0 +1,60 @@
+/**
+ * Finds the device a file is stored on, and how many reads it handles at once.
+ *
+ * Files on rotational disks are read one at a time, as concurrent reads make the
+ * heads seek back and forth. SSDs and NVMe drives are faster the more requests
+ * they have to work on, so their files are read by several threads at once.
+ * Each device has its own thread pool, which lets files on different devices
+ * be hashed in parallel, each device with its own limit.
+ *
+ * The devices are found in sysfs, from the device number of the file. File
+ * systems without a block device, like network file systems, and platforms
+ * without sysfs get a moderate limit.
+ *
+ * The physical location of a file on its device lets the files of rotational
+ * disks be read in the order they're stored, instead of seeking between them.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef DEVICESCHEDULER_H
+#define DEVICESCHEDULER_H
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+
+class DeviceScheduler
+{
+public:
+   struct Device {
+      quint64 id;
+      bool rotational;
+      // Number of reads from the device at the same time.
+      int concurrency;
+      // Number of files hashed from the device at the same time.
+      int threads;
+   };
+
+   static const int rotationalConcurrency = 1;
+   static const int solidStateConcurrency = 32;
+   static const int otherConcurrency = 4;
+
+   DeviceScheduler();
+   ~DeviceScheduler();
+
+   Device find(QString filename);
+   QThreadPool* pool(const Device& device);
+
+   static Device unscheduled(int concurrency);
+   static qint64 queueValue(quint64 device, QString name);
+   static quint64 physicalLocation(QString filename);
+
+private:
+   QMutex mutex;
+   QHash<quint64, Device> devices;
+   QHash<quint64, QThreadPool*> pools;
+};
+
+#endif // DEVICESCHEDULER_H
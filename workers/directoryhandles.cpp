@@ -0,0 +1,327 @@
+/**
+ * Opens files relative to open handles of their directories.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include <QDebug>
+
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "directoryhandles.h"
+
+namespace {
+
+#ifdef Q_OS_UNIX
+#ifdef O_PATH
+// Enough for looking up the files, and works for directories that can't be listed.
+const int directoryFlags = O_PATH | O_DIRECTORY | O_CLOEXEC;
+#else
+const int directoryFlags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+#endif
+#endif
+
+}
+
+/**
+ * @brief DirectoryHandles::get
+ * @return The handles shared by all threads.
+ */
+DirectoryHandles& DirectoryHandles::get()
+{
+   static DirectoryHandles directoryHandles;
+   return directoryHandles;
+}
+
+/**
+ * @brief DirectoryHandles::DirectoryHandles
+ */
+DirectoryHandles::DirectoryHandles()
+{
+   uses = 0;
+}
+
+/**
+ * @brief DirectoryHandles::~DirectoryHandles
+ * Closes all handles.
+ */
+DirectoryHandles::~DirectoryHandles()
+{
+#ifdef Q_OS_UNIX
+   foreach (const Handle& handle, handles) {
+      ::close(handle.handle);
+   }
+#endif
+}
+
+/**
+ * @brief DirectoryHandles::openFile
+ * @param file Opened read only and unbuffered.
+ * @param filename Full path to the file.
+ * @return Error message starting with "ERROR:", empty if the file was opened.
+ */
+QString DirectoryHandles::openFile(QFile& file, QString filename)
+{
+   file.setFileName(filename);
+#ifdef Q_OS_UNIX
+   int handle = open(filename, O_RDONLY);
+   if (handle < 0) {
+      if (errno == ENOENT) {
+         qDebug() << "ERROR: File not found: " << filename;
+         return QString("ERROR: File not found.");
+      }
+      QString message = QString::fromLocal8Bit(strerror(errno));
+      qDebug() << "ERROR: " << message;
+      return QString("ERROR: %1").arg(message);
+   }
+   if (!file.open(handle, QFile::ReadOnly | QFile::Unbuffered, QFileDevice::AutoCloseHandle)) {
+      ::close(handle);
+      qDebug() << "ERROR: " << file.errorString();
+      return QString("ERROR: %1").arg(file.errorString());
+   }
+#else
+   if (!file.exists()) {
+      qDebug() << "ERROR: File not found: " << filename;
+      return QString("ERROR: File not found.");
+   }
+   if (!file.open(QFile::ReadOnly | QFile::Unbuffered)) {
+      qDebug() << "ERROR: " << file.errorString();
+      return QString("ERROR: %1").arg(file.errorString());
+   }
+#endif
+   return QString();
+}
+
+/**
+ * @brief DirectoryHandles::open
+ * @param filename Full path to the file.
+ * @param flags The flags for open(), close-on-exec is added.
+ * @return The file descriptor, or -1 with errno set. Always -1 elsewhere than on Unix.
+ */
+int DirectoryHandles::open(QString filename, int flags)
+{
+#ifdef Q_OS_UNIX
+   QString directory;
+   QByteArray name;
+   if (split(filename, directory, name)) {
+      int handle = acquire(directory);
+      if (handle >= 0) {
+         int file = openat(handle, name.constData(), flags | O_CLOEXEC);
+         int error = errno;
+         release(directory);
+         errno = error;
+         return file;
+      }
+   }
+   return ::open(QFile::encodeName(filename).constData(), flags | O_CLOEXEC);
+#else
+   Q_UNUSED(filename);
+   Q_UNUSED(flags);
+   return -1;
+#endif
+}
+
+/**
+ * @brief DirectoryHandles::status
+ * @param filename Full path to the file, symbolic links are followed.
+ * @param status Set to the status of the file.
+ * @return False if the file can't be found. Always false elsewhere than on Unix.
+ */
+bool DirectoryHandles::status(QString filename, struct stat* status)
+{
+#ifdef Q_OS_UNIX
+   QString directory;
+   QByteArray name;
+   if (split(filename, directory, name)) {
+      int handle = acquire(directory);
+      if (handle >= 0) {
+         bool found = fstatat(handle, name.constData(), status, 0) == 0;
+         release(directory);
+         return found;
+      }
+   }
+   return stat(QFile::encodeName(filename).constData(), status) == 0;
+#else
+   Q_UNUSED(filename);
+   Q_UNUSED(status);
+   return false;
+#endif
+}
+
+/**
+ * @brief DirectoryHandles::keep
+ * @param directory Full path to the directory.
+ * @param handle An open descriptor of the directory, which is owned by this from now on.
+ */
+void DirectoryHandles::keep(QString directory, int handle)
+{
+#ifdef Q_OS_UNIX
+   while (directory.length() > 1 && directory.endsWith(QLatin1Char('/'))) {
+      directory.chop(1);
+   }
+   insert(directory, handle, 0);
+#else
+   Q_UNUSED(directory);
+   Q_UNUSED(handle);
+#endif
+}
+
+/**
+ * @brief DirectoryHandles::closeAll
+ * Closes all handles not in use.
+ */
+void DirectoryHandles::closeAll()
+{
+   QMutexLocker locker(&mutex);
+   QHash<QString, Handle>::iterator i = handles.begin();
+   while (i != handles.end()) {
+      if (i->users == 0) {
+#ifdef Q_OS_UNIX
+         ::close(i->handle);
+#endif
+         i = handles.erase(i);
+      } else {
+         ++i;
+      }
+   }
+}
+
+/**
+ * @brief DirectoryHandles::acquire
+ * @param directory Full path to the directory.
+ * @return A handle of the directory, -1 if it can't be opened. Must be released.
+ *
+ * Opens the directory from its parent if it isn't already open.
+ */
+int DirectoryHandles::acquire(const QString& directory)
+{
+#ifdef Q_OS_UNIX
+   {
+      QMutexLocker locker(&mutex);
+      QHash<QString, Handle>::iterator found = handles.find(directory);
+      if (found != handles.end()) {
+         found->users++;
+         found->lastUse = ++uses;
+         return found->handle;
+      }
+   }
+   int handle = -1;
+   QString parent;
+   QByteArray name;
+   if (split(directory, parent, name)) {
+      int parentHandle = acquire(parent);
+      if (parentHandle >= 0) {
+         handle = openat(parentHandle, name.constData(), directoryFlags);
+         release(parent);
+      }
+   } else {
+      handle = ::open(QFile::encodeName(directory).constData(), directoryFlags);
+   }
+   if (handle < 0) {
+      return -1;
+   }
+   return insert(directory, handle, 1);
+#else
+   Q_UNUSED(directory);
+   return -1;
+#endif
+}
+
+/**
+ * @brief DirectoryHandles::release
+ * @param directory A directory acquired before, which may now be closed.
+ */
+void DirectoryHandles::release(const QString& directory)
+{
+   QMutexLocker locker(&mutex);
+   QHash<QString, Handle>::iterator found = handles.find(directory);
+   if (found != handles.end()) {
+      found->users--;
+   }
+   closeUnused();
+}
+
+/**
+ * @brief DirectoryHandles::insert
+ * @param directory Full path to the directory.
+ * @param handle A new handle of the directory.
+ * @param users 1 if it's acquired, 0 if not.
+ * @return The handle to use. If another thread opened the directory at the same time, its handle.
+ */
+int DirectoryHandles::insert(const QString& directory, int handle, int users)
+{
+   QMutexLocker locker(&mutex);
+   QHash<QString, Handle>::iterator found = handles.find(directory);
+   if (found != handles.end()) {
+#ifdef Q_OS_UNIX
+      ::close(handle);
+#endif
+      found->users += users;
+      found->lastUse = ++uses;
+      return found->handle;
+   }
+   Handle newHandle = { handle, users, ++uses };
+   handles.insert(directory, newHandle);
+   closeUnused();
+   return handle;
+}
+
+/**
+ * @brief DirectoryHandles::closeUnused
+ * Closes the least recently used handles not in use, until no more than maximumHandles are open.
+ * Called with the mutex locked.
+ */
+void DirectoryHandles::closeUnused()
+{
+   while (handles.size() > maximumHandles) {
+      QHash<QString, Handle>::iterator oldest = handles.end();
+      for (QHash<QString, Handle>::iterator i = handles.begin(); i != handles.end(); ++i) {
+         if (i->users == 0 && (oldest == handles.end() || i->lastUse < oldest->lastUse)) {
+            oldest = i;
+         }
+      }
+      if (oldest == handles.end()) {
+         // All are in use, they're closed when released.
+         return;
+      }
+#ifdef Q_OS_UNIX
+      ::close(oldest->handle);
+#endif
+      handles.erase(oldest);
+   }
+}
+
+/**
+ * @brief DirectoryHandles::split
+ * @param path Absolute path.
+ * @param directory Set to the directory the path is in, without a trailing separator.
+ * @param name Set to the last name in the path, encoded for the file system.
+ * @return False for the root directory and paths that aren't absolute.
+ */
+bool DirectoryHandles::split(const QString& path, QString& directory, QByteArray& name)
+{
+   if (!path.startsWith(QLatin1Char('/'))) {
+      return false;
+   }
+   int end = path.length();
+   while (end > 1 && path.at(end - 1) == QLatin1Char('/')) {
+      end--;
+   }
+   int separator = path.lastIndexOf(QLatin1Char('/'), end - 1);
+   if (separator < 0 || separator == end - 1) {
+      return false;
+   }
+   name = QFile::encodeName(path.mid(separator + 1, end - separator - 1));
+   int directoryEnd = separator;
+   while (directoryEnd > 1 && path.at(directoryEnd - 1) == QLatin1Char('/')) {
+      directoryEnd--;
+   }
+   directory = path.left(qMax(1, directoryEnd));
+   return true;
+}
@@ -0,0 +1,67 @@
+/**
+ * Opens files relative to open handles of their directories.
+ *
+ * Opening a file by its full path makes the kernel look up every directory in
+ * the path again, for each file. Instead the directories are kept open, and the
+ * files are opened and stat()ed with openat() and fstatat() from the handle of
+ * their directory, so only the name of the file itself is looked up. A directory
+ * that isn't open yet is opened the same way from its parent.
+ *
+ * The handles are shared by all threads. At most maximumHandles are kept open,
+ * the least recently used ones are closed first, but never while in use.
+ * The DirectoryScanner hands over the handles of the directories it has listed,
+ * so the files found are hashed without opening their directories again.
+ * The handles not in use are closed with closeAll() when a scan or hashing has
+ * finished, so the devices aren't kept busy.
+ *
+ * Elsewhere than on Unix the files are opened by their full paths.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef DIRECTORYHANDLES_H
+#define DIRECTORYHANDLES_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+struct stat;
+
+class DirectoryHandles
+{
+public:
+   // Well below the default limit of open files, 256 on macOS.
+   static const int maximumHandles = 128;
+
+   static DirectoryHandles& get();
+
+   QString openFile(QFile& file, QString filename);
+   int open(QString filename, int flags);
+   bool status(QString filename, struct stat* status);
+   void keep(QString directory, int handle);
+   void closeAll();
+
+private:
+   struct Handle {
+      int handle;
+      int users;
+      quint64 lastUse;
+   };
+
+   DirectoryHandles();
+   ~DirectoryHandles();
+   int acquire(const QString& directory);
+   void release(const QString& directory);
+   int insert(const QString& directory, int handle, int users);
+   void closeUnused();
+   static bool split(const QString& path, QString& directory, QByteArray& name);
+
+   QMutex mutex;
+   QHash<QString, Handle> handles;
+   quint64 uses;
+};
+
+#endif // DIRECTORYHANDLES_H
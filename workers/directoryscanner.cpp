@@ -0,0 +1,399 @@
+/**
+ * Lists the files of a directory tree with several threads at once.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include <QDirIterator>
+#include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "directoryhandles.h"
+#include "directoryscanner.h"
+
+namespace {
+
+// Listing directories mostly waits for the file system, so there are more workers than cores.
+const int minimumWorkers = 4;
+const int maximumWorkers = 16;
+// Idle workers look for directories to steal this often, in milliseconds.
+const int stealInterval = 5;
+
+#ifdef Q_OS_LINUX
+// Size of the batches of entries read with getdents64.
+const int direntBufferSize = 64 * 1024;
+
+// The record returned by getdents64, which has no declaration in the C library headers.
+struct Dirent64 {
+   quint64 d_ino;
+   qint64 d_off;
+   unsigned short d_reclen;
+   unsigned char d_type;
+   char d_name[1];
+};
+
+/**
+ * @brief statEntry
+ * @param directory File descriptor of the directory.
+ * @param name The entry in the directory.
+ * @param follow Follow a symbolic link to what it points to.
+ * @param mode Set to the type of the entry.
+ * @param size Set to the size of the entry.
+ * @return False if it can't be found.
+ *
+ * Uses statx() asking only for the type and size, where available.
+ */
+bool statEntry(int directory, const char* name, bool follow, mode_t& mode, qint64& size)
+{
+   int flags = follow ? 0 : AT_SYMLINK_NOFOLLOW;
+#ifdef STATX_SIZE
+   struct statx info;
+   if (statx(directory, name, flags, STATX_TYPE | STATX_SIZE, &info) == 0) {
+      mode = info.stx_mode;
+      size = static_cast<qint64>(info.stx_size);
+      return true;
+   }
+   if (errno != ENOSYS) {
+      return false;
+   }
+#endif
+   struct stat status;
+   if (fstatat(directory, name, &status, flags) != 0) {
+      return false;
+   }
+   mode = status.st_mode;
+   size = status.st_size;
+   return true;
+}
+#endif
+
+/**
+ * @brief pathLessThan
+ * @return True if the first path comes before the second one, comparing them directory by directory.
+ */
+bool pathLessThan(const DirectoryScanner::Entry& first, const DirectoryScanner::Entry& second)
+{
+   const QString& a = first.path;
+   const QString& b = second.path;
+   int length = qMin(a.length(), b.length());
+   for (int i = 0; i < length; i++) {
+      if (a.at(i) != b.at(i)) {
+         // The separator goes before all other characters, so "a/b" comes before "a.b".
+         if (a.at(i) == QLatin1Char('/')) {
+            return true;
+         }
+         if (b.at(i) == QLatin1Char('/')) {
+            return false;
+         }
+         return a.at(i) < b.at(i);
+      }
+   }
+   return a.length() < b.length();
+}
+
+}
+
+/**
+ * @brief DirectoryScanner::DirectoryScanner
+ */
+DirectoryScanner::DirectoryScanner()
+{
+   int count = qBound(minimumWorkers, 2 * QThread::idealThreadCount(), maximumWorkers);
+   for (int i = 0; i < count; i++) {
+      workers.append(new Worker);
+   }
+   threads.setMaxThreadCount(count);
+   finished = true;
+}
+
+/**
+ * @brief DirectoryScanner::~DirectoryScanner
+ * Stops a scan in progress.
+ */
+DirectoryScanner::~DirectoryScanner()
+{
+   abort();
+   threads.waitForDone();
+   qDeleteAll(workers);
+}
+
+/**
+ * @brief DirectoryScanner::start
+ * @param path The directory to scan, with its subdirectories.
+ *
+ * Starts the workers. The files are returned by next().
+ */
+void DirectoryScanner::start(QString path)
+{
+   // The workers of the previous scan may still be leaving.
+   threads.waitForDone();
+   aborted.storeRelease(0);
+   {
+      QMutexLocker locker(&foundMutex);
+      found.clear();
+      finished = false;
+   }
+   for (int i = 0; i < workers.size(); i++) {
+      workers[i]->directories.clear();
+   }
+   pending.storeRelease(1);
+   workers.first()->directories.append(path);
+   for (int i = 0; i < workers.size(); i++) {
+      QtConcurrent::run(&threads, [this, i]() {
+         work(i);
+      });
+   }
+}
+
+/**
+ * @brief DirectoryScanner::next
+ * @param entries Set to the files found since the last call.
+ * @return False when the scan has finished, or was aborted, and all files have been returned.
+ *
+ * Waits until there are new files.
+ */
+bool DirectoryScanner::next(QList<Entry>& entries)
+{
+   QMutexLocker locker(&foundMutex);
+   while (found.isEmpty() && !finished) {
+      foundChanged.wait(&foundMutex);
+   }
+   entries.clear();
+   entries.swap(found);
+   return !entries.isEmpty();
+}
+
+/**
+ * @brief DirectoryScanner::abort
+ * Stops the workers, the directories not yet scanned are skipped.
+ */
+void DirectoryScanner::abort()
+{
+   aborted.storeRelease(1);
+   QMutexLocker locker(&foundMutex);
+   finished = true;
+   foundChanged.wakeAll();
+}
+
+/**
+ * @brief DirectoryScanner::sort
+ * @param entries Sorted by path, directory by directory, which gives the same order on every scan.
+ */
+void DirectoryScanner::sort(QList<Entry>& entries)
+{
+   std::sort(entries.begin(), entries.end(), pathLessThan);
+}
+
+/**
+ * @brief DirectoryScanner::work
+ * @param index The worker, run on its own thread until all directories have been scanned.
+ */
+void DirectoryScanner::work(int index)
+{
+   QString directory;
+   while (take(index, directory)) {
+      if (!aborted.loadAcquire()) {
+         scan(index, directory);
+      }
+      if (pending.fetchAndAddOrdered(-1) == 1) {
+         // That was the last directory.
+         QMutexLocker locker(&foundMutex);
+         finished = true;
+         foundChanged.wakeAll();
+      }
+   }
+}
+
+/**
+ * @brief DirectoryScanner::take
+ * @param index The worker.
+ * @param directory Set to the next directory to scan.
+ * @return False when there are no more directories.
+ *
+ * Takes the newest directory from the worker's own queue, or steals the oldest one from
+ * another worker. Waits while the other workers may still find more directories.
+ */
+bool DirectoryScanner::take(int index, QString& directory)
+{
+   forever {
+      Worker* own = workers.at(index);
+      {
+         QMutexLocker locker(&own->mutex);
+         if (!own->directories.isEmpty()) {
+            directory = own->directories.takeLast();
+            return true;
+         }
+      }
+      for (int i = 1; i < workers.size(); i++) {
+         Worker* other = workers.at((index + i) % workers.size());
+         QMutexLocker locker(&other->mutex);
+         if (!other->directories.isEmpty()) {
+            directory = other->directories.takeFirst();
+            return true;
+         }
+      }
+      if (pending.loadAcquire() == 0) {
+         return false;
+      }
+      QMutexLocker locker(&idleMutex);
+      workAdded.wait(&idleMutex, stealInterval);
+   }
+}
+
+/**
+ * @brief DirectoryScanner::scan
+ * @param index The worker.
+ * @param directory Lists the directory, queues its subdirectories and adds its files to the found ones.
+ */
+void DirectoryScanner::scan(int index, const QString& directory)
+{
+   QList<Entry> files;
+   QList<QString> subdirectories;
+   list(directory, files, subdirectories);
+   if (!subdirectories.isEmpty()) {
+      // Counted before they're queued, so the scan can't be seen as finished in between.
+      pending.fetchAndAddOrdered(subdirectories.size());
+      Worker* own = workers.at(index);
+      {
+         QMutexLocker locker(&own->mutex);
+         own->directories.append(subdirectories);
+      }
+      QMutexLocker locker(&idleMutex);
+      workAdded.wakeAll();
+   }
+   if (!files.isEmpty()) {
+      QMutexLocker locker(&foundMutex);
+      found.append(files);
+      foundChanged.wakeAll();
+   }
+}
+
+/**
+ * @brief DirectoryScanner::list
+ * @param directory The directory to list.
+ * @param files The files in the directory are added here, with their sizes.
+ * @param subdirectories The subdirectories are added here, but not symbolic links to directories.
+ */
+void DirectoryScanner::list(const QString& directory, QList<Entry>& files, QList<QString>& subdirectories)
+{
+   if (listNative(directory, files, subdirectories)) {
+      return;
+   }
+   // The default filter of QDirIterator, hidden entries and special files like FIFOs and devices are skipped.
+   QDirIterator iterator(directory, QDir::AllEntries | QDir::NoDotAndDotDot);
+   while (iterator.hasNext()) {
+      iterator.next();
+      QFileInfo info = iterator.fileInfo();
+      if (info.isDir()) {
+         if (!info.isSymLink()) {
+            subdirectories.append(iterator.filePath());
+         }
+         continue;
+      }
+      Entry entry = { iterator.filePath(), info.size() };
+      files.append(entry);
+   }
+}
+
+/**
+ * @brief DirectoryScanner::listNative
+ * @param directory The directory to list.
+ * @param files The files in the directory are added here, with their sizes.
+ * @param subdirectories The subdirectories are added here, but not symbolic links to directories.
+ * @return False if the directory couldn't be read this way, or not completely, and nothing was added.
+ *
+ * Reads the entries with getdents64. Directories are recognized by the type given with
+ * the name, only entries of unknown type and symbolic links are stat()ed to find it.
+ * Only regular files and links to them are listed, hidden entries are skipped, like
+ * the default filter of QDirIterator.
+ */
+bool DirectoryScanner::listNative(const QString& directory, QList<Entry>& files, QList<QString>& subdirectories)
+{
+#ifdef Q_OS_LINUX
+   int fd = DirectoryHandles::get().open(directory, O_RDONLY | O_DIRECTORY);
+   if (fd < 0) {
+      return false;
+   }
+   QString prefix = directory;
+   if (!prefix.endsWith(QLatin1Char('/'))) {
+      prefix += QLatin1Char('/');
+   }
+   QList<Entry> foundFiles;
+   QList<QString> foundDirectories;
+   char buffer[direntBufferSize];
+   forever {
+      long length = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+      if (length < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         // Not supported here, or failed partway. The entries found so far are dropped,
+         // so an incomplete listing is never taken for the whole directory.
+         close(fd);
+         return false;
+      }
+      if (length == 0) {
+         break;
+      }
+      for (long offset = 0; offset < length; ) {
+         const Dirent64* entry = reinterpret_cast<const Dirent64*>(buffer + offset);
+         offset += entry->d_reclen;
+         const char* name = entry->d_name;
+         if (name[0] == '.') {
+            // Hidden, as are the . and .. entries.
+            continue;
+         }
+         unsigned char type = entry->d_type;
+         mode_t mode = 0;
+         qint64 size = 0;
+         if (type == DT_UNKNOWN) {
+            // Some file systems don't store the type in the directory.
+            if (!statEntry(fd, name, false, mode, size)) {
+               continue;
+            }
+            type = S_ISDIR(mode) ? DT_DIR : (S_ISLNK(mode) ? DT_LNK : (S_ISREG(mode) ? DT_REG : DT_UNKNOWN));
+         }
+         if (type == DT_DIR) {
+            foundDirectories.append(prefix + QFile::decodeName(name));
+            continue;
+         }
+         if (type != DT_REG && type != DT_LNK) {
+            // FIFOs, sockets and devices.
+            continue;
+         }
+         if (type == DT_LNK || mode == 0) {
+            // Links are listed as what they point to, broken links are skipped.
+            if (!statEntry(fd, name, type == DT_LNK, mode, size)) {
+               continue;
+            }
+         }
+         if (!S_ISREG(mode)) {
+            // Links to directories and special files.
+            continue;
+         }
+         Entry file = { prefix + QFile::decodeName(name), size };
+         foundFiles.append(file);
+      }
+   }
+   // Kept open for hashing the files.
+   DirectoryHandles::get().keep(directory, fd);
+   files.append(foundFiles);
+   subdirectories.append(foundDirectories);
+   return true;
+#else
+   Q_UNUSED(directory);
+   Q_UNUSED(files);
+   Q_UNUSED(subdirectories);
+   return false;
+#endif
+}
@@ -0,0 +1,80 @@
+/**
+ * Lists the files of a directory tree with several threads at once.
+ *
+ * Every directory is a task for a pool of worker threads. Each worker has its own
+ * queue of directories, and adds the subdirectories it finds to it. A worker takes
+ * the directory it added last from its own queue, which keeps it working in one part
+ * of the tree, and when its queue is empty it steals the oldest directory from the
+ * queue of another worker, which is usually the root of a large unscanned subtree.
+ * On network file systems and cold disks most of the time is spent waiting for the
+ * directories and the sizes of the files, so the workers keep many requests going.
+ *
+ * The files are returned in batches by next(), in the order they're found. They can
+ * be sorted afterwards with sort(), which gives the same order on every scan.
+ *
+ * On Linux the directories are read in large batches with getdents64. The type of
+ * each entry comes with its name, so directories are never stat()ed, and the files
+ * only get a statx() asking for their size. Elsewhere, and where reading a directory
+ * that way fails at any point, the directory is listed with QDirIterator instead.
+ *
+ * Like QDirIterator by default, symbolic links to directories aren't followed, and
+ * hidden files and directories, broken links and special files such as FIFOs,
+ * sockets and devices are skipped.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef DIRECTORYSCANNER_H
+#define DIRECTORYSCANNER_H
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include <QWaitCondition>
+
+class DirectoryScanner
+{
+public:
+   struct Entry {
+      QString path;
+      qint64 size;
+   };
+
+   DirectoryScanner();
+   ~DirectoryScanner();
+
+   void start(QString path);
+   bool next(QList<Entry>& entries);
+   void abort();
+
+   static void sort(QList<Entry>& entries);
+
+private:
+   struct Worker {
+      QMutex mutex;
+      QList<QString> directories;
+   };
+
+   void work(int index);
+   bool take(int index, QString& directory);
+   void scan(int index, const QString& directory);
+   static void list(const QString& directory, QList<Entry>& files, QList<QString>& subdirectories);
+   static bool listNative(const QString& directory, QList<Entry>& files, QList<QString>& subdirectories);
+
+   QThreadPool threads;
+   QVector<Worker*> workers;
+   // Directories queued or being scanned, the scan is done when it reaches zero.
+   QAtomicInt pending;
+   QAtomicInt aborted;
+   QMutex idleMutex;
+   QWaitCondition workAdded;
+   QMutex foundMutex;
+   QWaitCondition foundChanged;
+   QList<Entry> found;
+   bool finished;
+};
+
+#endif // DIRECTORYSCANNER_H
@@ -6,6 +6,11 @@
  * When all available sub-directories have been traversed and
  * the scan has finished, the signal scanFinished will be emitted.
  *
+ * The directories are listed in parallel by a DirectoryScanner, while
+ * the signals are emitted, and any blocking hashing done, in this thread.
+ * The files are emitted as they're found, or sorted by path once the
+ * whole tree has been scanned, so the saved files stay the same.
+ *
  * While it's not a requirement, this class was designed for and
  * benefits from running in a separate QThread.
  * When in multithreaded mode, other threads can abort the scanning
@@ -19,6 +24,7 @@
 #include "hashproject/sourcedirectory.h"
 #include "hashproject/hashproject.h"
 #include "hashproject/filelist.h"
+#include "directoryhandles.h"
 #include "filefinder.h"
 
 /**
@@ -28,6 +34,7 @@
 void FileFinder::abort()
 {
    aborted = true;
+   scanner.abort();
 }
 
 /**
@@ -40,11 +47,14 @@ void FileFinder::abort()
  *
  * The HashProject::Settings configuration settings that can be defined
  * for this function are:
+ * - sortedscan: Emit the files sorted by path when the scan has finished,
+ *               keeping all of them in memory until then. If set to false,
+ *               the default, they're emitted as they're found.
  * - scanimmediately: Calculate hash sum when a file has been found.
  *                    If set to false only the filename will be added.
  * - blockinghashcalc: If scanimmediately is true, calculate the hash sum
  *                     in this thread. Otherwise it may run in a different thread.
- * - algorithm: Which algorithm should be used for the calculation.
+ * - algorithms: Which algorithms should be used for the calculation.
  */
 void FileFinder::scanProject(HashProject* hashproject)
 {
@@ -64,27 +74,55 @@ void FileFinder::scanProject(HashProject* hashproject)
    if (basepath.right(1) != QDir::separator()) {
       basepath += QDir::separator();
    }
-   QDirIterator iterator(basepath, QDirIterator::Subdirectories);
+   scanner.start(basepath);
 
-   while (iterator.hasNext()) {
+   QList<DirectoryScanner::Entry> entries;
+   QList<DirectoryScanner::Entry> allEntries;
+   while (scanner.next(entries)) {
       if (aborted) {
          // Scanning was aborted by a separate thread.
+         DirectoryHandles::get().closeAll();
          emit scanFinished();
          return;
       }
-      iterator.next();
-      if (!iterator.fileInfo().isDir()) {
-         // Not a directory. Create a new File object and emit it.
-         QString filename = iterator.filePath();
-         HashProject::File filenode;
-         filenode.filename = filename.remove(0, basepath.length());
-         filenode.filesize = iterator.fileInfo().size();
-         if (settings.blockinghashcalc && settings.scanimmediately) {
-            filenode.hash = hasher.hashFile(-1, basepath, filenode, settings.algorithm);
-            filenode.algorithm = settings.algorithm;
-         }
-         emit fileFound(filenode, false);
+      if (settings.sortedscan) {
+         allEntries.append(entries);
+      } else {
+         emitFiles(entries, basepath, settings);
       }
    }
+   if (settings.sortedscan && !aborted) {
+      DirectoryScanner::sort(allEntries);
+      emitFiles(allEntries, basepath, settings);
+   }
+   // The directories aren't kept open between scans, so the device can be unmounted.
+   DirectoryHandles::get().closeAll();
    emit scanFinished();
 }
+
+/**
+ * @brief FileFinder::emitFiles
+ * @param entries The found files.
+ * @param basepath The scanned directory, removed from the filenames.
+ * @param settings The project settings.
+ *
+ * Creates a File object for each found file and emits it, with
+ * the hash sums calculated if set to do so in this thread. A file that
+ * couldn't be read gets the error message instead.
+ */
+void FileFinder::emitFiles(const QList<DirectoryScanner::Entry>& entries, QString basepath, const HashProject::Settings& settings)
+{
+   foreach (const DirectoryScanner::Entry& entry, entries) {
+      if (aborted) {
+         return;
+      }
+      HashProject::File filenode;
+      filenode.filename = entry.path.mid(basepath.length());
+      filenode.filesize = entry.size;
+      if (settings.blockinghashcalc && settings.scanimmediately) {
+         filenode.hashes = hasher.hashFile(-1, basepath, filenode, settings, false, &filenode.error);
+         filenode.algorithm = settings.algorithms.value(0);
+      }
+      emit fileFound(filenode, false);
+   }
+}
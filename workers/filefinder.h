@@ -6,6 +6,11 @@
  * When all available sub-directories have been traversed and
  * the scan has finished, the signal scanFinished will be emitted.
  *
+ * The directories are listed in parallel by a DirectoryScanner, while
+ * the signals are emitted, and any blocking hashing done, in this thread.
+ * The files are emitted as they're found, or sorted by path once the
+ * whole tree has been scanned, so the saved files stay the same.
+ *
  * While it's not a requirement, this class was designed for and
  * benefits from running in a separate QThread.
  * When in multithreaded mode, other threads can abort the scanning
@@ -23,6 +28,7 @@
 #include "hashproject/hashproject.h"
 #include "hashproject/filelist.h"
 #include "workers/hasher.h"
+#include "workers/directoryscanner.h"
 
 class SourceDirectory;
 
@@ -41,8 +47,11 @@ signals:
    void fileFound(HashProject::File, bool forceUpdate);
 
 private:
+   void emitFiles(const QList<DirectoryScanner::Entry>& entries, QString basepath, const HashProject::Settings& settings);
+
    bool aborted;
    Hasher hasher;
+   DirectoryScanner scanner;
 };
 
 #endif // FILEFINDER_H
@@ -0,0 +1,135 @@
+/**
+ * Hints to the operating system about how the files are read.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include <QHash>
+#include <QMutex>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#include "devicescheduler.h"
+#include "filehints.h"
+
+namespace {
+
+const qint64 minimumReadahead = 1024 * 1024;
+const qint64 maximumReadahead = 16 * 1024 * 1024;
+// The largest folios the page cache uses for files.
+const qint64 largeFolioSize = 2 * 1024 * 1024;
+
+// The readahead sizes are looked up once per device.
+QMutex readaheadMutex;
+QHash<quint64, qint64> readaheadSizes;
+
+}
+
+/**
+ * @brief FileHints::setNoAccessTime
+ * @param fd Reads won't update the access time of the file.
+ *
+ * Only allowed for the owner of the file, for other files it's silently skipped.
+ */
+void FileHints::setNoAccessTime(int fd)
+{
+#ifdef Q_OS_LINUX
+   int flags = fcntl(fd, F_GETFL);
+   if (flags != -1) {
+      fcntl(fd, F_SETFL, flags | O_NOATIME);
+   }
+#else
+   Q_UNUSED(fd);
+#endif
+}
+
+/**
+ * @brief FileHints::adviseSequential
+ * @param fd The file will be read from start to end, the kernel can use a larger readahead.
+ */
+void FileHints::adviseSequential(int fd)
+{
+#ifdef Q_OS_LINUX
+   posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#else
+   Q_UNUSED(fd);
+#endif
+}
+
+/**
+ * @brief FileHints::readaheadSize
+ * @param fd
+ * @return How far ahead of the reading the data should be requested.
+ *
+ * Four of the largest requests the device accepts, or its readahead if that's larger,
+ * which keeps the device busy without reading too far ahead of the hashing.
+ * Files not stored on a block device get the minimum size.
+ */
+qint64 FileHints::readaheadSize(int fd)
+{
+#ifdef Q_OS_LINUX
+   struct stat status;
+   if (fstat(fd, &status) != 0) {
+      return minimumReadahead;
+   }
+   QMutexLocker locker(&readaheadMutex);
+   if (readaheadSizes.contains(status.st_dev)) {
+      return readaheadSizes.value(status.st_dev);
+   }
+   qint64 size = qMax(4 * DeviceScheduler::queueValue(status.st_dev, "max_sectors_kb"),
+                      DeviceScheduler::queueValue(status.st_dev, "read_ahead_kb")) * 1024;
+   size = qBound(minimumReadahead, size, maximumReadahead);
+   readaheadSizes.insert(status.st_dev, size);
+   return size;
+#else
+   Q_UNUSED(fd);
+   return minimumReadahead;
+#endif
+}
+
+/**
+ * @brief FileHints::readahead
+ * @param fd
+ * @param offset
+ * @param length Starts reading the range into the page cache, without waiting for it.
+ */
+void FileHints::readahead(int fd, qint64 offset, qint64 length)
+{
+#if defined(Q_OS_LINUX)
+   posix_fadvise(fd, offset, length, POSIX_FADV_WILLNEED);
+#elif defined(Q_OS_MACOS)
+   struct radvisory advisory;
+   advisory.ra_offset = offset;
+   advisory.ra_count = static_cast<int>(length);
+   fcntl(fd, F_RDADVISE, &advisory);
+#else
+   Q_UNUSED(fd);
+   Q_UNUSED(offset);
+   Q_UNUSED(length);
+#endif
+}
+
+/**
+ * @brief FileHints::dropCache
+ * @param fd
+ * @param offset
+ * @param length The range is dropped from the page cache, if no one else has it mapped.
+ *
+ * Large folios are only dropped when all of them is in the range, so the range is
+ * extended back to the previous folio boundary. When a file is dropped block by block,
+ * that covers the folios straddling the previous block.
+ */
+void FileHints::dropCache(int fd, qint64 offset, qint64 length)
+{
+#ifdef Q_OS_LINUX
+   qint64 start = offset & ~(largeFolioSize - 1);
+   posix_fadvise(fd, start, offset + length - start, POSIX_FADV_DONTNEED);
+#else
+   Q_UNUSED(fd);
+   Q_UNUSED(offset);
+   Q_UNUSED(length);
+#endif
+}
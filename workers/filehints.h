@@ -0,0 +1,38 @@
+/**
+ * Hints to the operating system about how the files are read.
+ *
+ * Lets the hashing be a good citizen on shared hosts: the files can be dropped
+ * from the page cache after they've been hashed, so they don't evict the data
+ * other programs are using, and opened without updating the access times, so
+ * reading millions of files doesn't cause a flood of metadata writes. The
+ * readahead hints are sized from the block device the file is stored on.
+ *
+ * The hints are only supported on Linux, and readahead also on macOS.
+ * Elsewhere they're ignored.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef FILEHINTS_H
+#define FILEHINTS_H
+
+#include <QtGlobal>
+
+class FileHints
+{
+public:
+   // Combined into the hints setting of a project, the numbers must never change.
+   enum Hint {
+      DropCache = 1,
+      NoAccessTime = 2,
+      Readahead = 4
+   };
+
+   static void setNoAccessTime(int fd);
+   static void adviseSequential(int fd);
+   static qint64 readaheadSize(int fd);
+   static void readahead(int fd, qint64 offset, qint64 length);
+   static void dropCache(int fd, qint64 offset, qint64 length);
+};
+
+#endif // FILEHINTS_H
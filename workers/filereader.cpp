@@ -0,0 +1,636 @@
+/**
+ * Reads a file, or a range of it, block by block for the hashing algorithms.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include <QAtomicInt>
+#include <QDebug>
+#include <QList>
+#include <QMutex>
+#include <limits>
+
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "directoryhandles.h"
+#include "filehints.h"
+#include "filereader.h"
+#include "throttle.h"
+
+namespace {
+
+// The aligned buffers are kept between files and shared by the readers of all threads.
+const int maxPooledDirectBuffers = 8;
+QMutex directBufferMutex;
+QList<char*> directBufferPool;
+
+#ifdef Q_OS_UNIX
+// The mapped windows of all readers, known to the SIGBUS handler.
+const int maxGuardedWindows = 256;
+
+struct GuardedWindow {
+   // From the page boundary the window is mapped from to its end, 0 if the slot is free.
+   QAtomicInteger<quintptr> start;
+   QAtomicInteger<quintptr> end;
+   // Set by the handler if the pages past the end of the file were replaced.
+   QAtomicInt truncated;
+};
+
+GuardedWindow guardedWindows[maxGuardedWindows];
+quintptr guardedPageSize;
+struct sigaction previousBusAction;
+
+/**
+ * @brief busHandler
+ * Reading a mapped page past the end of a file, after it has been truncated by another
+ * program, raises SIGBUS. If the page is in one of the windows, the rest of the window
+ * is replaced by zeros so the reading can continue, and the reader reports an error.
+ * Other faults are passed on to the previous handler.
+ */
+void busHandler(int signal, siginfo_t* info, void* context)
+{
+   quintptr address = reinterpret_cast<quintptr>(info->si_addr);
+   for (int i = 0; i < maxGuardedWindows; i++) {
+      GuardedWindow& window = guardedWindows[i];
+      quintptr start = window.start.loadAcquire();
+      quintptr end = window.end.loadAcquire();
+      if (start != 0 && address >= start && address < end) {
+         quintptr page = address & ~(guardedPageSize - 1);
+         mmap(reinterpret_cast<void*>(page), end - page, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+         window.truncated.storeRelease(1);
+         return;
+      }
+   }
+   if (previousBusAction.sa_flags & SA_SIGINFO) {
+      previousBusAction.sa_sigaction(signal, info, context);
+   } else if (previousBusAction.sa_handler != SIG_DFL && previousBusAction.sa_handler != SIG_IGN) {
+      previousBusAction.sa_handler(signal);
+   } else if (previousBusAction.sa_handler == SIG_DFL) {
+      // Terminates the program as usual once the handler returns.
+      sigaction(SIGBUS, &previousBusAction, 0);
+      raise(signal);
+   }
+}
+
+/**
+ * @brief installBusHandler
+ * @return True when the handler is installed, done once for all readers.
+ */
+bool installBusHandler()
+{
+   guardedPageSize = static_cast<quintptr>(sysconf(_SC_PAGESIZE));
+   struct sigaction action;
+   memset(&action, 0, sizeof(action));
+   action.sa_sigaction = busHandler;
+   action.sa_flags = SA_SIGINFO;
+   sigemptyset(&action.sa_mask);
+   return sigaction(SIGBUS, &action, &previousBusAction) == 0;
+}
+
+/**
+ * @brief guardWindow
+ * @param window A window mapped by QFile.
+ * @param length
+ * @return The slot of the window, -1 if the window can't be guarded and mustn't be used.
+ */
+int guardWindow(const uchar* window, qint64 length)
+{
+   static const bool installed = installBusHandler();
+   if (!installed) {
+      return -1;
+   }
+   quintptr start = reinterpret_cast<quintptr>(window) & ~(guardedPageSize - 1);
+   for (int i = 0; i < maxGuardedWindows; i++) {
+      if (guardedWindows[i].start.testAndSetOrdered(0, start)) {
+         guardedWindows[i].truncated.storeRelease(0);
+         guardedWindows[i].end.storeRelease(reinterpret_cast<quintptr>(window) + static_cast<quintptr>(length));
+         return i;
+      }
+   }
+   return -1;
+}
+
+/**
+ * @brief isTruncated
+ * @param slot The slot of a guarded window, or -1.
+ * @return True if the file was truncated while the window was read.
+ */
+bool isTruncated(int slot)
+{
+   return slot >= 0 && guardedWindows[slot].truncated.loadAcquire();
+}
+
+/**
+ * @brief releaseWindow
+ * @param slot The slot of a guarded window, freed before the window is unmapped.
+ */
+void releaseWindow(int slot)
+{
+   guardedWindows[slot].end.storeRelease(0);
+   guardedWindows[slot].start.storeRelease(0);
+}
+#endif
+
+#ifdef SEEK_HOLE
+/**
+ * @brief hasHoles
+ * @return True for a regular file with fewer blocks allocated than its size.
+ */
+bool hasHoles(const struct stat& status)
+{
+   return S_ISREG(status.st_mode) && static_cast<qint64>(status.st_blocks) * 512 < static_cast<qint64>(status.st_size);
+}
+#endif
+
+}
+
+/**
+ * @brief FileReader::FileReader
+ * @param mode How the files should be read, see setMode().
+ */
+FileReader::FileReader(Mode mode)
+{
+   requestedMode = mode;
+   activeMode = mode;
+   hints = 0;
+   readaheadWindow = 0;
+   readaheadUntil = 0;
+   sparse = false;
+   dataEnd = 0;
+   filesize = 0;
+   position = 0;
+   remaining = 0;
+   activeSlot = 0;
+   windows[0] = 0;
+   windows[1] = 0;
+   windowGuards[0] = -1;
+   windowGuards[1] = -1;
+   directBuffers[0] = 0;
+   directBuffers[1] = 0;
+}
+
+/**
+ * @brief FileReader::~FileReader
+ */
+FileReader::~FileReader()
+{
+   close();
+   releaseDirectBuffer(directBuffers[0]);
+   releaseDirectBuffer(directBuffers[1]);
+}
+
+/**
+ * @brief FileReader::open
+ * @param filename Full path to the file.
+ * @param offset Where to start reading.
+ * @param length Number of bytes to read, or -1 to read to the end of the file.
+ * @return Empty string if the file was opened, otherwise an error message starting with "ERROR:".
+ *
+ * Closes the previous file. The read buffers are kept, so a reader can be reused for many files.
+ */
+QString FileReader::open(QString filename, qint64 offset, qint64 length)
+{
+   close();
+   lastError.clear();
+   // Unbuffered, as the data is read in large blocks directly into our own buffers.
+   lastError = DirectoryHandles::get().openFile(file, filename);
+   if (!lastError.isEmpty()) {
+      return lastError;
+   }
+   filesize = file.size();
+   activeMode = requestedMode;
+   if (file.isSequential() || filesize == 0) {
+      // Pipes and devices can't be mapped, and files in for example /proc report a size of zero.
+      activeMode = ReadCalls;
+   }
+   if (activeMode == DirectIo && !enableDirectIo()) {
+      activeMode = ReadCalls;
+   }
+   sparse = !file.isSequential() && isSparse(file.handle());
+   dataEnd = 0;
+   if (hints & FileHints::NoAccessTime) {
+      FileHints::setNoAccessTime(file.handle());
+   }
+   readaheadWindow = 0;
+   readaheadUntil = offset;
+   if ((hints & FileHints::Readahead) && activeMode == ReadCalls && !file.isSequential()) {
+      FileHints::adviseSequential(file.handle());
+      readaheadWindow = FileHints::readaheadSize(file.handle());
+   }
+   if (offset > 0 && activeMode == ReadCalls && !file.seek(offset)) {
+      lastError = QString("ERROR: %1").arg(file.errorString());
+      file.close();
+      return lastError;
+   }
+   position = offset;
+   remaining = length;
+   if (activeMode != ReadCalls && length < 0) {
+      remaining = qMax<qint64>(0, filesize - offset);
+   }
+   // The first block goes to the first slot.
+   activeSlot = 1;
+   return lastError;
+}
+
+/**
+ * @brief FileReader::next
+ * @param block Set to the next block of the file.
+ * @return False at the end of the range, or if the reading failed. See error().
+ *
+ * The block is valid until next() has been called twice more, or the reader is closed.
+ */
+bool FileReader::next(Block& block)
+{
+   if (!file.isOpen() || !lastError.isEmpty() || remaining == 0) {
+      return false;
+   }
+   if (sparse && position >= dataEnd) {
+      if (skipHole(block)) {
+         return true;
+      }
+      if (!lastError.isEmpty()) {
+         return false;
+      }
+   }
+   activeSlot ^= 1;
+   if (activeMode == DirectIo) {
+      if (readDirectBlock(block)) {
+         return true;
+      }
+      if (activeMode == DirectIo || !lastError.isEmpty()) {
+         return false;
+      }
+      // The file system refused the direct read, continue with read().
+      if (!file.seek(position)) {
+         lastError = QString("ERROR: %1").arg(file.errorString());
+         return false;
+      }
+   }
+   if (activeMode == MemoryMapped) {
+      unmapWindow(activeSlot);
+      if (mapNextWindow(block)) {
+         return true;
+      }
+      // The window in the other slot stays mapped until it's replaced or the reader is closed.
+      activeMode = ReadCalls;
+      if (!file.seek(position)) {
+         lastError = QString("ERROR: %1").arg(file.errorString());
+         return false;
+      }
+   }
+   return readNextBlock(block);
+}
+
+/**
+ * @brief FileReader::error
+ * @return The error message starting with "ERROR:", empty if the file has been read without errors.
+ */
+QString FileReader::error() const
+{
+#ifdef Q_OS_UNIX
+   // The last windows may still be mapped.
+   if (lastError.isEmpty() && (isTruncated(windowGuards[0]) || isTruncated(windowGuards[1]))) {
+      return truncatedError();
+   }
+#endif
+   return lastError;
+}
+
+/**
+ * @brief FileReader::truncatedError
+ * @return The error for a file truncated while it was mapped.
+ */
+QString FileReader::truncatedError()
+{
+   return QString("ERROR: Unexpected end of file.");
+}
+
+/**
+ * @brief FileReader::close
+ * Closes the file and unmaps the windows. The blocks returned by next() are no longer valid.
+ */
+void FileReader::close()
+{
+   unmapWindow(0);
+   unmapWindow(1);
+   if (file.isOpen()) {
+      file.close();
+   }
+}
+
+/**
+ * @brief FileReader::mapNextWindow
+ * @param block Set to the mapped window.
+ * @return False if the window couldn't be mapped.
+ *
+ * If the file is truncated while mapped, reading the missing pages raises SIGBUS. The
+ * window is guarded so the missing pages read as zeros instead, and error() is set.
+ */
+bool FileReader::mapNextWindow(Block& block)
+{
+   qint64 length = readableLength(remaining < mapWindowSize ? remaining : mapWindowSize);
+   // The kernel is asked to read the whole window.
+   Throttle::get().acquire(length);
+   uchar* window = file.map(position, length);
+   if (!window) {
+      qDebug() << "Mapping failed, reading instead: " << file.errorString();
+      return false;
+   }
+#ifdef Q_OS_UNIX
+   windowGuards[activeSlot] = guardWindow(window, length);
+   if (windowGuards[activeSlot] < 0) {
+      // Too many windows mapped by other readers.
+      file.unmap(window);
+      return false;
+   }
+   // QFile maps from the page boundary before the position, madvise() needs the boundary.
+   quintptr pageSize = static_cast<quintptr>(sysconf(_SC_PAGESIZE));
+   quintptr start = reinterpret_cast<quintptr>(window) & ~(pageSize - 1);
+   size_t adviceLength = static_cast<size_t>(reinterpret_cast<quintptr>(window) - start + length);
+   madvise(reinterpret_cast<void*>(start), adviceLength, MADV_SEQUENTIAL);
+   madvise(reinterpret_cast<void*>(start), adviceLength, MADV_WILLNEED);
+#endif
+   windows[activeSlot] = window;
+   windowOffsets[activeSlot] = position;
+   windowLengths[activeSlot] = length;
+   block.data = reinterpret_cast<const char*>(window);
+   block.length = length;
+   block.hole = false;
+   position += length;
+   remaining -= length;
+   return true;
+}
+
+/**
+ * @brief FileReader::readNextBlock
+ * @param block Set to the buffer the block was read into.
+ * @return False at the end of the file, or if the reading failed.
+ */
+bool FileReader::readNextBlock(Block& block)
+{
+   QByteArray& buffer = buffers[activeSlot];
+   if (buffer.size() != readBlockSize) {
+      buffer.resize(readBlockSize);
+   }
+   qint64 length = readableLength(remaining < 0 ? readBlockSize : qMin<qint64>(remaining, readBlockSize));
+   if (readaheadWindow > 0 && position + readaheadWindow / 2 >= readaheadUntil) {
+      // Keeps the requested data at least half a window ahead of the reading.
+      qint64 start = qMax(position, readaheadUntil);
+      FileHints::readahead(file.handle(), start, position + readaheadWindow - start);
+      readaheadUntil = position + readaheadWindow;
+   }
+   Throttle::get().acquire(length);
+   qint64 bytesRead = file.read(buffer.data(), length);
+   if (bytesRead < 0) {
+      qDebug() << "ERROR: " << file.errorString();
+      lastError = QString("ERROR: %1").arg(file.errorString());
+      return false;
+   }
+   if (bytesRead == 0) {
+      if (remaining > 0) {
+         // The file has been truncated since the size was read.
+         lastError = QString("ERROR: Unexpected end of file.");
+         qDebug() << lastError;
+      }
+      return false;
+   }
+   if (hints & FileHints::DropCache) {
+      // The block has been copied to the buffer.
+      FileHints::dropCache(file.handle(), position, bytesRead);
+   }
+   block.data = buffer.constData();
+   block.length = bytesRead;
+   block.hole = false;
+   position += bytesRead;
+   if (remaining > 0) {
+      remaining -= bytesRead;
+   }
+   return true;
+}
+
+/**
+ * @brief FileReader::unmapWindow
+ * @param slot
+ */
+void FileReader::unmapWindow(int slot)
+{
+   if (windows[slot]) {
+#ifdef Q_OS_UNIX
+      if (windowGuards[slot] >= 0) {
+         if (isTruncated(windowGuards[slot]) && lastError.isEmpty()) {
+            lastError = truncatedError();
+            qDebug() << lastError;
+         }
+         releaseWindow(windowGuards[slot]);
+         windowGuards[slot] = -1;
+      }
+#endif
+      file.unmap(windows[slot]);
+      windows[slot] = 0;
+      if (hints & FileHints::DropCache) {
+         // Mapped pages can't be dropped, so it's done when the window is unmapped.
+         FileHints::dropCache(file.handle(), windowOffsets[slot], windowLengths[slot]);
+      }
+   }
+}
+
+/**
+ * @brief FileReader::enableDirectIo
+ * @return False if the file system doesn't support bypassing the page cache.
+ */
+bool FileReader::enableDirectIo()
+{
+#if defined(Q_OS_LINUX)
+   int flags = fcntl(file.handle(), F_GETFL);
+   return flags != -1 && fcntl(file.handle(), F_SETFL, flags | O_DIRECT) != -1;
+#elif defined(Q_OS_MACOS)
+   return fcntl(file.handle(), F_NOCACHE, 1) != -1;
+#else
+   return false;
+#endif
+}
+
+/**
+ * @brief FileReader::disableDirectIo
+ * Switches back to reading through the page cache, from the current position.
+ */
+void FileReader::disableDirectIo()
+{
+#if defined(Q_OS_LINUX)
+   int flags = fcntl(file.handle(), F_GETFL);
+   if (flags != -1) {
+      fcntl(file.handle(), F_SETFL, flags & ~O_DIRECT);
+   }
+#elif defined(Q_OS_MACOS)
+   fcntl(file.handle(), F_NOCACHE, 0);
+#endif
+   activeMode = ReadCalls;
+}
+
+/**
+ * @brief FileReader::readDirectBlock
+ * @param block Set to the requested part of the aligned buffer.
+ * @return False at the end of the range, if the reading failed, or if the file system
+ * refused the direct read. In the last case the mode has been changed to ReadCalls.
+ *
+ * The request starts at the alignment boundary before the position and is rounded up to
+ * the alignment, the bytes outside the range are skipped. Reads past the end of the file
+ * return what's left, so the unaligned tail of a file is read like any other block.
+ */
+bool FileReader::readDirectBlock(Block& block)
+{
+#ifdef Q_OS_UNIX
+   char*& buffer = directBuffers[activeSlot];
+   if (!buffer) {
+      buffer = acquireDirectBuffer();
+   }
+   qint64 alignedPosition = position & ~qint64(directAlignment - 1);
+   qint64 skip = position - alignedPosition;
+   qint64 wanted = readableLength(remaining);
+   qint64 requested = qMin<qint64>(directBlockSize, (skip + wanted + directAlignment - 1) & ~qint64(directAlignment - 1));
+   Throttle::get().acquire(requested);
+   ssize_t bytesRead;
+   do {
+      bytesRead = pread(file.handle(), buffer, static_cast<size_t>(requested), alignedPosition);
+   } while (bytesRead < 0 && errno == EINTR);
+   if (bytesRead < 0) {
+      if (errno == EINVAL) {
+         qDebug() << "Direct reading refused, reading through the cache instead: " << file.fileName();
+         disableDirectIo();
+         return false;
+      }
+      lastError = QString("ERROR: %1").arg(qt_error_string(errno));
+      qDebug() << lastError;
+      return false;
+   }
+   if (bytesRead <= skip) {
+      // The file has been truncated since the size was read.
+      lastError = QString("ERROR: Unexpected end of file.");
+      qDebug() << lastError;
+      return false;
+   }
+   block.data = buffer + skip;
+   block.length = qMin<qint64>(bytesRead - skip, wanted);
+   block.hole = false;
+   position += block.length;
+   remaining -= block.length;
+   return true;
+#else
+   Q_UNUSED(block);
+   disableDirectIo();
+   return false;
+#endif
+}
+
+/**
+ * @brief FileReader::isSparse
+ * @param handle File descriptor of an opened file.
+ * @return True if the file has fewer blocks allocated than its size, so it likely has holes.
+ *
+ * Compressed files also have fewer blocks, the lookups then simply don't find any holes.
+ */
+bool FileReader::isSparse(int handle)
+{
+#ifdef SEEK_HOLE
+   struct stat status;
+   return fstat(handle, &status) == 0 && hasHoles(status);
+#else
+   Q_UNUSED(handle);
+   return false;
+#endif
+}
+
+/**
+ * @brief FileReader::skipHole
+ * @param block Set to the hole at the position, if there is one.
+ * @return True if the position is in a hole. Otherwise the position is in data,
+ * and dataEnd is set to where the data ends.
+ *
+ * The holes are found with SEEK_DATA and SEEK_HOLE. If the file system doesn't
+ * support them, the rest of the file is read like any other file.
+ */
+bool FileReader::skipHole(Block& block)
+{
+#ifdef SEEK_HOLE
+   bool hole = false;
+   qint64 rangeEnd = remaining < 0 ? filesize : position + remaining;
+   off_t data = lseek(file.handle(), position, SEEK_DATA);
+   if (data < 0 && errno != ENXIO) {
+      sparse = false;
+   } else {
+      // ENXIO means there's no data after the position, the rest of the file is a hole.
+      qint64 holeEnd = qMin<qint64>(data < 0 ? rangeEnd : data, rangeEnd);
+      if (holeEnd > position) {
+         block.data = 0;
+         block.length = holeEnd - position;
+         block.hole = true;
+         position = holeEnd;
+         if (remaining > 0) {
+            remaining -= block.length;
+         }
+         hole = true;
+      } else {
+         off_t end = lseek(file.handle(), position, SEEK_HOLE);
+         dataEnd = end > position ? end : std::numeric_limits<qint64>::max();
+      }
+   }
+   // The lookups move the file offset, the reads continue from the position.
+   if (activeMode == ReadCalls && !file.seek(position)) {
+      lastError = QString("ERROR: %1").arg(file.errorString());
+      return false;
+   }
+   return hole;
+#else
+   Q_UNUSED(block);
+   sparse = false;
+   return false;
+#endif
+}
+
+/**
+ * @brief FileReader::readableLength
+ * @param length Number of bytes to read.
+ * @return The length, shortened to end where the data does in a sparse file.
+ */
+qint64 FileReader::readableLength(qint64 length) const
+{
+   return sparse ? qMin(length, dataEnd - position) : length;
+}
+
+/**
+ * @brief FileReader::acquireDirectBuffer
+ * @return An aligned buffer of directBlockSize bytes, see releaseDirectBuffer().
+ */
+char* FileReader::acquireDirectBuffer()
+{
+   QMutexLocker locker(&directBufferMutex);
+   if (!directBufferPool.isEmpty()) {
+      return directBufferPool.takeLast();
+   }
+   return static_cast<char*>(qMallocAligned(directBlockSize, directAlignment));
+}
+
+/**
+ * @brief FileReader::releaseDirectBuffer
+ * @param buffer Returned to the pool, or freed if the pool is full.
+ */
+void FileReader::releaseDirectBuffer(char* buffer)
+{
+   if (!buffer) {
+      return;
+   }
+   QMutexLocker locker(&directBufferMutex);
+   if (directBufferPool.size() < maxPooledDirectBuffers) {
+      directBufferPool.append(buffer);
+   } else {
+      qFreeAligned(buffer);
+   }
+}
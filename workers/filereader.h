@@ -0,0 +1,115 @@
+/**
+ * Reads a file, or a range of it, block by block for the hashing algorithms.
+ *
+ * In the ReadCalls mode the blocks are read with read() into two buffers owned
+ * by the reader. In the MemoryMapped mode the file is mapped in large windows
+ * and the blocks point directly into the mapping, so the data is hashed from the
+ * page cache without being copied. The mapping is hinted as sequential, and the
+ * kernel is asked to start reading the whole window ahead of the hashing. A file
+ * truncated by another program while it's mapped would crash the program with
+ * SIGBUS, so a handler replaces the missing pages by zeros and the read fails.
+ * In the DirectIo mode the page cache is bypassed (O_DIRECT on Linux, F_NOCACHE on
+ * macOS), so scrubbing large archives doesn't evict the data other programs on the
+ * host are using. The requests are large and aligned, and go into aligned buffers
+ * taken from a pool shared by all readers. Ranges that don't start or end on the
+ * alignment are read from the surrounding aligned blocks.
+ * Special files such as pipes and devices, files reporting a size of zero and
+ * files that can't be mapped or read directly are read with read() instead.
+ *
+ * The hints in FileHints can be enabled with setHints(). Readahead is used in the
+ * ReadCalls mode, the other modes already read ahead. The dropped cache covers
+ * the blocks that have been read, and the windows when they're unmapped.
+ *
+ * Sparse files, with fewer blocks allocated than their size, are read extent by
+ * extent with SEEK_DATA and SEEK_HOLE. The holes are returned as blocks without
+ * data, to be fed to HashAlgorithm::Context::updateZeros(), so they're never read.
+ *
+ * The reads are limited by the Throttle, the holes aren't read and don't count.
+ *
+ * A block stays valid until next() has been called twice more, which lets the
+ * previous block be hashed on other threads while the next one is read.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef FILEREADER_H
+#define FILEREADER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+#include "algorithms/blocksource.h"
+
+class FileReader : public BlockSource
+{
+public:
+   // The numbers are stored in the settings.
+   enum Mode {
+      ReadCalls = 0,
+      MemoryMapped = 1,
+      DirectIo = 2
+   };
+
+   static const int readBlockSize = 1024 * 1024;
+   // Size of the mapped windows, a multiple of readBlockSize.
+   static const qint64 mapWindowSize = Q_INT64_C(64) * 1024 * 1024;
+   static const int directBlockSize = 8 * 1024 * 1024;
+   // Covers the logical block size of all common devices.
+   static const int directAlignment = 4096;
+
+   explicit FileReader(Mode mode=ReadCalls);
+   ~FileReader();
+
+   void setMode(Mode mode) { requestedMode = mode; }
+   // A combination of FileHints::Hint.
+   void setHints(int hints) { this->hints = hints; }
+   QString open(QString filename, qint64 offset=0, qint64 length=-1);
+   bool next(Block& block);
+   void close();
+
+   QString error() const;
+   qint64 size() const { return filesize; }
+
+   static bool isSparse(int handle);
+
+private:
+   bool mapNextWindow(Block& block);
+   bool readNextBlock(Block& block);
+   void unmapWindow(int slot);
+   bool enableDirectIo();
+   void disableDirectIo();
+   bool readDirectBlock(Block& block);
+   bool skipHole(Block& block);
+   qint64 readableLength(qint64 length) const;
+   static QString truncatedError();
+   static char* acquireDirectBuffer();
+   static void releaseDirectBuffer(char* buffer);
+
+   Mode requestedMode;
+   Mode activeMode;
+   int hints;
+   QFile file;
+   qint64 filesize;
+   qint64 position;
+   // Bytes left of the requested range, -1 if the file is read to the end.
+   qint64 remaining;
+   QString lastError;
+   // The readahead hints have been given up to readaheadUntil, 0 if not used.
+   qint64 readaheadWindow;
+   qint64 readaheadUntil;
+   // Holes are skipped in sparse files, the data from the position continues to dataEnd.
+   bool sparse;
+   qint64 dataEnd;
+   // The last two blocks, in either buffers or windows.
+   int activeSlot;
+   QByteArray buffers[2];
+   uchar* windows[2];
+   qint64 windowOffsets[2];
+   qint64 windowLengths[2];
+   // The slots of the windows known to the SIGBUS handler, -1 if not mapped.
+   int windowGuards[2];
+   char* directBuffers[2];
+};
+
+#endif // FILEREADER_H
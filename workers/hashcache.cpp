@@ -0,0 +1,342 @@
+/**
+ * Remembers the hash sums of files that haven't changed since they were hashed.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(Q_OS_LINUX) || defined(Q_OS_MACOS)
+#include <sys/xattr.h>
+#endif
+
+#include "directoryhandles.h"
+#include "hashcache.h"
+
+namespace {
+
+// Starts every record, so torn records are found.
+const quint32 recordMagic = 0x484d4331;
+// The file is rewritten when it holds this many more records than entries.
+const int rewriteSlack = 10000;
+// Followed by the name of the algorithm.
+const char attributePrefix[] = "user.hashman.";
+// The size and modification time of the file, and the hash sum in hex.
+const int maximumAttributeLength = 64 + 2 * HashDigest::maxLength;
+
+}
+
+/**
+ * @brief HashCache::get
+ * @return The cache shared by all hashers.
+ */
+HashCache& HashCache::get()
+{
+   static HashCache hashCache;
+   return hashCache;
+}
+
+/**
+ * @brief HashCache::HashCache
+ * The file is loaded when the cache is first used.
+ */
+HashCache::HashCache()
+{
+   loaded = false;
+}
+
+/**
+ * @brief HashCache::key
+ * @param filename Full path to the file.
+ * @param stores Where to find and store the hash sums of the file, a combination of Store.
+ * @return The key of the file as it is now, not valid if it isn't a regular file or can't be found.
+ *
+ * Must be taken before the file is read, so changes while it's read give a different key.
+ */
+HashCache::Key HashCache::key(QString filename, int stores)
+{
+   Key key;
+   if (stores == 0) {
+      return key;
+   }
+   key.filename = filename;
+   key.stores = stores;
+#ifdef Q_OS_UNIX
+   struct stat status;
+   if (!DirectoryHandles::get().status(filename, &status) || !S_ISREG(status.st_mode)) {
+      return key;
+   }
+   key.device = status.st_dev;
+   key.inode = status.st_ino;
+   key.size = status.st_size;
+#ifdef Q_OS_MACOS
+   key.modified = Q_INT64_C(1000000000) * status.st_mtimespec.tv_sec + status.st_mtimespec.tv_nsec;
+   key.changed = Q_INT64_C(1000000000) * status.st_ctimespec.tv_sec + status.st_ctimespec.tv_nsec;
+#else
+   key.modified = Q_INT64_C(1000000000) * status.st_mtim.tv_sec + status.st_mtim.tv_nsec;
+   key.changed = Q_INT64_C(1000000000) * status.st_ctim.tv_sec + status.st_ctim.tv_nsec;
+#endif
+#else
+   Q_UNUSED(filename);
+#endif
+   return key;
+}
+
+/**
+ * @brief HashCache::find
+ * @param key The key of the file.
+ * @param algorithms The hash sums wanted.
+ * @return The hash sums keyed by algorithm name, empty unless all of them are cached.
+ *
+ * Looks in the cache file first, then in the attributes of the file.
+ */
+QMap<QString, HashDigest> HashCache::find(const Key& key, const QStringList& algorithms)
+{
+   QMap<QString, HashDigest> hashes;
+   if (!key.isValid()) {
+      return hashes;
+   }
+   if (key.stores & CacheFile) {
+      QMutexLocker locker(&mutex);
+      load();
+      foreach (QString algorithm, algorithms) {
+         QHash<QByteArray, HashDigest>::const_iterator found = entries.constFind(entryKey(key, algorithm));
+         if (found == entries.constEnd()) {
+            hashes.clear();
+            break;
+         }
+         hashes[algorithm] = found.value();
+      }
+   }
+   if (hashes.isEmpty() && (key.stores & Attributes)) {
+      hashes = readAttributes(key, algorithms);
+   }
+   return hashes;
+}
+
+/**
+ * @brief HashCache::store
+ * @param key The key of the file, taken before it was read.
+ * @param hashes The hash sums keyed by algorithm name.
+ */
+void HashCache::store(const Key& key, const QMap<QString, HashDigest>& hashes)
+{
+   if (!key.isValid()) {
+      return;
+   }
+   Key cacheKey = key;
+   if (key.stores & Attributes) {
+      writeAttributes(key, hashes);
+      if (key.stores & CacheFile) {
+         // Writing the attributes changed the status change time, the contents must be as when read.
+         Key current = HashCache::key(key.filename, key.stores);
+         if (current.device != key.device || current.inode != key.inode || current.size != key.size ||
+             current.modified != key.modified) {
+            return;
+         }
+         cacheKey.changed = current.changed;
+      }
+   }
+   if (!(key.stores & CacheFile)) {
+      return;
+   }
+   QMutexLocker locker(&mutex);
+   load();
+   QByteArray records;
+   for (QMap<QString, HashDigest>::const_iterator i = hashes.constBegin(); i != hashes.constEnd(); ++i) {
+      if (i.value().isEmpty()) {
+         continue;
+      }
+      QByteArray newKey = entryKey(cacheKey, i.key());
+      QHash<QByteArray, HashDigest>::const_iterator found = entries.constFind(newKey);
+      if (found != entries.constEnd() && found.value() == i.value()) {
+         continue;
+      }
+      entries.insert(newKey, i.value());
+      records.append(record(newKey, i.value()));
+   }
+   if (!records.isEmpty() && file.isOpen() && file.write(records) != records.size()) {
+      qDebug() << "ERROR: Can't write the hash cache: " << file.errorString();
+      file.close();
+   }
+}
+
+/**
+ * @brief HashCache::load
+ * Reads the file into memory the first time, and opens it for appending.
+ * Called with the mutex locked.
+ */
+void HashCache::load()
+{
+   if (loaded) {
+      return;
+   }
+   loaded = true;
+#ifdef Q_OS_UNIX
+   QString directory = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+   if (directory.isEmpty() || !QDir().mkpath(directory)) {
+      return;
+   }
+   file.setFileName(directory + "/hashcache");
+   int records = 0;
+   bool torn = false;
+   if (file.open(QFile::ReadOnly)) {
+      QDataStream stream(&file);
+      while (!stream.atEnd()) {
+         quint32 magic;
+         QByteArray key;
+         QByteArray digest;
+         stream >> magic >> key >> digest;
+         if (stream.status() != QDataStream::Ok || magic != recordMagic || digest.size() > HashDigest::maxLength) {
+            torn = true;
+            break;
+         }
+         entries.insert(key, HashDigest(reinterpret_cast<const uchar*>(digest.constData()), digest.size()));
+         records++;
+      }
+      file.close();
+   }
+   if (torn || records > entries.size() + rewriteSlack) {
+      rewrite();
+   }
+   // Unbuffered, so each record is added in a single write.
+   if (!file.open(QFile::WriteOnly | QFile::Append | QFile::Unbuffered)) {
+      qDebug() << "ERROR: Can't open the hash cache: " << file.errorString();
+   }
+#endif
+}
+
+/**
+ * @brief HashCache::rewrite
+ * Replaces the file with one record for each entry.
+ */
+void HashCache::rewrite()
+{
+   QSaveFile newFile(file.fileName());
+   if (!newFile.open(QFile::WriteOnly)) {
+      return;
+   }
+   for (QHash<QByteArray, HashDigest>::const_iterator i = entries.constBegin(); i != entries.constEnd(); ++i) {
+      newFile.write(record(i.key(), i.value()));
+   }
+   newFile.commit();
+}
+
+/**
+ * @brief HashCache::entryKey
+ * @param key The key of the file.
+ * @param algorithm Name of the algorithm.
+ * @return The key of the entry, in the byte order of the machine.
+ */
+QByteArray HashCache::entryKey(const Key& key, const QString& algorithm)
+{
+   const quint64 fields[] = {
+      key.device, key.inode, static_cast<quint64>(key.size),
+      static_cast<quint64>(key.modified), static_cast<quint64>(key.changed)
+   };
+   QByteArray entry(reinterpret_cast<const char*>(fields), sizeof(fields));
+   entry.append(algorithm.toUtf8());
+   return entry;
+}
+
+/**
+ * @brief HashCache::record
+ * @param entryKey The key of the entry.
+ * @param digest The hash sum.
+ * @return The record as stored in the file.
+ */
+QByteArray HashCache::record(const QByteArray& entryKey, const HashDigest& digest)
+{
+   QByteArray record;
+   QDataStream stream(&record, QIODevice::WriteOnly);
+   stream << recordMagic << entryKey << QByteArray(reinterpret_cast<const char*>(digest.data()), digest.size());
+   return record;
+}
+
+/**
+ * @brief HashCache::readAttributes
+ * @param key The key of the file.
+ * @param algorithms The hash sums wanted.
+ * @return The hash sums keyed by algorithm name, empty unless all of them are
+ * stored in attributes matching the size and modification time of the file.
+ */
+QMap<QString, HashDigest> HashCache::readAttributes(const Key& key, const QStringList& algorithms)
+{
+   QMap<QString, HashDigest> hashes;
+#if defined(Q_OS_LINUX) || defined(Q_OS_MACOS)
+   int fd = DirectoryHandles::get().open(key.filename, O_RDONLY | O_NONBLOCK);
+   if (fd < 0) {
+      return hashes;
+   }
+   QByteArray expected = QByteArray::number(key.size) + ' ' + QByteArray::number(key.modified) + ' ';
+   foreach (QString algorithm, algorithms) {
+      QByteArray name = attributePrefix + algorithm.toUtf8();
+      char value[maximumAttributeLength];
+#ifdef Q_OS_MACOS
+      ssize_t length = fgetxattr(fd, name.constData(), value, sizeof(value), 0, 0);
+#else
+      ssize_t length = fgetxattr(fd, name.constData(), value, sizeof(value));
+#endif
+      QByteArray attribute = length > 0 ? QByteArray(value, static_cast<int>(length)) : QByteArray();
+      HashDigest digest;
+      if (attribute.startsWith(expected)) {
+         digest = HashDigest::fromHex(QString::fromLatin1(attribute.mid(expected.size())));
+      }
+      if (digest.isEmpty()) {
+         hashes.clear();
+         break;
+      }
+      hashes[algorithm] = digest;
+   }
+   close(fd);
+#else
+   Q_UNUSED(key);
+   Q_UNUSED(algorithms);
+#endif
+   return hashes;
+}
+
+/**
+ * @brief HashCache::writeAttributes
+ * @param key The key of the file, taken before it was read.
+ * @param hashes The hash sums keyed by algorithm name, stored with the size and modification time in the key.
+ */
+void HashCache::writeAttributes(const Key& key, const QMap<QString, HashDigest>& hashes)
+{
+#if defined(Q_OS_LINUX) || defined(Q_OS_MACOS)
+   int fd = DirectoryHandles::get().open(key.filename, O_RDONLY | O_NONBLOCK);
+   if (fd < 0) {
+      return;
+   }
+   QByteArray prefix = QByteArray::number(key.size) + ' ' + QByteArray::number(key.modified) + ' ';
+   for (QMap<QString, HashDigest>::const_iterator i = hashes.constBegin(); i != hashes.constEnd(); ++i) {
+      if (i.value().isEmpty()) {
+         continue;
+      }
+      QByteArray name = attributePrefix + i.key().toUtf8();
+      QByteArray value = prefix + i.value().toHex().toLatin1();
+#ifdef Q_OS_MACOS
+      int result = fsetxattr(fd, name.constData(), value.constData(), value.size(), 0, 0);
+#else
+      int result = fsetxattr(fd, name.constData(), value.constData(), value.size(), 0);
+#endif
+      if (result != 0) {
+         // Read-only, not permitted or not supported, no use trying the other algorithms.
+         break;
+      }
+   }
+   close(fd);
+#else
+   Q_UNUSED(key);
+   Q_UNUSED(hashes);
+#endif
+}
@@ -0,0 +1,87 @@
+/**
+ * Remembers the hash sums of files that haven't changed since they were hashed.
+ *
+ * The hash sums are stored by the device, inode, size, modification time and
+ * status change time of the file, and the algorithm. If any of them differ the
+ * file is hashed again, so a tree where little has changed since the last run
+ * only needs its metadata read, not the contents of the files. The times are
+ * stored in nanoseconds.
+ *
+ * The cache is an append-only file in the application data directory, loaded
+ * into memory when first used. New hash sums are appended as records, each in a
+ * single write, so several instances can share the file. Records torn by a crash
+ * end the loading, and the file is then rewritten with the entries read so far,
+ * as it is when it holds many more records than entries.
+ *
+ * The hash sums can also be stored with the files themselves, in extended
+ * attributes named user.hashman.<algorithm>, holding the size and modification
+ * time of the file along with the hash sum. They travel with the data, so other
+ * machines and instances reading the same storage can use them. The inode and
+ * status change time aren't part of them, as they differ between machines and
+ * writing the attribute changes the status change time. Attributes that can't be
+ * written, for lack of permissions or support, are skipped. Attributes are only
+ * supported on Linux and macOS.
+ *
+ * Only regular files are cached, and only on Unix.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef HASHCACHE_H
+#define HASHCACHE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+#include "algorithms/hashdigest.h"
+
+class HashCache
+{
+public:
+   // Where the hash sums are stored, combined in the keys.
+   enum Store {
+      CacheFile = 1,
+      Attributes = 2
+   };
+
+   struct Key {
+      Key() : stores(0), device(0), inode(0), size(-1), modified(0), changed(0) {}
+      bool isValid() const { return stores != 0 && size >= 0; }
+
+      QString filename;
+      int stores;
+      quint64 device;
+      quint64 inode;
+      qint64 size;
+      qint64 modified;
+      qint64 changed;
+   };
+
+   static HashCache& get();
+   static Key key(QString filename, int stores);
+
+   QMap<QString, HashDigest> find(const Key& key, const QStringList& algorithms);
+   void store(const Key& key, const QMap<QString, HashDigest>& hashes);
+
+private:
+   HashCache();
+   void load();
+   void rewrite();
+   static QByteArray entryKey(const Key& key, const QString& algorithm);
+   static QByteArray record(const QByteArray& entryKey, const HashDigest& digest);
+   static QMap<QString, HashDigest> readAttributes(const Key& key, const QStringList& algorithms);
+   static void writeAttributes(const Key& key, const QMap<QString, HashDigest>& hashes);
+
+   QMutex mutex;
+   bool loaded;
+   // Opened for appending once loaded, closed if the file can't be written.
+   QFile file;
+   QHash<QByteArray, HashDigest> entries;
+};
+
+#endif // HASHCACHE_H
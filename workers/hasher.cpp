@@ -1,6 +1,20 @@
 /**
  * Manages the different hash calculation algorithms.
  *
+ * Reads the files block by block and feeds the data to a hashing context
+ * created by the selected algorithm, see AlgorithmRegistry. With a single
+ * algorithm the read loop is specialized for it. When several algorithms are
+ * selected, each file is only read once and every block is fed to all of them.
+ * Small files are collected in batches and hashed several at once with
+ * MultiBufferHash, when the processor supports it. Large files are split
+ * into ranges hashed on separate cores when the algorithms can combine them.
+ * The other files of a project are grouped by the device they're stored on, and
+ * the devices are read in parallel, each by its own threads, see DeviceScheduler.
+ * With a read queue depth above one, the files of a device are read by a
+ * ReadPipeline, which reads the next files while the current one is hashed.
+ * The files can be read in the order they're stored, which is much faster
+ * on rotational disks than the order they were found in.
+ *
  * While it's not a requirement, this class was designed for and
  * benefits from running in a separate QThread.
  * When in multithreaded mode, other threads can abort the scanning
@@ -9,11 +23,16 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 #include <QDir>
+#include <QDebug>
+#include <QFutureSynchronizer>
+#include <QtConcurrent>
+#include <algorithm>
 
 #include "hashproject/hashproject.h"
 #include "hashproject/filelist.h"
-#include "algorithms/crc32algorithm.h"
-#include "algorithms/qtcryptoalgorithms.h"
+#include "algorithms/multibufferhash.h"
+#include "workers/directoryhandles.h"
+#include "workers/readpipeline.h"
 #include "hasher.h"
 
 /**
@@ -21,21 +40,10 @@
  */
 Hasher::Hasher()
 {
-   crc32algorithm = new Crc32algorithm;
-   qtcryptoalgorithms = new QtCryptoAlgorithms;
-   aborted = false;
+   aborted.storeRelease(0);
    scanFinishedSent = true;
 }
 
-/**
- * @brief Hasher::~Hasher
- */
-Hasher::~Hasher()
-{
-   delete crc32algorithm;
-   delete qtcryptoalgorithms;
-}
-
 /**
  * @brief Hasher::hashProject
  * @param hashproject The hash project with the hash sums.
@@ -48,56 +56,261 @@ Hasher::~Hasher()
 void Hasher::hashProject(HashProject *hashproject, bool verify, QString basepath)
 {
    startProcessWork();
-   HashProject::Settings settings = hashproject->getSettings();
-   QString algorithm = settings.algorithm;
-   HashAlgorithm* hashalgorithm = crc32algorithm;
-   if (algorithm != "CRC32") {
-      hashalgorithm = qtcryptoalgorithms;
-   }
-   if (!hashproject || !hashalgorithm) {
+   if (!hashproject) {
       scanFinished();
       return;
    }
+   HashProject::Settings settings = hashproject->getSettings();
    if (basepath.right(1) != QDir::separator()) {
       basepath += QDir::separator();
    }
-   const QTableWidget* filelist = hashproject->getDataTable();
-   for (int i=0; i<filelist->rowCount(); i++) {
-      if (aborted) {
-         scanFinished();
-         return;
-      }
+   const FileList* filelist = hashproject->getDataTable();
+   finishedRows = 0;
+   // The small files are hashed in batches, and the other files device by device,
+   // once all files have been gone through.
+   QList<SmallFile> smallFiles;
+   QMap<quint64, DeviceQueue*> devices;
+   for (int i=0; i<filelist->rowCount() && !aborted.loadAcquire(); i++) {
       QString filename = filelist->item(i, 0)->text();
       if (QFileInfo(filename).isRelative()) {
          filename.prepend(basepath);
       }
-      QString previousHash = filelist->item(i, 2)->text();
+      QMap<QString, HashDigest> previousHashes = filelist->getHashes(i);
       QString previousVerify = filelist->item(i, 3)->text();
       QString previousAlgorithm = filelist->item(i, 5)->text();
-      if ((verify && !previousHash.isEmpty() && previousVerify.isEmpty()) ||
-          (!verify && previousHash.isEmpty())) {
+      if ((verify && !previousHashes.isEmpty() && previousVerify.isEmpty()) ||
+          (!verify && previousHashes.isEmpty())) {
+         QStringList algorithms = settings.algorithms;
          if (verify) {
-            if (previousAlgorithm == "CRC32") {
-               hashalgorithm = crc32algorithm;
-            } else {
-               hashalgorithm = qtcryptoalgorithms;
+            // Verify all hash sums the file has, starting with the primary one.
+            algorithms = previousHashes.keys();
+            if (algorithms.removeAll(previousAlgorithm) > 0) {
+               algorithms.prepend(previousAlgorithm);
+            }
+         }
+         QString error;
+         AlgorithmList selected = findAlgorithms(algorithms, error);
+         HashCache::Key cacheKey;
+         if (error.isEmpty()) {
+            cacheKey = HashCache::key(filename, cacheStores(settings, verify));
+            QMap<QString, HashDigest> cachedHashes = HashCache::get().find(cacheKey, algorithms);
+            if (!cachedHashes.isEmpty()) {
+               reportHashes(i, algorithms, cachedHashes, QString(), verify);
+               rowsFinished(1);
+               continue;
             }
-            algorithm = previousAlgorithm;
          }
-         QString hash = hashalgorithm->hashFile(filename, algorithm);
-         emit fileHashCalculated(i, algorithm, hash, verify);
+         QVariant displayedSize = filelist->item(i, 1)->data(Qt::DisplayRole);
+         qint64 filesize = displayedSize.isValid() ? displayedSize.toLongLong() : QFileInfo(filename).size();
+         if (useMultiBuffer(selected) && filesize < smallFileLimit) {
+            SmallFile smallFile = { i, filename, algorithms, cacheKey };
+            smallFiles.append(smallFile);
+         } else {
+            DeviceFile deviceFile = { i, filename, algorithms, filesize, cacheKey };
+            queueDeviceFile(devices, deviceFile, settings);
+         }
+      } else {
+         rowsFinished(1);
+      }
+   }
+   if (settings.physicalorder && !aborted.loadAcquire()) {
+      sortByLocation(smallFiles);
+      foreach (DeviceQueue* queue, devices) {
+         sortByLocation(queue->files);
+      }
+   }
+   // The files in a batch must use the same algorithms.
+   QList<SmallFile> batch;
+   QList<DeviceFile> grownFiles;
+   for (int i = 0; i < smallFiles.size() && !aborted.loadAcquire(); i++) {
+      batch.append(smallFiles.at(i));
+      if (i + 1 == smallFiles.size() || smallFiles.at(i + 1).algorithms != batch.first().algorithms ||
+          batch.size() >= MultiBufferHash::lanes() * smallFileBatchesPerLane) {
+         int grownCount = grownFiles.size();
+         hashSmallFiles(batch, verify, settings, grownFiles);
+         rowsFinished(batch.size() - (grownFiles.size() - grownCount));
+         batch.clear();
+      }
+   }
+   // Files that have grown since they were found are read like the other large files.
+   foreach (const DeviceFile& grownFile, grownFiles) {
+      queueDeviceFile(devices, grownFile, settings);
+   }
+
+   // Each device is read by the threads of its own pool, so the devices are read in parallel.
+   bool pipelined = settings.queuedepth > 1 && settings.readmode != FileReader::MemoryMapped;
+   QFutureSynchronizer<void> workers;
+   foreach (DeviceQueue* queue, devices) {
+      QThreadPool* pool = scheduler.pool(queue->device);
+      if (pipelined) {
+         workers.addFuture(QtConcurrent::run(pool, [this, queue, &settings, verify]() {
+            pipelineDeviceFiles(queue, settings, verify);
+         }));
+         continue;
       }
-      emit progressstatus(i+1);
+      for (int i = 0; i < queue->device.threads; i++) {
+         workers.addFuture(QtConcurrent::run(pool, [this, queue, &settings, verify]() {
+            hashDeviceFiles(queue, settings, verify);
+         }));
+      }
+   }
+   workers.waitForFinished();
+   qDeleteAll(devices);
+   DirectoryHandles::get().closeAll();
+   if (!aborted.loadAcquire()) {
+      emit progressstatus(filelist->rowCount());
    }
    scanFinished();
 }
 
+/**
+ * @brief Hasher::findDevice
+ * @param filename Full path to the file.
+ * @param settings
+ * @return The device the file is stored on, or a single device for all files if the devices aren't read in parallel.
+ */
+DeviceScheduler::Device Hasher::findDevice(QString filename, const HashProject::Settings& settings)
+{
+   if (!settings.devicescheduling) {
+      return DeviceScheduler::unscheduled(settings.queuedepth);
+   }
+   return scheduler.find(filename);
+}
+
+/**
+ * @brief Hasher::queueDeviceFile
+ * @param devices The queues of the devices, a queue is added for a new device.
+ * @param file Added to the queue of the device it's stored on.
+ * @param settings
+ */
+void Hasher::queueDeviceFile(QMap<quint64, DeviceQueue*>& devices, const DeviceFile& file, const HashProject::Settings& settings)
+{
+   DeviceScheduler::Device device = findDevice(file.filename, settings);
+   DeviceQueue*& queue = devices[device.id];
+   if (!queue) {
+      queue = new DeviceQueue;
+      queue->device = device;
+   }
+   queue->files.append(file);
+}
+
+/**
+ * @brief Hasher::hashDeviceFiles
+ * @param queue The files on the device.
+ * @param settings How the files are read.
+ * @param verify Pass-trough to the signals.
+ *
+ * Runs on each of the threads of the device, which take the next file from the queue
+ * until all of them have been hashed.
+ */
+void Hasher::hashDeviceFiles(DeviceQueue* queue, const HashProject::Settings& settings, bool verify)
+{
+   FileReader fileReader;
+   int index;
+   while (!aborted.loadAcquire() && (index = queue->next.fetchAndAddRelaxed(1)) < queue->files.size()) {
+      const DeviceFile& file = queue->files.at(index);
+      QString error;
+      QMap<QString, HashDigest> hashes = calculateHashes(fileReader, file.filename, file.algorithms, settings, queue->device, error);
+      reportHashes(file.row, file.algorithms, hashes, error, verify, file.cacheKey);
+      rowsFinished(1);
+   }
+}
+
+/**
+ * @brief Hasher::pipelineDeviceFiles
+ * @param queue The files on the device.
+ * @param settings How the files are read.
+ * @param verify Pass-trough to the signals.
+ *
+ * Reads the files on the device with a ReadPipeline, with no more reads at the same
+ * time than the device allows. Files split into ranges are hashed directly instead,
+ * as are sparse files once the pipeline has found them.
+ */
+void Hasher::pipelineDeviceFiles(DeviceQueue* queue, const HashProject::Settings& settings, bool verify)
+{
+   int queueDepth = qMin(settings.queuedepth, queue->device.concurrency);
+   ReadPipeline pipeline(queueDepth, settings.readmode == FileReader::DirectIo, settings.filehints);
+   FileReader fileReader;
+   QList<PipelinedFile> pipelinedFiles;
+   foreach (const DeviceFile& file, queue->files) {
+      if (aborted.loadAcquire()) {
+         break;
+      }
+      QString error;
+      AlgorithmList selected = findAlgorithms(file.algorithms, error);
+      if (!error.isEmpty() || splitIntoRanges(file.filesize, selected, settings, queue->device)) {
+         QMap<QString, HashDigest> hashes = calculateHashes(fileReader, file.filename, file.algorithms, settings, queue->device, error);
+         reportHashes(file.row, file.algorithms, hashes, error, verify, file.cacheKey);
+         rowsFinished(1);
+         continue;
+      }
+      PipelinedFile pipelinedFile = { file.row, file.filename, file.algorithms, QList<HashAlgorithm::Context*>(), file.cacheKey };
+      foreach (const AlgorithmRegistry::Algorithm* algorithm, selected) {
+         pipelinedFile.contexts.append(algorithm->createContext());
+      }
+      pipeline.addFile(file.filename);
+      pipelinedFiles.append(pipelinedFile);
+      // The following files are read while the oldest one is hashed.
+      while (pipelinedFiles.size() > queueDepth) {
+         hashPipelinedFile(pipeline, fileReader, pipelinedFiles.takeFirst(), settings, queue->device, verify);
+         rowsFinished(1);
+      }
+   }
+   while (!pipelinedFiles.isEmpty() && !aborted.loadAcquire()) {
+      hashPipelinedFile(pipeline, fileReader, pipelinedFiles.takeFirst(), settings, queue->device, verify);
+      rowsFinished(1);
+   }
+   // When aborted, the reads in progress are finished and dropped before the buffers are freed.
+   pipeline.cancelAll();
+   foreach (const PipelinedFile& pipelinedFile, pipelinedFiles) {
+      qDeleteAll(pipelinedFile.contexts);
+   }
+}
+
+/**
+ * @brief Hasher::rowsFinished
+ * @param count Number of rows that have been hashed, emits the progress.
+ *
+ * The rows are finished by the threads of the devices, in no particular order.
+ */
+void Hasher::rowsFinished(int count)
+{
+   emit progressstatus(finishedRows.fetchAndAddOrdered(count) + count);
+}
+
+/**
+ * @brief Hasher::sortByLocation
+ * @param files Sorted in the order they're stored on their devices, see DeviceScheduler::physicalLocation().
+ *
+ * Saves the heads of rotational disks from seeking back and forth between the files.
+ * Files with the same location keep their order.
+ */
+template <typename File>
+void Hasher::sortByLocation(QList<File>& files)
+{
+   QVector<QPair<quint64, int> > locations;
+   locations.reserve(files.size());
+   for (int i = 0; i < files.size() && !aborted.loadAcquire(); i++) {
+      locations.append(qMakePair(DeviceScheduler::physicalLocation(files.at(i).filename), i));
+   }
+   if (aborted.loadAcquire()) {
+      return;
+   }
+   std::sort(locations.begin(), locations.end());
+   QList<File> sorted;
+   sorted.reserve(files.size());
+   for (int i = 0; i < locations.size(); i++) {
+      sorted.append(files.at(locations.at(i).second));
+   }
+   files = sorted;
+}
+
 /**
  * @brief Hasher::startProcessWork
  */
 void Hasher::startProcessWork()
 {
-   aborted = false;
+   aborted.storeRelease(0);
 }
 
 /**
@@ -114,27 +327,449 @@ void Hasher::noMoreFiles()
  * @brief Hasher::hashFile
  * @param id Row id for the file entry. Set to -1 if called directly (won't send signal fileHashCalculated).
  * @param file File object
- * @param algorithm Which algorithm to use.
+ * @param settings Which algorithms to use, and how.
  * @param verify Pass-trough to signal fileHashCalculated.
- * @return The hash sum in string form.
+ * @param error Set to the error message if the file couldn't be read, when called directly.
+ * @return The hash sums keyed by algorithm name, empty if the file couldn't be read.
  */
-QString Hasher::hashFile(int id, QString basepath, HashProject::File file, QString algorithm, bool verify)
+QMap<QString, HashDigest> Hasher::hashFile(int id, QString basepath, HashProject::File file, HashProject::Settings settings, bool verify, QString* error)
 {
-   QString hash;
-   if (aborted) {
-      return hash;
-   }
-   HashAlgorithm* hashalgorithm = crc32algorithm;
-   if (algorithm != "CRC32") {
-      hashalgorithm = qtcryptoalgorithms;
+   QMap<QString, HashDigest> hashes;
+   if (aborted.loadAcquire()) {
+      return hashes;
    }
    if (QFileInfo(file.filename).isRelative()) {
       file.filename.prepend(basepath);
    }
-   hash = hashalgorithm->hashFile(file.filename, algorithm);
+   HashCache::Key cacheKey = HashCache::key(file.filename, cacheStores(settings, verify));
+   hashes = HashCache::get().find(cacheKey, settings.algorithms);
+   QString readError;
+   if (hashes.isEmpty()) {
+      hashes = calculateHashes(reader, file.filename, settings.algorithms, settings, findDevice(file.filename, settings), readError);
+   } else {
+      // Already cached.
+      cacheKey = HashCache::Key();
+   }
 
    if (id > -1) {
-      emit fileHashCalculated(id, algorithm, hash, verify);
+      reportHashes(id, settings.algorithms, hashes, readError, verify);
+   }
+   if (readError.isEmpty()) {
+      HashCache::get().store(cacheKey, hashes);
+   } else if (error) {
+      *error = readError;
+   }
+   return hashes;
+}
+
+/**
+ * @brief Hasher::reportHashes
+ * @param id Row id for the file entry.
+ * @param algorithms The algorithms used.
+ * @param hashes The hash sums keyed by algorithm name.
+ * @param error Error message if the file couldn't be read, otherwise empty.
+ * @param verify Pass-trough to the signals.
+ * @param cacheKey The key of the file taken before it was read, if the hash sums should be cached.
+ *
+ * Emits fileHashCalculated for every algorithm, or fileHashFailed once if there was an error.
+ */
+void Hasher::reportHashes(int id, const QStringList& algorithms, const QMap<QString, HashDigest>& hashes, QString error, bool verify,
+                          const HashCache::Key& cacheKey)
+{
+   if (!error.isEmpty()) {
+      emit fileHashFailed(id, error, verify);
+      return;
+   }
+   HashCache::get().store(cacheKey, hashes);
+   foreach (QString algorithm, algorithms) {
+      emit fileHashCalculated(id, algorithm, hashes.value(algorithm), verify);
+   }
+}
+
+/**
+ * @brief Hasher::cacheStores
+ * @param settings Whether the cache file and the attributes of the files are used.
+ * @param verify Verification reads the files, unless the attributes are trusted.
+ * @return Where the hash sums are looked up and stored, a combination of HashCache::Store.
+ */
+int Hasher::cacheStores(const HashProject::Settings& settings, bool verify) const
+{
+   int stores = 0;
+   if (settings.hashcache && !verify) {
+      stores |= HashCache::CacheFile;
+   }
+   if (settings.hashattributes && (!verify || !settings.forceverifyreads)) {
+      stores |= HashCache::Attributes;
+   }
+   return stores;
+}
+
+/**
+ * @brief Hasher::findAlgorithms
+ * @param algorithms Names of the algorithms.
+ * @param error Set to an error message if any of the algorithms is unknown.
+ * @return The registered algorithms, in the same order.
+ */
+Hasher::AlgorithmList Hasher::findAlgorithms(const QStringList& algorithms, QString& error) const
+{
+   AlgorithmList found;
+   foreach (QString name, algorithms) {
+      const AlgorithmRegistry::Algorithm* algorithm = AlgorithmRegistry::get().find(name);
+      if (!algorithm) {
+         error = QString("ERROR: Unknown algorithm %1.").arg(name);
+         return AlgorithmList();
+      }
+      found.append(algorithm);
+   }
+   return found;
+}
+
+/**
+ * @brief Hasher::calculateHashes
+ * @param fileReader The reader to use, each thread has its own.
+ * @param filename Full path to the file.
+ * @param algorithms Which algorithms to use.
+ * @param settings Whether to run the algorithms on separate cores, to split up large files and how to read them.
+ * @param device The device the file is stored on.
+ * @param error Set to an error message starting with "ERROR:" if the file couldn't be read.
+ * @return The hash sums keyed by algorithm name, empty if there was an error.
+ *
+ * Reads the file once in large blocks and feeds every block to one hashing context per algorithm.
+ * In parallel mode the contexts process a block on the thread pool while the next block is read.
+ */
+QMap<QString, HashDigest> Hasher::calculateHashes(FileReader& fileReader, QString filename, QStringList algorithms, const HashProject::Settings& settings,
+                                                  const DeviceScheduler::Device& device, QString& error)
+{
+   QMap<QString, HashDigest> hashes;
+   AlgorithmList selected = findAlgorithms(algorithms, error);
+   if (!error.isEmpty()) {
+      return hashes;
+   }
+   fileReader.setMode(settings.readmode);
+   fileReader.setHints(settings.filehints);
+   error = fileReader.open(filename);
+   if (!error.isEmpty()) {
+      return hashes;
+   }
+   qint64 filesize = fileReader.size();
+   if (splitIntoRanges(filesize, selected, settings, device)) {
+      fileReader.close();
+      return calculateHashesInRanges(filename, algorithms, selected, filesize, settings, error);
+   }
+
+   if (selected.size() == 1) {
+      // The read loop is instantiated for the algorithm's context type.
+      HashDigest hash = selected.first()->hashSource(fileReader, error);
+      fileReader.close();
+      if (error.isEmpty()) {
+         hashes[algorithms.first()] = hash;
+      }
+      return hashes;
+   }
+
+   QList<HashAlgorithm::Context*> contexts;
+   foreach (const AlgorithmRegistry::Algorithm* algorithm, selected) {
+      contexts.append(algorithm->createContext());
+   }
+
+   bool parallel = settings.paralleldigests;
+   QFuture<void> pendingUpdate;
+   FileReader::Block block;
+   // The reader keeps the previous block valid while the next one is read.
+   while (fileReader.next(block)) {
+      if (parallel) {
+         pendingUpdate.waitForFinished();
+         pendingUpdate = QtConcurrent::map(contexts, [block](HashAlgorithm::Context* context) {
+            updateContext(context, block);
+         });
+      } else {
+         foreach (HashAlgorithm::Context* context, contexts) {
+            updateContext(context, block);
+         }
+      }
+   }
+   pendingUpdate.waitForFinished();
+   error = fileReader.error();
+   fileReader.close();
+
+   for (int i = 0; i < algorithms.size() && error.isEmpty(); i++) {
+      hashes[algorithms.at(i)] = contexts.at(i)->finalize();
+   }
+   qDeleteAll(contexts);
+   return hashes;
+}
+
+/**
+ * @brief Hasher::splitIntoRanges
+ * @param filesize
+ * @param algorithms
+ * @param settings
+ * @param device The device the file is stored on.
+ * @return True if the file is hashed in ranges on separate cores, see calculateHashesInRanges().
+ *
+ * Files on rotational disks aren't split, as reading the ranges at the same time would make the heads seek.
+ */
+bool Hasher::splitIntoRanges(qint64 filesize, const AlgorithmList& algorithms, const HashProject::Settings& settings,
+                             const DeviceScheduler::Device& device) const
+{
+   return settings.splitlargefiles && filesize >= largeFileLimit && !device.rotational &&
+         QThread::idealThreadCount() > 1 && isCombinable(algorithms);
+}
+
+/**
+ * @brief Hasher::hashPipelinedFile
+ * @param pipeline The pipeline reading the file.
+ * @param fileReader Reads the file instead if it's sparse.
+ * @param file The oldest file added to the pipeline.
+ * @param settings Whether to feed the blocks to the algorithms on separate cores.
+ * @param device The device the file is stored on.
+ * @param verify Pass-trough to the signals.
+ *
+ * Hashes the blocks of the file as they're returned by the pipeline, which meanwhile
+ * reads ahead into the next files. Deletes the contexts and reports the hash sums.
+ * The pipeline would read the holes of a sparse file, FileReader skips them.
+ */
+void Hasher::hashPipelinedFile(ReadPipeline& pipeline, FileReader& fileReader, PipelinedFile file, const HashProject::Settings& settings,
+                               const DeviceScheduler::Device& device, bool verify)
+{
+   bool parallel = settings.paralleldigests;
+   QFuture<void> pendingUpdate;
+   ReadPipeline::Block block;
+   ReadPipeline::Block hashing = { -1, 0, 0, false, QString(), false, -1 };
+   QString error;
+   do {
+      if (!pipeline.next(block)) {
+         break;
+      }
+      if (block.sparse) {
+         pipeline.release(block);
+         qDeleteAll(file.contexts);
+         QMap<QString, HashDigest> hashes = calculateHashes(fileReader, file.filename, file.algorithms, settings, device, error);
+         reportHashes(file.row, file.algorithms, hashes, error, verify, file.cacheKey);
+         return;
+      }
+      if (!block.error.isEmpty()) {
+         error = block.error;
+         pipeline.release(block);
+         // The blocks of the file already being read mustn't be taken for the next file's.
+         pipeline.cancel(block.file);
+         break;
+      }
+      if (parallel && file.contexts.size() > 1) {
+         // The pipeline keeps the previous block while the next one is returned.
+         pendingUpdate.waitForFinished();
+         pipeline.release(hashing);
+         pendingUpdate = QtConcurrent::map(file.contexts, [block](HashAlgorithm::Context* context) {
+            context->update(block.data, block.length);
+         });
+         hashing = block;
+      } else {
+         foreach (HashAlgorithm::Context* context, file.contexts) {
+            context->update(block.data, block.length);
+         }
+         pipeline.release(block);
+      }
+   } while (!block.last);
+   pendingUpdate.waitForFinished();
+   pipeline.release(hashing);
+
+   QMap<QString, HashDigest> hashes;
+   for (int i = 0; i < file.algorithms.size() && error.isEmpty(); i++) {
+      hashes[file.algorithms.at(i)] = file.contexts.at(i)->finalize();
+   }
+   qDeleteAll(file.contexts);
+   reportHashes(file.row, file.algorithms, hashes, error, verify, file.cacheKey);
+}
+
+/**
+ * @brief Hasher::updateContext
+ * @param context
+ * @param block A block from FileReader, holes are fed as zeros.
+ */
+void Hasher::updateContext(HashAlgorithm::Context* context, const FileReader::Block& block)
+{
+   if (block.hole) {
+      context->updateZeros(block.length);
+   } else {
+      context->update(block.data, block.length);
+   }
+}
+
+/**
+ * @brief Hasher::isCombinable
+ * @param algorithms
+ * @return True if the hash sums of all the algorithms can be calculated in separate parts.
+ */
+bool Hasher::isCombinable(const AlgorithmList& algorithms) const
+{
+   foreach (const AlgorithmRegistry::Algorithm* algorithm, algorithms) {
+      if (!algorithm->combinable) {
+         return false;
+      }
+   }
+   return true;
+}
+
+/**
+ * @brief Hasher::calculateHashesInRanges
+ * @param filename Full path to the file.
+ * @param algorithms Names of the algorithms, used as keys in the result.
+ * @param selected The algorithms, all of them must be combinable.
+ * @param filesize Size of the file.
+ * @param settings How the ranges are read.
+ * @param error Set to an error message starting with "ERROR:" if any of the ranges couldn't be read.
+ * @return The hash sums keyed by algorithm name, empty if there was an error.
+ *
+ * Splits a large file into one range per core. The ranges are read and hashed at the same
+ * time, each with its own file handle and contexts, and the results are then combined into
+ * the same hash sums as a sequential read would give.
+ */
+QMap<QString, HashDigest> Hasher::calculateHashesInRanges(QString filename, const QStringList& algorithms, const AlgorithmList& selected,
+                                                          qint64 filesize, const HashProject::Settings& settings, QString& error)
+{
+   struct Range {
+      qint64 offset;
+      qint64 length;
+      QList<HashAlgorithm::Context*> contexts;
+      QString error;
+   };
+   int rangeCount = static_cast<int>(qMin<qint64>(QThread::idealThreadCount(), filesize / minimumRangeLength));
+   // The ranges start at multiples of the read size.
+   qint64 rangeLength = (filesize / rangeCount) / FileReader::readBlockSize * FileReader::readBlockSize;
+   QVector<Range> ranges(rangeCount);
+   for (int i = 0; i < rangeCount; i++) {
+      ranges[i].offset = i * rangeLength;
+      ranges[i].length = (i == rangeCount - 1) ? filesize - ranges[i].offset : rangeLength;
+      foreach (const AlgorithmRegistry::Algorithm* algorithm, selected) {
+         ranges[i].contexts.append(algorithm->createContext());
+      }
+   }
+
+   FileReader::Mode mode = settings.readmode;
+   int hints = settings.filehints;
+   QtConcurrent::blockingMap(ranges, [filename, mode, hints](Range& range) {
+      FileReader rangeReader(mode);
+      rangeReader.setHints(hints);
+      range.error = rangeReader.open(filename, range.offset, range.length);
+      FileReader::Block block;
+      while (range.error.isEmpty() && rangeReader.next(block)) {
+         foreach (HashAlgorithm::Context* context, range.contexts) {
+            updateContext(context, block);
+         }
+      }
+      if (range.error.isEmpty()) {
+         // Also set if the file has been truncated since the size was read.
+         range.error = rangeReader.error();
+      }
+   });
+
+   foreach (const Range& range, ranges) {
+      if (!range.error.isEmpty()) {
+         error = range.error;
+         break;
+      }
+   }
+   QMap<QString, HashDigest> hashes;
+   for (int i = 0; i < algorithms.size() && error.isEmpty(); i++) {
+      HashAlgorithm::Context* first = ranges.first().contexts.at(i);
+      for (int j = 1; j < rangeCount; j++) {
+         first->combine(ranges.at(j).contexts.at(i), ranges.at(j).length);
+      }
+      hashes[algorithms.at(i)] = first->finalize();
+   }
+   foreach (const Range& range, ranges) {
+      qDeleteAll(range.contexts);
+   }
+   return hashes;
+}
+
+/**
+ * @brief Hasher::useMultiBuffer
+ * @param algorithms
+ * @return True if any of the algorithms is faster when hashing several small files at once.
+ */
+bool Hasher::useMultiBuffer(const AlgorithmList& algorithms) const
+{
+   foreach (const AlgorithmRegistry::Algorithm* algorithm, algorithms) {
+      if (MultiBufferHash::isSupported(algorithm->id)) {
+         return true;
+      }
+   }
+   return false;
+}
+
+/**
+ * @brief Hasher::hashSmallFiles
+ * @param files The batch of small files, all using the same algorithms.
+ * @param verify Is the calculation done to verify the previous hash sums.
+ * @param settings How the files are read. Memory mapping isn't worth it for files this small.
+ * @param grownFiles The files that are no longer small are added here, without being hashed.
+ *
+ * Reads all the files into memory and lets MultiBufferHash hash them in parallel lanes.
+ * Algorithms without multi-buffer support hash the files one at a time from memory.
+ * The files were found small by their size in the project, so no more than one byte
+ * above the limit is read from each, in case it has grown since.
+ */
+void Hasher::hashSmallFiles(const QList<SmallFile>& files, bool verify, const HashProject::Settings& settings, QList<DeviceFile>& grownFiles)
+{
+   QList<SmallFile> hashed;
+   QList<QByteArray> contents;
+   QStringList errors;
+   reader.setMode(settings.readmode == FileReader::MemoryMapped ? FileReader::ReadCalls : settings.readmode);
+   reader.setHints(settings.filehints);
+   foreach (const SmallFile& smallFile, files) {
+      QString error = reader.open(smallFile.filename);
+      QByteArray content;
+      bool grown = error.isEmpty() && reader.size() > smallFileLimit;
+      FileReader::Block block;
+      while (error.isEmpty() && !grown && reader.next(block)) {
+         int length = static_cast<int>(qMin<qint64>(block.length, smallFileLimit + 1 - content.size()));
+         if (block.hole) {
+            content.append(QByteArray(length, '\0'));
+         } else {
+            content.append(block.data, length);
+         }
+         grown = content.size() > smallFileLimit;
+      }
+      if (error.isEmpty() && !grown) {
+         error = reader.error();
+      }
+      qint64 filesize = reader.size();
+      reader.close();
+      if (grown) {
+         DeviceFile grownFile = { smallFile.row, smallFile.filename, smallFile.algorithms, filesize, smallFile.cacheKey };
+         grownFiles.append(grownFile);
+         continue;
+      }
+      hashed.append(smallFile);
+      contents.append(error.isEmpty() ? content : QByteArray());
+      errors.append(error);
+   }
+   if (hashed.isEmpty()) {
+      return;
+   }
+
+   const QStringList& algorithms = files.first().algorithms;
+   // Only batches of known algorithms are created, see hashProject().
+   QString unknownAlgorithm;
+   QList<QList<HashDigest> > results;
+   foreach (const AlgorithmRegistry::Algorithm* algorithm, findAlgorithms(algorithms, unknownAlgorithm)) {
+      if (MultiBufferHash::isSupported(algorithm->id)) {
+         results.append(MultiBufferHash::calculate(algorithm->id, contents));
+         continue;
+      }
+      QList<HashDigest> hashes;
+      foreach (const QByteArray& content, contents) {
+         hashes.append(algorithm->hashData(content.constData(), content.size()));
+      }
+      results.append(hashes);
+   }
+
+   for (int i = 0; i < hashed.size(); i++) {
+      QMap<QString, HashDigest> hashes;
+      for (int j = 0; j < algorithms.size(); j++) {
+         hashes[algorithms.at(j)] = results.at(j).at(i);
+      }
+      reportHashes(hashed.at(i).row, algorithms, hashes, errors.at(i), verify, hashed.at(i).cacheKey);
    }
-   return hash;
 }
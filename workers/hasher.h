@@ -1,6 +1,18 @@
 /**
  * Manages the different hash calculation algorithms.
  *
+ * Reads the files block by block and feeds the data to a hashing context
+ * created by the selected algorithm. When several algorithms are selected,
+ * each file is only read once and every block is fed to all of them.
+ * Small files are collected in batches and hashed several at once with
+ * MultiBufferHash, when the processor supports it. Large files are split
+ * into ranges hashed on separate cores when the algorithms can combine them.
+ * The other files are grouped by the device they're stored on, and each
+ * device is read by its own threads, see DeviceScheduler.
+ * Files that haven't changed since they were last hashed can get their hash
+ * sums from the HashCache instead of being read, from its file unless verifying,
+ * and from the attributes of the files unless set to read them when verifying.
+ *
  * While it's not a requirement, this class was designed for and
  * benefits from running in a separate QThread.
  * When in multithreaded mode, other threads can abort the scanning
@@ -12,13 +24,18 @@
 #ifndef HASHER_H
 #define HASHER_H
 
+#include <QAtomicInt>
 #include <QObject>
 #include <QThread>
 
 #include "hashproject/hashproject.h"
+#include "algorithms/algorithmregistry.h"
+#include "workers/devicescheduler.h"
+#include "workers/filereader.h"
+#include "workers/hashcache.h"
 
 class QTableWidget;
-class HashAlgorithm;
+class ReadPipeline;
 
 class Hasher : public QObject
 {
@@ -26,25 +43,93 @@ class Hasher : public QObject
 
 public:
    Hasher();
-   ~Hasher();
-   void abort() { aborted = true; }
+   void abort() { aborted.storeRelease(1); }
 
 public slots:
    void hashProject(HashProject*, bool verify=false, QString basepath="");
-   QString hashFile(int i, QString basepath, HashProject::File file, QString algorithm="CRC32", bool verify=false);
+   QMap<QString, HashDigest> hashFile(int i, QString basepath, HashProject::File file, HashProject::Settings settings, bool verify=false, QString* error=0);
    void noMoreFiles();
    void startProcessWork();
 
 signals:
    void progressstatus(int);
    void scanFinished();
-   void fileHashCalculated(int id, QString algorithm, QString hash, bool verify);
+   void fileHashCalculated(int id, QString algorithm, HashDigest hash, bool verify);
+   void fileHashFailed(int id, QString error, bool verify);
 
 private:
-   bool aborted;
+   struct SmallFile {
+      int row;
+      QString filename;
+      QStringList algorithms;
+      // Not valid if the hash sums aren't cached.
+      HashCache::Key cacheKey;
+   };
+
+   struct PipelinedFile {
+      int row;
+      QString filename;
+      QStringList algorithms;
+      QList<HashAlgorithm::Context*> contexts;
+      HashCache::Key cacheKey;
+   };
+
+   struct DeviceFile {
+      int row;
+      QString filename;
+      QStringList algorithms;
+      qint64 filesize;
+      HashCache::Key cacheKey;
+   };
+
+   // The files of a project stored on the same device.
+   struct DeviceQueue {
+      DeviceScheduler::Device device;
+      QList<DeviceFile> files;
+      // Index of the next file to hash, shared by the threads of the device.
+      QAtomicInt next;
+   };
+
+   typedef QList<const AlgorithmRegistry::Algorithm*> AlgorithmList;
+
+   AlgorithmList findAlgorithms(const QStringList& algorithms, QString& error) const;
+   int cacheStores(const HashProject::Settings& settings, bool verify) const;
+   DeviceScheduler::Device findDevice(QString filename, const HashProject::Settings& settings);
+   void queueDeviceFile(QMap<quint64, DeviceQueue*>& devices, const DeviceFile& file, const HashProject::Settings& settings);
+   void hashDeviceFiles(DeviceQueue* queue, const HashProject::Settings& settings, bool verify);
+   void pipelineDeviceFiles(DeviceQueue* queue, const HashProject::Settings& settings, bool verify);
+   void rowsFinished(int count);
+   template <typename File>
+   void sortByLocation(QList<File>& files);
+   QMap<QString, HashDigest> calculateHashes(FileReader& reader, QString filename, QStringList algorithms, const HashProject::Settings& settings,
+                                             const DeviceScheduler::Device& device, QString& error);
+   bool splitIntoRanges(qint64 filesize, const AlgorithmList& algorithms, const HashProject::Settings& settings,
+                        const DeviceScheduler::Device& device) const;
+   void hashPipelinedFile(ReadPipeline& pipeline, FileReader& fileReader, PipelinedFile file, const HashProject::Settings& settings,
+                          const DeviceScheduler::Device& device, bool verify);
+   static void updateContext(HashAlgorithm::Context* context, const FileReader::Block& block);
+   bool isCombinable(const AlgorithmList& algorithms) const;
+   QMap<QString, HashDigest> calculateHashesInRanges(QString filename, const QStringList& algorithms, const AlgorithmList& selected,
+                                                     qint64 filesize, const HashProject::Settings& settings, QString& error);
+   void reportHashes(int id, const QStringList& algorithms, const QMap<QString, HashDigest>& hashes, QString error, bool verify,
+                     const HashCache::Key& cacheKey=HashCache::Key());
+   bool useMultiBuffer(const AlgorithmList& algorithms) const;
+   void hashSmallFiles(const QList<SmallFile>& files, bool verify, const HashProject::Settings& settings, QList<DeviceFile>& grownFiles);
+
+   // Files smaller than this are hashed in batches by MultiBufferHash.
+   static const qint64 smallFileLimit = 64 * 1024;
+   static const int smallFileBatchesPerLane = 8;
+   // Files larger than this are split into ranges hashed in parallel, if the algorithms allow it.
+   static const qint64 largeFileLimit = Q_INT64_C(512) * 1024 * 1024;
+   static const qint64 minimumRangeLength = Q_INT64_C(128) * 1024 * 1024;
+
+   QAtomicInt aborted;
    bool scanFinishedSent;
-   HashAlgorithm* crc32algorithm;
-   HashAlgorithm* qtcryptoalgorithms;
+   // Reused for all files hashed on the thread of the hasher, to keep its buffers.
+   FileReader reader;
+   DeviceScheduler scheduler;
+   // Number of rows of the project that have been hashed, for the progress.
+   QAtomicInt finishedRows;
 };
 
 #endif // HASHER_H
@@ -0,0 +1,623 @@
+/**
+ * Reads a queue of files asynchronously, keeping several reads outstanding.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include <QDebug>
+#include <QVector>
+#include <QtConcurrent>
+
+#include <errno.h>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(Q_OS_LINUX) && __has_include(<linux/io_uring.h>)
+#define HASHMAN_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#include "directoryhandles.h"
+#include "filehints.h"
+#include "filereader.h"
+#include "readpipeline.h"
+#include "throttle.h"
+
+namespace {
+
+// Allows the buffers to be used for direct I/O.
+const int bufferAlignment = 4096;
+
+}
+
+#ifdef HASHMAN_IO_URING
+struct ReadPipeline::Ring {
+   int fd;
+   void* sqRing;
+   size_t sqRingSize;
+   void* cqRing;
+   size_t cqRingSize;
+   io_uring_sqe* sqes;
+   size_t sqesSize;
+   unsigned* sqTail;
+   unsigned sqMask;
+   unsigned* sqArray;
+   unsigned* cqHead;
+   unsigned* cqTail;
+   unsigned cqMask;
+   io_uring_cqe* cqes;
+   // Entries added to the submission queue but not yet passed to the kernel.
+   unsigned unsubmitted;
+   bool fixedBuffers;
+};
+#else
+struct ReadPipeline::Ring {
+};
+#endif
+
+/**
+ * @brief ReadPipeline::ReadPipeline
+ * @param queueDepth Number of blocks read at the same time.
+ * @param direct Bypass the page cache when the file system supports it, see FileReader::DirectIo.
+ * @param hints A combination of FileHints::Hint.
+ */
+ReadPipeline::ReadPipeline(int queueDepth, bool direct, int hints)
+{
+   this->queueDepth = qBound(1, queueDepth, static_cast<int>(maximumQueueDepth));
+   this->direct = direct;
+   this->hints = hints;
+   submitFile = 0;
+   ring = 0;
+   // Two more buffers than the queue depth, for the blocks being hashed.
+   for (int i = 0; i < this->queueDepth + 2; i++) {
+      buffers.append(static_cast<char*>(qMallocAligned(blockSize, bufferAlignment)));
+      freeBuffers.append(i);
+   }
+   if (!setupRing()) {
+#ifdef Q_OS_UNIX
+      ioThreads.setMaxThreadCount(this->queueDepth);
+#else
+      // The reads use the position of the shared QFile, so they're done one at a time.
+      ioThreads.setMaxThreadCount(1);
+#endif
+   }
+}
+
+/**
+ * @brief ReadPipeline::~ReadPipeline
+ * Waits for the outstanding reads, as they write to the buffers.
+ */
+ReadPipeline::~ReadPipeline()
+{
+   cancelAll();
+   destroyRing();
+   foreach (char* buffer, buffers) {
+      qFreeAligned(buffer);
+   }
+}
+
+/**
+ * @brief ReadPipeline::addFile
+ * @param filename Full path to the file.
+ *
+ * @return The index of the file, set in its blocks.
+ *
+ * Adds a file to the end of the queue. The reading starts as soon as there are free buffers.
+ */
+int ReadPipeline::addFile(QString filename)
+{
+   File file = { filename, 0, -1, 0, 0, false, false, false, false, false };
+   files.append(file);
+   submitReads();
+   return files.size() - 1;
+}
+
+/**
+ * @brief ReadPipeline::next
+ * @param block Set to the next block, in the order the files were added.
+ * @return False when all the added files have been returned.
+ *
+ * Waits until the block has been read. Every block must be handed back with release(),
+ * and at most two blocks can be held at the same time.
+ */
+bool ReadPipeline::next(Block& block)
+{
+   forever {
+      submitReads();
+      if (order.isEmpty()) {
+         return false;
+      }
+      Request* request = order.first();
+      waitFor(request);
+      File& file = files[request->file];
+      if (request->buffer >= 0) {
+         file.pendingReads--;
+      }
+      if (request->result == -EINVAL && file.direct && !file.failed) {
+         // The file system refused the direct read, read it through the cache instead.
+         disableDirectIo(file);
+         request->result = 0;
+         request->done = false;
+         file.pendingReads++;
+         submit(request);
+         continue;
+      }
+      order.removeFirst();
+      if ((hints & FileHints::DropCache) && !file.direct && request->offset >= 0 && request->result > 0) {
+         // The block has been copied to the buffer.
+         FileHints::dropCache(request->handle->handle(), request->offset, request->result);
+      }
+
+      bool skipped = file.failed;
+      if (skipped) {
+         // The blocks already submitted after an error are skipped.
+         if (request->buffer >= 0) {
+            freeBuffers.append(request->buffer);
+         }
+      } else {
+         block.file = request->file;
+         block.buffer = request->buffer;
+         block.data = request->buffer >= 0 ? buffers.at(request->buffer) : 0;
+         block.length = qMax<qint64>(0, request->result);
+         block.last = request->last;
+         block.error = request->error;
+         block.sparse = file.sparse;
+         if (request->result < 0) {
+            block.error = QString("ERROR: %1").arg(qt_error_string(static_cast<int>(-request->result)));
+         } else if (file.size >= 0 && request->result < request->length) {
+            // The file has been truncated since the size was read.
+            block.error = QString("ERROR: Unexpected end of file.");
+         } else if (file.size < 0 && request->result == 0) {
+            block.last = true;
+         }
+         if (!block.error.isEmpty()) {
+            qDebug() << block.error << file.filename;
+            block.last = true;
+            file.failed = true;
+         }
+         if (block.last && !file.submittedAll) {
+            file.submittedAll = true;
+            submitFile++;
+         }
+      }
+      if (file.submittedAll && file.pendingReads == 0) {
+         closeFile(file);
+      }
+      delete request;
+      if (!skipped) {
+         return true;
+      }
+   }
+}
+
+/**
+ * @brief ReadPipeline::release
+ * @param block A block returned by next(). Its buffer is reused for a new read.
+ */
+void ReadPipeline::release(const Block& block)
+{
+   if (block.buffer >= 0) {
+      freeBuffers.append(block.buffer);
+      submitReads();
+   }
+}
+
+/**
+ * @brief ReadPipeline::cancel
+ * @param index A file that won't be hashed to the end, after an error or when aborting.
+ *
+ * Nothing more is read from the file, and its blocks that are already being read are
+ * dropped by next() as they complete. The blocks held by the caller must still be released.
+ */
+void ReadPipeline::cancel(int index)
+{
+   File& file = files[index];
+   file.failed = true;
+   if (!file.submittedAll && index == submitFile) {
+      file.submittedAll = true;
+      submitFile++;
+   }
+   if (file.submittedAll && file.pendingReads == 0) {
+      closeFile(file);
+   }
+   submitReads();
+}
+
+/**
+ * @brief ReadPipeline::cancelAll
+ * Cancels all the files, and waits for the reads in progress as they write to the buffers.
+ * The blocks held by the caller must still be released.
+ */
+void ReadPipeline::cancelAll()
+{
+   for (int i = 0; i < files.size(); i++) {
+      files[i].failed = true;
+      files[i].submittedAll = true;
+   }
+   submitFile = files.size();
+   foreach (Request* request, order) {
+      if (request->buffer >= 0) {
+         waitFor(request);
+         freeBuffers.append(request->buffer);
+      }
+   }
+   ioThreads.waitForDone();
+   qDeleteAll(order);
+   order.clear();
+   for (int i = 0; i < files.size(); i++) {
+      files[i].pendingReads = 0;
+      closeFile(files[i]);
+   }
+}
+
+/**
+ * @brief ReadPipeline::submitReads
+ * Starts reads into the free buffers, continuing into the next files in the queue.
+ */
+void ReadPipeline::submitReads()
+{
+   while (submitFile < files.size()) {
+      File& file = files[submitFile];
+      if (file.failed) {
+         // Cancelled before it was read.
+         file.submittedAll = true;
+         submitFile++;
+         continue;
+      }
+      if (!file.opened) {
+         QString error = openFile(file);
+         if (!error.isEmpty() || file.sparse) {
+            // Nothing is read, a single block returns the error or that the file is sparse.
+            Request* request = new Request;
+            *request = { submitFile, 0, -1, 0, 0, 0, true, true, error };
+            order.append(request);
+            file.submittedAll = true;
+            submitFile++;
+            continue;
+         }
+      }
+      if ((file.size < 0 && file.pendingReads > 0) || order.size() >= queueDepth || freeBuffers.isEmpty()) {
+         // Files of unknown size have one read at a time, the end is found when it completes.
+         break;
+      }
+      if (Throttle::get().isLimited()) {
+         // The reads already queued are started while waiting.
+         flushRing();
+      }
+      Request* request = new Request;
+      request->file = submitFile;
+      request->handle = file.handle;
+      request->buffer = freeBuffers.takeLast();
+      request->offset = file.size < 0 ? -1 : file.submitted;
+      request->length = file.size < 0 ? blockSize : qMin<qint64>(blockSize, file.size - file.submitted);
+      request->result = 0;
+      request->done = false;
+      request->last = false;
+      if (file.size >= 0) {
+         file.submitted += request->length;
+         if (file.submitted == file.size) {
+            request->last = true;
+            file.submittedAll = true;
+            submitFile++;
+         }
+      }
+      file.pendingReads++;
+      order.append(request);
+      Throttle::get().acquire(request->length);
+      submit(request);
+   }
+   flushRing();
+}
+
+/**
+ * @brief ReadPipeline::openFile
+ * @param file
+ * @return Empty string if the file was opened, otherwise an error message starting with "ERROR:".
+ */
+QString ReadPipeline::openFile(File& file)
+{
+   file.opened = true;
+   file.handle = new QFile;
+   QString error = DirectoryHandles::get().openFile(*file.handle, file.filename);
+   if (!error.isEmpty()) {
+      return error;
+   }
+   // Files in for example /proc report a size of zero, they're read until the end like pipes.
+   file.size = file.handle->isSequential() || file.handle->size() == 0 ? -1 : file.handle->size();
+   file.sparse = file.size >= 0 && FileReader::isSparse(file.handle->handle());
+   if (file.sparse) {
+      return QString();
+   }
+#if defined(Q_OS_LINUX)
+   if (direct && file.size >= 0) {
+      int flags = fcntl(file.handle->handle(), F_GETFL);
+      file.direct = flags != -1 && fcntl(file.handle->handle(), F_SETFL, flags | O_DIRECT) != -1;
+   }
+#endif
+   if (hints & FileHints::NoAccessTime) {
+      FileHints::setNoAccessTime(file.handle->handle());
+   }
+   if ((hints & FileHints::Readahead) && !file.direct) {
+      FileHints::adviseSequential(file.handle->handle());
+   }
+   return QString();
+}
+
+/**
+ * @brief ReadPipeline::closeFile
+ * @param file
+ */
+void ReadPipeline::closeFile(File& file)
+{
+   delete file.handle;
+   file.handle = 0;
+}
+
+/**
+ * @brief ReadPipeline::disableDirectIo
+ * @param file Read through the page cache from now on.
+ */
+void ReadPipeline::disableDirectIo(File& file)
+{
+#if defined(Q_OS_LINUX)
+   int flags = fcntl(file.handle->handle(), F_GETFL);
+   if (flags != -1) {
+      fcntl(file.handle->handle(), F_SETFL, flags & ~O_DIRECT);
+   }
+#endif
+   file.direct = false;
+}
+
+/**
+ * @brief ReadPipeline::submit
+ * @param request Starts reading the rest of the request.
+ */
+void ReadPipeline::submit(Request* request)
+{
+#ifdef HASHMAN_IO_URING
+   if (ring) {
+      // This is the only thread adding entries, so the tail can be read without ordering.
+      unsigned tail = *ring->sqTail;
+      unsigned index = tail & ring->sqMask;
+      io_uring_sqe* sqe = &ring->sqes[index];
+      memset(sqe, 0, sizeof(io_uring_sqe));
+      sqe->opcode = ring->fixedBuffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+      sqe->fd = request->handle->handle();
+      sqe->addr = reinterpret_cast<quintptr>(buffers.at(request->buffer) + request->result);
+      sqe->len = static_cast<unsigned>(request->length - request->result);
+      // An offset of -1 reads from the current position.
+      sqe->off = request->offset < 0 ? ~__u64(0) : static_cast<__u64>(request->offset + request->result);
+      sqe->buf_index = ring->fixedBuffers ? static_cast<__u16>(request->buffer) : 0;
+      sqe->user_data = reinterpret_cast<quintptr>(request);
+      sqe->ioprio = static_cast<__u16>(Throttle::get().ioPriority());
+      ring->sqArray[index] = index;
+      __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+      ring->unsubmitted++;
+      return;
+   }
+#endif
+   QtConcurrent::run(&ioThreads, [this, request]() {
+      readInThread(request);
+   });
+}
+
+/**
+ * @brief ReadPipeline::waitFor
+ * @param request Returns when the request has been read.
+ */
+void ReadPipeline::waitFor(Request* request)
+{
+   if (ring) {
+      while (!request->done) {
+         waitForRing();
+      }
+      return;
+   }
+   QMutexLocker locker(&mutex);
+   while (!request->done) {
+      completed.wait(&mutex);
+   }
+}
+
+/**
+ * @brief ReadPipeline::readInThread
+ * @param request Read on one of the I/O threads, when there is no io_uring.
+ */
+void ReadPipeline::readInThread(Request* request)
+{
+   Throttle::get().applyPriority();
+   char* buffer = buffers.at(request->buffer);
+   qint64 result = 0;
+#ifdef Q_OS_UNIX
+   int fd = request->handle->handle();
+   while (result < request->length) {
+      ssize_t bytesRead = request->offset < 0 ?
+               read(fd, buffer + result, static_cast<size_t>(request->length - result)) :
+               pread(fd, buffer + result, static_cast<size_t>(request->length - result), request->offset + result);
+      if (bytesRead < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         result = -errno;
+         break;
+      }
+      result += bytesRead;
+      if (bytesRead == 0 || request->offset < 0) {
+         break;
+      }
+   }
+#else
+   if (request->offset >= 0 && !request->handle->seek(request->offset)) {
+      result = -EIO;
+   } else {
+      result = request->handle->read(buffer, request->length);
+      if (result < 0) {
+         result = -EIO;
+      }
+   }
+#endif
+   QMutexLocker locker(&mutex);
+   request->result = result;
+   request->done = true;
+   completed.wakeAll();
+}
+
+/**
+ * @brief ReadPipeline::setupRing
+ * @return False if io_uring isn't available, the I/O threads are used instead.
+ *
+ * Creates the ring and maps its queues. The buffers are registered as fixed buffers
+ * if the limit for locked memory allows it, which saves mapping them for every read.
+ */
+bool ReadPipeline::setupRing()
+{
+#ifdef HASHMAN_IO_URING
+   io_uring_params params;
+   memset(&params, 0, sizeof(params));
+   int fd = static_cast<int>(syscall(__NR_io_uring_setup, queueDepth, &params));
+   if (fd < 0) {
+      qDebug() << "io_uring not available, reading with threads: " << qt_error_string(errno);
+      return false;
+   }
+   if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+      // Reading from the current position, used for pipes, needs Linux 5.6.
+      close(fd);
+      return false;
+   }
+   ring = new Ring;
+   memset(ring, 0, sizeof(Ring));
+   ring->fd = fd;
+   ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+   ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+   if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      ring->sqRingSize = ring->cqRingSize = qMax(ring->sqRingSize, ring->cqRingSize);
+   }
+   ring->sqRing = mmap(0, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+   if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      ring->cqRing = ring->sqRing;
+   } else {
+      ring->cqRing = mmap(0, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+   }
+   ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+   void* sqes = mmap(0, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+   ring->sqes = sqes == MAP_FAILED ? 0 : static_cast<io_uring_sqe*>(sqes);
+   if (ring->sqRing == MAP_FAILED || ring->cqRing == MAP_FAILED || !ring->sqes) {
+      qDebug() << "io_uring queues couldn't be mapped, reading with threads.";
+      destroyRing();
+      return false;
+   }
+   char* sq = static_cast<char*>(ring->sqRing);
+   char* cq = static_cast<char*>(ring->cqRing);
+   ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+   ring->sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+   ring->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+   ring->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+   ring->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+   ring->cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+   ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+   QVector<iovec> iovecs(buffers.size());
+   for (int i = 0; i < buffers.size(); i++) {
+      iovecs[i].iov_base = buffers.at(i);
+      iovecs[i].iov_len = blockSize;
+   }
+   ring->fixedBuffers = syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iovecs.data(), iovecs.size()) == 0;
+   return true;
+#else
+   return false;
+#endif
+}
+
+/**
+ * @brief ReadPipeline::destroyRing
+ */
+void ReadPipeline::destroyRing()
+{
+#ifdef HASHMAN_IO_URING
+   if (!ring) {
+      return;
+   }
+   if (ring->sqes) {
+      munmap(ring->sqes, ring->sqesSize);
+   }
+   if (ring->cqRing && ring->cqRing != MAP_FAILED && ring->cqRing != ring->sqRing) {
+      munmap(ring->cqRing, ring->cqRingSize);
+   }
+   if (ring->sqRing && ring->sqRing != MAP_FAILED) {
+      munmap(ring->sqRing, ring->sqRingSize);
+   }
+   close(ring->fd);
+   delete ring;
+   ring = 0;
+#endif
+}
+
+/**
+ * @brief ReadPipeline::flushRing
+ * Passes the new entries in the submission queue to the kernel.
+ */
+void ReadPipeline::flushRing()
+{
+#ifdef HASHMAN_IO_URING
+   while (ring && ring->unsubmitted > 0) {
+      long submitted = syscall(__NR_io_uring_enter, ring->fd, ring->unsubmitted, 0, 0, 0, 0);
+      if (submitted < 0) {
+         // Retried by the next flush or wait.
+         if (errno != EINTR) {
+            return;
+         }
+         continue;
+      }
+      ring->unsubmitted -= static_cast<unsigned>(submitted);
+   }
+#endif
+}
+
+/**
+ * @brief ReadPipeline::waitForRing
+ * Waits for at least one completed read and processes all completions.
+ */
+void ReadPipeline::waitForRing()
+{
+#ifdef HASHMAN_IO_URING
+   long submitted = syscall(__NR_io_uring_enter, ring->fd, ring->unsubmitted, 1, IORING_ENTER_GETEVENTS, 0, 0);
+   if (submitted > 0) {
+      ring->unsubmitted -= static_cast<unsigned>(submitted);
+   }
+   unsigned head = *ring->cqHead;
+   unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+   while (head != tail) {
+      const io_uring_cqe& cqe = ring->cqes[head & ring->cqMask];
+      completeInRing(reinterpret_cast<Request*>(cqe.user_data), cqe.res);
+      head++;
+   }
+   __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+#endif
+}
+
+/**
+ * @brief ReadPipeline::completeInRing
+ * @param request
+ * @param result Number of bytes read, or a negative errno.
+ *
+ * Short reads of files with a known size are continued with a new read of the rest.
+ */
+void ReadPipeline::completeInRing(Request* request, int result)
+{
+   if (result > 0) {
+      request->result += result;
+      if (request->offset >= 0 && request->result < request->length) {
+         submit(request);
+         return;
+      }
+   } else if (result < 0) {
+      request->result = result;
+   }
+   request->done = true;
+}
@@ -0,0 +1,129 @@
+/**
+ * Reads a queue of files asynchronously, keeping several reads outstanding.
+ *
+ * The files are split into blocks, and up to queueDepth blocks are read at the
+ * same time, continuing into the next files while the current one is hashed.
+ * This keeps the device busy while the CPU hashes, and lets fast devices like
+ * NVMe drives work on several requests at once.
+ *
+ * On Linux the reads are submitted to an io_uring, using the system calls
+ * directly, with the buffers registered as fixed buffers when the memory limits
+ * allow it. Where io_uring isn't available the reads are done by a pool of I/O
+ * threads instead.
+ *
+ * The blocks are returned in order, file by file, and must be handed back with
+ * release() when they have been hashed. The buffer is then reused for a new read.
+ * Up to two blocks can be held while the next ones are read. A file that isn't
+ * hashed to the end is cancelled with cancel(), which drops its remaining blocks
+ * so they're never returned as blocks of the next file.
+ * Files whose size isn't known, such as pipes, are read one block at a time.
+ * Sparse files aren't read, they're returned as a single empty block marked sparse.
+ * New reads are limited by the Throttle, and io_uring reads get its I/O priority.
+ * Of the FileHints, readahead only advises the kernel that the files are read
+ * sequentially, as the queue of reads already reads ahead.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef READPIPELINE_H
+#define READPIPELINE_H
+
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+class ReadPipeline
+{
+public:
+   struct Block {
+      // Index of the file, in the order they were added.
+      int file;
+      const char* data;
+      qint64 length;
+      // Set for the last block of the file, and for blocks with an error.
+      bool last;
+      // Error message starting with "ERROR:". No more blocks follow for the file.
+      QString error;
+      // Set, with last, for a sparse file, which isn't read. FileReader skips its holes instead.
+      bool sparse;
+      int buffer;
+   };
+
+   static const int blockSize = 1024 * 1024;
+   static const int maximumQueueDepth = 64;
+
+   ReadPipeline(int queueDepth, bool direct=false, int hints=0);
+   ~ReadPipeline();
+
+   int addFile(QString filename);
+   bool next(Block& block);
+   void release(const Block& block);
+   void cancel(int file);
+   void cancelAll();
+   bool isIoUring() const { return ring != 0; }
+
+private:
+   struct File {
+      QString filename;
+      QFile* handle;
+      // -1 if the size isn't known and the file is read one block at a time.
+      qint64 size;
+      qint64 submitted;
+      int pendingReads;
+      bool opened;
+      bool submittedAll;
+      bool failed;
+      bool direct;
+      bool sparse;
+   };
+
+   struct Request {
+      int file;
+      QFile* handle;
+      int buffer;
+      qint64 offset;
+      qint64 length;
+      // Bytes read so far, or a negative errno.
+      qint64 result;
+      bool done;
+      bool last;
+      QString error;
+   };
+
+   struct Ring;
+
+   void submitReads();
+   QString openFile(File& file);
+   void closeFile(File& file);
+   void disableDirectIo(File& file);
+   void submit(Request* request);
+   void waitFor(Request* request);
+   void readInThread(Request* request);
+   bool setupRing();
+   void destroyRing();
+   void flushRing();
+   void waitForRing();
+   void completeInRing(Request* request, int result);
+
+   int queueDepth;
+   bool direct;
+   int hints;
+   QList<File> files;
+   // The index of the file getting new reads.
+   int submitFile;
+   // Requests in the order they were submitted, the first one is returned next.
+   QList<Request*> order;
+   QList<char*> buffers;
+   QList<int> freeBuffers;
+
+   Ring* ring;
+   // Used by the I/O threads when there is no io_uring.
+   QThreadPool ioThreads;
+   QMutex mutex;
+   QWaitCondition completed;
+};
+
+#endif // READPIPELINE_H
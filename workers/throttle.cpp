@@ -0,0 +1,170 @@
+/**
+ * Limits how fast the files are read, for hashing on servers in use.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include <QtGlobal>
+
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_MACOS
+#include <sys/resource.h>
+#endif
+
+#include "throttle.h"
+
+namespace {
+
+#ifdef Q_OS_LINUX
+// From linux/ioprio.h, which older kernel headers don't have.
+const int ioprioWhoProcess = 1;
+const int ioprioClassShift = 13;
+const int ioprioClassIdle = 3;
+#endif
+
+// Whether the priority of the current thread is idle, -1 before the first read.
+// Threads inherit the priority of the thread starting them, so it's always set once.
+thread_local int idleThread = -1;
+
+}
+
+/**
+ * @brief Throttle::get
+ * @return The throttle shared by all readers.
+ */
+Throttle& Throttle::get()
+{
+   static Throttle throttle;
+   return throttle;
+}
+
+/**
+ * @brief Throttle::Throttle
+ * Starts without any limits.
+ */
+Throttle::Throttle()
+{
+   bytesPerSecond = 0;
+   operationsPerSecond = 0;
+   byteTokens = 0;
+   operationTokens = 0;
+   timer.start();
+}
+
+/**
+ * @brief Throttle::setLimits
+ * @param bytesPerSecond Bandwidth of the reads, 0 for no limit.
+ * @param operationsPerSecond Number of reads per second, 0 for no limit.
+ */
+void Throttle::setLimits(qint64 bytesPerSecond, int operationsPerSecond)
+{
+   QMutexLocker locker(&mutex);
+   refill();
+   this->bytesPerSecond = qMax<qint64>(0, bytesPerSecond);
+   this->operationsPerSecond = qMax(0, operationsPerSecond);
+   byteTokens = qMin(byteTokens, static_cast<double>(this->bytesPerSecond));
+   operationTokens = qMin(operationTokens, static_cast<double>(this->operationsPerSecond));
+   limitsChanged.wakeAll();
+}
+
+/**
+ * @brief Throttle::setIdlePriority
+ * @param idle Read with the idle I/O priority, the threads change it at their next read.
+ */
+void Throttle::setIdlePriority(bool idle)
+{
+   this->idle.storeRelease(idle ? 1 : 0);
+}
+
+/**
+ * @brief Throttle::isLimited
+ * @return True if any of the limits are set.
+ */
+bool Throttle::isLimited()
+{
+   QMutexLocker locker(&mutex);
+   return bytesPerSecond > 0 || operationsPerSecond > 0;
+}
+
+/**
+ * @brief Throttle::acquire
+ * @param bytes Size of the read about to be done.
+ *
+ * Waits until the read is within the limits, and applies the I/O priority to the thread.
+ */
+void Throttle::acquire(qint64 bytes)
+{
+   applyPriority();
+   QMutexLocker locker(&mutex);
+   forever {
+      if (bytesPerSecond <= 0 && operationsPerSecond <= 0) {
+         return;
+      }
+      refill();
+      double wait = 0;
+      if (bytesPerSecond > 0 && byteTokens < 0) {
+         wait = -byteTokens / bytesPerSecond;
+      }
+      if (operationsPerSecond > 0 && operationTokens < 0) {
+         wait = qMax(wait, -operationTokens / operationsPerSecond);
+      }
+      if (wait <= 0) {
+         if (bytesPerSecond > 0) {
+            byteTokens -= bytes;
+         }
+         if (operationsPerSecond > 0) {
+            operationTokens -= 1;
+         }
+         return;
+      }
+      limitsChanged.wait(&mutex, static_cast<unsigned long>(wait * 1000) + 1);
+   }
+}
+
+/**
+ * @brief Throttle::applyPriority
+ * Sets the I/O priority of the calling thread, if it has changed since its last read.
+ */
+void Throttle::applyPriority()
+{
+   int idle = this->idle.loadAcquire();
+   if (idle == idleThread) {
+      return;
+   }
+   idleThread = idle;
+#if defined(Q_OS_LINUX)
+   // Thread 0 is the calling thread. Priority 0 uses the default, based on the nice value.
+   syscall(SYS_ioprio_set, ioprioWhoProcess, 0, idle ? ioprioClassIdle << ioprioClassShift : 0);
+#elif defined(Q_OS_MACOS)
+   setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD, idle ? IOPOL_THROTTLE : IOPOL_DEFAULT);
+#endif
+}
+
+/**
+ * @brief Throttle::ioPriority
+ * @return The I/O priority for the reads in Linux's format, 0 for the default.
+ */
+int Throttle::ioPriority() const
+{
+#ifdef Q_OS_LINUX
+   if (idle.loadAcquire()) {
+      return ioprioClassIdle << ioprioClassShift;
+   }
+#endif
+   return 0;
+}
+
+/**
+ * @brief Throttle::refill
+ * Adds the tokens for the time since the last refill. Up to a second's worth is kept.
+ */
+void Throttle::refill()
+{
+   double seconds = timer.nsecsElapsed() / 1e9;
+   timer.restart();
+   byteTokens = qMin(byteTokens + seconds * bytesPerSecond, static_cast<double>(bytesPerSecond));
+   operationTokens = qMin(operationTokens + seconds * operationsPerSecond, static_cast<double>(operationsPerSecond));
+}
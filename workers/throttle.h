@@ -0,0 +1,57 @@
+/**
+ * Limits how fast the files are read, for hashing on servers in use.
+ *
+ * A token bucket shared by all readers, with one bucket for the bandwidth and
+ * one for the number of reads. The buckets fill up at the set rates and hold up
+ * to one second's worth. Every read takes its size from the first bucket and
+ * one from the second, and waits while either bucket is empty. A read larger
+ * than what's left is still let through, the following reads then wait until the
+ * bucket has been refilled.
+ *
+ * The I/O of the reading threads can also be given the idle priority, so it's only
+ * served when the disks have nothing else to do. The priority is applied by the
+ * threads themselves when they read, so it can be changed while hashing.
+ *
+ * The limits can be changed at any time, and apply to the reads waiting at the time.
+ *
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef THROTTLE_H
+#define THROTTLE_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QWaitCondition>
+
+class Throttle
+{
+public:
+   static Throttle& get();
+
+   // Zero removes the limit.
+   void setLimits(qint64 bytesPerSecond, int operationsPerSecond);
+   void setIdlePriority(bool idle);
+   bool isLimited();
+
+   void acquire(qint64 bytes);
+   void applyPriority();
+   int ioPriority() const;
+
+private:
+   Throttle();
+   void refill();
+
+   QMutex mutex;
+   QWaitCondition limitsChanged;
+   QElapsedTimer timer;
+   qint64 bytesPerSecond;
+   int operationsPerSecond;
+   // Negative when the last read took more than there was.
+   double byteTokens;
+   double operationTokens;
+   QAtomicInt idle;
+};
+
+#endif // THROTTLE_H